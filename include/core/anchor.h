@@ -0,0 +1,103 @@
+#ifndef ANCHOR_H
+#define ANCHOR_H
+
+#include <stddef.h>
+
+/**
+ * Anchor Module
+ *
+ * Edit-stable positions in a buffer. Anchors are kept in a balanced tree
+ * ordered by offset; inserts and deletes shift every anchor after the edit
+ * with a single lazy tag, so an edit costs O(log n) plus the anchors sitting
+ * at the edit point or inside deleted text. Anchor handles stay valid until
+ * removed or until the set is freed.
+ */
+
+// Where an anchor goes when text is inserted exactly at its offset
+typedef enum {
+    ANCHOR_LEFT,     // Stays before the inserted text
+    ANCHOR_RIGHT     // Moves after the inserted text
+} AnchorGravity;
+
+// Forward declaration and typedef for Anchor
+struct Anchor;
+typedef struct Anchor Anchor;
+
+// Structure for an anchor (a node of the anchor tree)
+struct Anchor {
+    size_t offset;          // Offset, excluding shifts pending in ancestors
+    long shift;             // Pending shift for left and right subtrees
+    AnchorGravity gravity;  // Behaviour on insertion at offset
+    unsigned priority;      // Heap priority for balancing
+    Anchor* left;           // Anchors at or before this one
+    Anchor* right;          // Anchors at or after this one
+    Anchor* parent;         // Parent node (NULL for the root)
+};
+
+// Forward declaration and typedef for AnchorSet
+struct AnchorSet;
+typedef struct AnchorSet AnchorSet;
+
+// Structure for the set of anchors of one buffer
+struct AnchorSet {
+    Anchor* root;           // Tree of anchors
+    size_t count;           // Number of anchors
+    unsigned seed;          // State of the priority generator
+};
+
+// Anchor set lifecycle
+/**
+ * Create an empty anchor set
+ * @return A new anchor set or NULL on error
+ */
+AnchorSet* anchor_set_create(void);
+
+/**
+ * Free an anchor set and all of its anchors
+ * @param anchors Anchor set to free
+ */
+void anchor_set_free(AnchorSet* anchors);
+
+// Anchor management
+/**
+ * Add an anchor
+ * @param anchors Anchor set to update
+ * @param offset Initial offset
+ * @param gravity Behaviour on insertion at the anchor's offset
+ * @return New anchor handle or NULL on error
+ */
+Anchor* anchor_create(AnchorSet* anchors, size_t offset, AnchorGravity gravity);
+
+/**
+ * Remove and free an anchor
+ * @param anchors Anchor set containing the anchor
+ * @param anchor Anchor to remove
+ */
+void anchor_remove(AnchorSet* anchors, Anchor* anchor);
+
+/**
+ * Get the current offset of an anchor
+ * @param anchor Anchor to query
+ * @return Offset in the buffer
+ */
+size_t anchor_offset(const Anchor* anchor);
+
+// Edit tracking
+/**
+ * Shift anchors for inserted text
+ * @param anchors Anchor set to update
+ * @param pos Offset where text was inserted
+ * @param length Number of bytes inserted
+ */
+void anchor_set_insert(AnchorSet* anchors, size_t pos, size_t length);
+
+/**
+ * Shift anchors for deleted text
+ * Anchors inside the deleted range collapse to its start.
+ * @param anchors Anchor set to update
+ * @param pos Offset where text was deleted
+ * @param length Number of bytes deleted
+ */
+void anchor_set_delete(AnchorSet* anchors, size_t pos, size_t length);
+
+#endif // ANCHOR_H
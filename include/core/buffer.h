@@ -2,13 +2,14 @@
 #define BUFFER_H
 
 #include <stddef.h>
+#include "anchor.h"
 
 /**
  * Buffer Module
  * 
  * Provides text storage and manipulation using a piece table data structure.
- * This component has no dependencies on other modules and represents the Model
- * in the MVC architecture.
+ * This component depends only on the Anchor module, which keeps positions
+ * stable across edits, and represents the Model in the MVC architecture.
  */
 
 // Piece types
@@ -41,6 +42,8 @@ struct Buffer {
     size_t add_capacity;// Capacity of add buffer
     Piece* head;        // First piece in the list
     int modified;       // Flag indicating if buffer was modified since last save
+    size_t generation;  // Incremented on every content change
+    AnchorSet* anchors; // Positions that move with edits
 };
 
 // Buffer lifecycle
@@ -55,8 +58,13 @@ void buffer_delete(Buffer* buffer, size_t pos, size_t length);
 char* buffer_get_content(Buffer* buffer);
 size_t buffer_size(Buffer* buffer);
 
+// Anchors
+Anchor* buffer_anchor_create(Buffer* buffer, size_t pos, AnchorGravity gravity);
+void buffer_anchor_remove(Buffer* buffer, Anchor* anchor);
+
 // Buffer state
 int buffer_is_modified(Buffer* buffer);
 void buffer_set_modified(Buffer* buffer, int modified);
+size_t buffer_generation(Buffer* buffer);
 
 #endif // BUFFER_H
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include "terminal.h"
+#include "anchor.h"
 
 /**
  * Editor Module
@@ -12,11 +13,20 @@
  * Coordinates commands, file operations, and user input handling.
  */
 
+// Frame rate cap for continuous input streams (mouse drags, wheel scrolling)
+#define EDITOR_MAX_FPS 60
+
 // Forward declarations to avoid including headers directly
 struct Buffer;
 struct Viewport;
+struct ScreenBuffer;
+struct Grid;
+struct RowCache;
 typedef struct Buffer Buffer;
 typedef struct Viewport Viewport;
+typedef struct ScreenBuffer ScreenBuffer;
+typedef struct Grid Grid;
+typedef struct RowCache RowCache;
 
 /**
  * Editor state structure
@@ -25,10 +35,16 @@ typedef struct Viewport Viewport;
 typedef struct EditorState {
     Buffer* buffer;      // Text content being edited
     Viewport* viewport;  // View of the content
+    ScreenBuffer* screen; // Frame output buffer reused across renders
+    Grid* grid;          // Screen contents for damage tracking
+    RowCache* row_cache; // What each text row was last rendered from
     char* filename;      // Current file being edited
     int dirty;           // Whether content has been modified
     size_t rows;         // Terminal row count
     size_t cols;         // Terminal column count
+    int needs_render;    // State changed since the last frame
+    long long last_render; // When the last frame was drawn (monotonic microseconds)
+    int resize_pending;  // SIGWINCH arrived; the size is re-read when the next frame is due
 } EditorState;
 
 // Editor lifecycle
@@ -92,6 +108,15 @@ void editor_delete_text(EditorState* state, size_t amount);
  */
 void editor_insert_newline(EditorState* state);
 
+/**
+ * Insert pasted text at cursor position as a single edit
+ * Line endings are converted to \n and NUL bytes dropped, in place.
+ * @param state Editor state
+ * @param text Pasted text (modified)
+ * @param length Length of the text in bytes
+ */
+void editor_paste(EditorState* state, char* text, size_t length);
+
 // Input handling
 /**
  * Process keyboard input
@@ -101,6 +126,16 @@ void editor_insert_newline(EditorState* state);
  */
 int editor_process_key(EditorState* state, int key);
 
+/**
+ * Process a key pressed several times in a row
+ * Cursor and page motions move the whole distance at once.
+ * @param state Editor state
+ * @param key Key code from terminal
+ * @param count Times the key was pressed
+ * @return 0 to continue, non-zero to exit editor
+ */
+int editor_process_key_repeat(EditorState* state, int key, size_t count);
+
 /**
  * Process mouse event
  * @param state Editor state
@@ -124,6 +159,21 @@ void editor_resize(EditorState* state, size_t rows, size_t cols);
  */
 void editor_initialize_terminal(size_t* rows, size_t* cols);
 
+/**
+ * Read input on its own thread, so it keeps flowing while the editor is busy
+ * Falls back to reading on the editor thread if the thread can't start.
+ * @return 1 if the input thread is running, 0 otherwise
+ */
+int editor_start_input_thread(void);
+
+/**
+ * Write frames to the terminal on their own thread, so a slow terminal
+ * doesn't hold up editing; frames it can't keep up with are skipped
+ * Falls back to writing on the editor thread if the thread can't start.
+ * @return 1 if the render thread is running, 0 otherwise
+ */
+int editor_start_render_thread(void);
+
 /**
  * Clean up terminal resources
  */
@@ -143,6 +193,23 @@ void editor_show_welcome_screen(size_t rows, size_t cols);
  */
 int editor_validate_file(const char* filename);
 
+// Anchors
+/**
+ * Create an anchor that tracks a buffer position across edits
+ * @param state Editor state
+ * @param pos Buffer position
+ * @param gravity Behaviour on insertion at the anchor's position
+ * @return Anchor handle or NULL on error
+ */
+Anchor* editor_anchor_create(EditorState* state, size_t pos, AnchorGravity gravity);
+
+/**
+ * Remove an anchor created with editor_anchor_create
+ * @param state Editor state
+ * @param anchor Anchor to remove
+ */
+void editor_anchor_remove(EditorState* state, Anchor* anchor);
+
 // State access
 /**
  * Get buffer content as a string
@@ -151,6 +218,13 @@ int editor_validate_file(const char* filename);
  */
 char* editor_get_content(EditorState* state);
 
+/**
+ * Get buffer content generation
+ * @param state Editor state
+ * @return Counter that changes whenever buffer content changes
+ */
+size_t editor_get_generation(EditorState* state);
+
 /**
  * Get cursor position
  * @param state Editor state
@@ -190,9 +264,16 @@ int editor_is_dirty(EditorState* state);
 const char* editor_get_filename(EditorState* state);
 
 /**
- * Refresh viewport to reflect buffer changes
+ * Refresh viewport to reflect buffer changes and schedule a render
  * @param state Editor state
  */
 void editor_refresh_view(EditorState* state);
 
+/**
+ * Schedule a render
+ * The main loop draws one frame once all pending input has been applied.
+ * @param state Editor state
+ */
+void editor_request_render(EditorState* state);
+
 #endif // EDITOR_H
\ No newline at end of file
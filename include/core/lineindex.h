@@ -0,0 +1,98 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Line Index Module
+ *
+ * Compact map from line numbers to byte offsets. Only every stride-th line
+ * start is stored, as a 32-bit offset relative to a 64-bit base shared by a
+ * block of samples; the lines in between are found by scanning forward with
+ * the linescan kernels. A stride of 1 costs about 4 bytes per line, a stride
+ * of 16 about a quarter byte per line, at the price of scanning up to
+ * stride - 1 lines per lookup.
+ */
+
+// Samples sharing one 64-bit block base
+#define LINE_INDEX_BLOCK 256
+
+// Default lines per sample (must be a power of two)
+#define LINE_INDEX_DEFAULT_STRIDE 4
+
+// Marks a sample whose offset doesn't fit in 32 bits relative to its block
+#define LINE_INDEX_FAR UINT32_MAX
+
+// Forward declaration and typedef for LineIndex
+struct LineIndex;
+typedef struct LineIndex LineIndex;
+
+// Structure for the sampled line index
+struct LineIndex {
+    const char* data;       // Indexed text (not owned)
+    size_t size;            // Length of text in bytes
+    size_t line_count;      // Number of lines (at least 1)
+    size_t stride;          // Lines per sample
+    unsigned stride_shift;  // log2(stride)
+    size_t sample_count;    // Number of stored samples
+    uint64_t* block_base;   // Offset of the first sample in each block
+    uint32_t* sample_rel;   // Sample offsets relative to their block base
+};
+
+// Line index lifecycle
+/**
+ * Build a line index over text
+ * @param data Text to index (must outlive the index)
+ * @param size Length of text in bytes
+ * @param stride Lines per stored sample, rounded up to a power of two
+ * @return A new line index or NULL on error
+ */
+LineIndex* line_index_create(const char* data, size_t size, size_t stride);
+
+/**
+ * Free resources used by a line index
+ * @param index Line index to free
+ */
+void line_index_free(LineIndex* index);
+
+// Queries
+/**
+ * Get number of lines
+ * @param index Line index to query
+ * @return Line count (0 if index is NULL)
+ */
+size_t line_index_count(const LineIndex* index);
+
+/**
+ * Get byte offset of the start of a line
+ * @param index Line index to query
+ * @param line Line number (0-based)
+ * @return Offset of the first byte of the line, or size if out of range
+ */
+size_t line_index_start(const LineIndex* index, size_t line);
+
+/**
+ * Get byte offset of the end of a line
+ * @param index Line index to query
+ * @param line Line number (0-based)
+ * @return Offset of the line's newline, or size for the last line
+ */
+size_t line_index_end(const LineIndex* index, size_t line);
+
+/**
+ * Find the line containing a byte offset
+ * @param index Line index to query
+ * @param offset Byte offset (clamped to size)
+ * @return Line number (0-based)
+ */
+size_t line_index_line_at(const LineIndex* index, size_t offset);
+
+/**
+ * Get memory used by the index itself
+ * @param index Line index to query
+ * @return Bytes allocated for the index
+ */
+size_t line_index_memory(const LineIndex* index);
+
+#endif // LINEINDEX_H
@@ -0,0 +1,95 @@
+#ifndef LINESCAN_H
+#define LINESCAN_H
+
+#include <stddef.h>
+
+/**
+ * Line Scan Module
+ *
+ * Newline scanning kernels used to build line indexes. Each kernel comes in
+ * AVX2, SSE2 and scalar flavours; the best one supported by the running CPU
+ * is selected on first use. Large inputs are split into chunks that are
+ * scanned on multiple threads. This is a self-contained module with no
+ * dependencies on other components of the system.
+ */
+
+// Inputs smaller than this are always scanned on the calling thread
+#define LINESCAN_PARALLEL_MIN (8 * 1024 * 1024)
+
+// Upper bound on worker threads used for a single scan
+#define LINESCAN_MAX_THREADS 16
+
+/**
+ * Callback invoked for one chunk of a parallel scan
+ * @param ctx Caller context
+ * @param chunk Index of the chunk
+ * @param begin Offset of the first byte in the chunk
+ * @param end Offset one past the last byte in the chunk
+ */
+typedef void (*LineScanChunkFn)(void* ctx, size_t chunk, size_t begin, size_t end);
+
+/**
+ * Get the name of the kernel selected for this CPU
+ * @return "avx2", "sse2" or "scalar"
+ */
+const char* linescan_kernel_name(void);
+
+/**
+ * Count newline characters
+ * @param data Bytes to scan
+ * @param len Number of bytes
+ * @return Number of '\n' bytes in data
+ */
+size_t linescan_count(const char* data, size_t len);
+
+/**
+ * Record offsets of newline characters
+ * Stops early when max offsets have been recorded
+ * @param data Bytes to scan
+ * @param len Number of bytes
+ * @param base Value added to every recorded offset
+ * @param out Output array for offsets
+ * @param max Capacity of out
+ * @param scanned Output parameter for bytes consumed (may be NULL)
+ * @return Number of offsets written to out
+ */
+size_t linescan_find(const char* data, size_t len, size_t base,
+                     size_t* out, size_t max, size_t* scanned);
+
+/**
+ * Skip past a number of newlines
+ * @param data Bytes to scan
+ * @param len Number of bytes
+ * @param n Number of newlines to skip (0 returns data)
+ * @return Pointer just past the n-th newline, or NULL if there are fewer
+ */
+const char* linescan_skip(const char* data, size_t len, size_t n);
+
+/**
+ * Number of chunks a parallel scan of len bytes is split into
+ * @param len Number of bytes to scan
+ * @return Chunk count (1 for small inputs)
+ */
+size_t linescan_chunk_count(size_t len);
+
+/**
+ * Run fn over len bytes split into chunks, one thread per chunk
+ * Chunk boundaries are the same for every call with the same len
+ * @param len Number of bytes to scan
+ * @param chunks Number of chunks (from linescan_chunk_count)
+ * @param fn Callback invoked once per chunk
+ * @param ctx Caller context passed to fn
+ */
+void linescan_parallel(size_t len, size_t chunks, LineScanChunkFn fn, void* ctx);
+
+/**
+ * Build an array of line start offsets
+ * The first entry is always 0; each following entry is one past a newline.
+ * @param data Bytes to scan
+ * @param len Number of bytes
+ * @param line_count Output parameter for number of entries
+ * @return Newly allocated offset array (caller must free), or NULL on error
+ */
+size_t* linescan_line_starts(const char* data, size_t len, size_t* line_count);
+
+#endif // LINESCAN_H
@@ -0,0 +1,55 @@
+#ifndef COALESCE_H
+#define COALESCE_H
+
+#include <stddef.h>
+#include "terminal.h"
+
+/**
+ * Coalesce Module
+ *
+ * Merges runs of input events that only add up or supersede each other, so
+ * a burst is dispatched as one event. Repeats of a motion key become one
+ * event with a count, wheel notches are summed with their direction, and a
+ * drag keeps only its latest position. Events are pushed in the order they
+ * were decoded and come back out in the same order; the merging never
+ * reorders two events. A merged event keeps the read and decode times of
+ * the first event in it, so latency is measured from the oldest input it
+ * stands for. This is a self-contained module with no dependencies beyond
+ * the terminal event types.
+ */
+
+// Most repeats merged into one event; a longer run is split
+#define COALESCE_MAX_COUNT 65535
+
+// Structure holding the event still open to merging
+typedef struct {
+    InputEvent pending;    // Event later ones may merge into
+    int has_pending;       // Whether pending holds an event
+} Coalescer;
+
+/**
+ * Start with nothing pending
+ * @param coalescer Coalescer to initialize
+ */
+void coalesce_init(Coalescer* coalescer);
+
+/**
+ * Add the next decoded event
+ * The event is merged into the pending one when possible; otherwise the
+ * pending event is handed back for dispatch and the new one takes its place.
+ * @param coalescer Coalescer to add to
+ * @param event Next event (count is set to 1 if it is 0)
+ * @param ready Set to the event to dispatch now
+ * @return 1 if ready holds an event, 0 if the event was merged
+ */
+int coalesce_push(Coalescer* coalescer, const InputEvent* event, InputEvent* ready);
+
+/**
+ * Take the pending event at the end of a batch
+ * @param coalescer Coalescer to flush
+ * @param ready Set to the pending event
+ * @return 1 if there was a pending event, 0 otherwise
+ */
+int coalesce_flush(Coalescer* coalescer, InputEvent* ready);
+
+#endif // COALESCE_H
@@ -0,0 +1,54 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+/**
+ * Event Loop Module
+ *
+ * Lets the editor sleep until there is something to do. A wait blocks in
+ * poll on the terminal input and on a self-pipe, and times out only when the
+ * caller has a deadline such as the next allowed frame. Signal handlers and
+ * other threads write to the pipe to wake the loop, so an idle editor makes
+ * no system calls at all. Resizes are reported from SIGWINCH, so the terminal
+ * size only needs to be read when it changed.
+ */
+
+// Reasons a wait returned (bit mask; 0 means the timeout expired)
+#define EVENTLOOP_INPUT  0x01  // Terminal input is ready to read
+#define EVENTLOOP_WAKE   0x02  // eventloop_wake was called or a signal arrived
+#define EVENTLOOP_HANGUP 0x04  // The terminal went away
+#define EVENTLOOP_RESIZE 0x08  // SIGWINCH arrived since the last wait
+
+/**
+ * Set up the wakeup pipe and the signal handlers that write to it
+ * Without the pipe, waits still return on input and on signals.
+ * @return 1 on success, 0 on error
+ */
+int eventloop_init(void);
+
+/**
+ * Release the wakeup pipe and restore the signal handlers
+ */
+void eventloop_cleanup(void);
+
+/**
+ * Choose whether terminal input wakes a wait
+ * Turned off when another thread reads the input and wakes the loop itself;
+ * a hangup is still reported either way.
+ * @param watch 1 to wake on input (the default), 0 not to
+ */
+void eventloop_watch_input(int watch);
+
+/**
+ * Block until terminal input, a wakeup or the timeout
+ * @param timeout_ms Longest wait in milliseconds, or -1 to wait indefinitely
+ * @return EVENTLOOP_* flags for what happened, 0 on timeout
+ */
+int eventloop_wait(int timeout_ms);
+
+/**
+ * Wake a thread blocked in eventloop_wait
+ * Safe to call from other threads and from signal handlers.
+ */
+void eventloop_wake(void);
+
+#endif // EVENTLOOP_H
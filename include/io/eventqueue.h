@@ -0,0 +1,60 @@
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include "terminal.h"
+
+/**
+ * Event Queue Module
+ *
+ * A fixed-size ring of input events passed from exactly one producer thread
+ * to exactly one consumer thread without locks. Each side only writes its
+ * own index; the producer publishes an event by releasing the tail after
+ * filling the slot, and the consumer frees the slot by releasing the head
+ * after copying it out. This is a self-contained module with no
+ * dependencies beyond the terminal event types.
+ */
+
+// Default number of events the queue holds (a power of two)
+#define EVENT_QUEUE_DEFAULT_CAPACITY 1024
+
+// Structure for the queue; head and tail sit on separate cache lines
+typedef struct {
+    InputEvent* events;                    // Slots
+    size_t mask;                           // Capacity - 1
+    _Alignas(64) atomic_size_t head;       // Next slot to pop (written by the consumer)
+    _Alignas(64) atomic_size_t tail;       // Next slot to push (written by the producer)
+} EventQueue;
+
+/**
+ * Create an empty queue
+ * @param capacity Number of events it can hold (rounded up to a power of two)
+ * @return A new queue, or NULL on allocation failure
+ */
+EventQueue* event_queue_create(size_t capacity);
+
+/**
+ * Free a queue
+ * Events still queued are dropped along with any paste text they own.
+ * @param queue Queue to free (no thread may be using it)
+ */
+void event_queue_free(EventQueue* queue);
+
+/**
+ * Append an event (producer thread only)
+ * @param queue Queue to append to
+ * @param event Event to copy in
+ * @return 1 if it was queued, 0 if the queue is full
+ */
+int event_queue_push(EventQueue* queue, const InputEvent* event);
+
+/**
+ * Remove the oldest event (consumer thread only)
+ * @param queue Queue to take from
+ * @param event Set to the event
+ * @return 1 if an event was taken, 0 if the queue is empty
+ */
+int event_queue_pop(EventQueue* queue, InputEvent* event);
+
+#endif // EVENTQUEUE_H
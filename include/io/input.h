@@ -0,0 +1,143 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+#include "terminal.h"
+
+/**
+ * Input Module
+ *
+ * Turns the raw bytes typed into the terminal into input events. Bytes are
+ * read in large chunks into a ring buffer and decoded by a state machine
+ * that keeps its place between chunks, so an escape sequence split across
+ * two reads decodes the same as one read whole, and one read can yield any
+ * number of events. The decoder never waits: the only ambiguity, a lone ESC
+ * that may start a sequence, is left pending until the caller decides it
+ * has waited long enough and flushes it as the Escape key.
+ *
+ * Each byte is looked at once. CSI and SS3 parameters are accumulated as
+ * numbers while the sequence arrives, and the final byte selects the event
+ * from lookup tables: cursor and editing keys with Shift/Alt/Ctrl modifiers,
+ * SGR mouse reports and focus changes. ESC before a printable character is
+ * that character with Alt. Sequences nothing maps to are dropped.
+ *
+ * Text between the bracketed paste markers is collected as it arrives,
+ * copied in runs up to the next ESC, and delivered as one paste event
+ * however many reads it took.
+ */
+
+// Bytes buffered between reads (a power of two)
+#define INPUT_RING_SIZE (64 * 1024)
+
+// Numeric parameters kept per sequence; later ones are ignored
+#define INPUT_MAX_PARAMS 4
+
+// Largest parameter value kept; larger values are clamped
+#define INPUT_PARAM_MAX 65535
+
+// Sequence number of CSI n ~ that starts a bracketed paste
+#define INPUT_PASTE_BEGIN 200
+
+// How long a lone ESC waits for the rest of a sequence before it counts as the Escape key
+#define INPUT_ESC_TIMEOUT_MS 25
+
+// Structure for the input ring buffer and decoder state
+typedef struct {
+    unsigned char ring[INPUT_RING_SIZE]; // Bytes read but not decoded yet
+    size_t head;                         // Next byte to decode (free-running)
+    size_t tail;                         // Where the next read goes (free-running)
+    int state;                           // Decoder state
+    char marker;                         // Private marker after CSI ('<', '?', ...) or 0
+    int params[INPUT_MAX_PARAMS];        // Numeric parameters of the sequence so far
+    size_t param_count;                  // Parameters started so far
+    int malformed;                       // Sequence has bytes no decoded sequence uses
+    char* paste;                         // Text of the paste being collected, or NULL
+    size_t paste_length;                 // Bytes collected so far
+    size_t paste_capacity;               // Allocated size of paste
+    size_t paste_match;                  // Bytes of the end marker seen so far
+} InputDecoder;
+
+/**
+ * Reset a decoder to empty
+ * A decoder that was used before must be cleaned up first.
+ * @param decoder Decoder to initialize
+ */
+void input_decoder_init(InputDecoder* decoder);
+
+/**
+ * Release a paste the decoder was in the middle of collecting
+ * @param decoder Decoder to clean up
+ */
+void input_decoder_cleanup(InputDecoder* decoder);
+
+// Filling
+/**
+ * Get the free space a read can go straight into
+ * @param decoder Decoder to fill
+ * @param region Set to the start of the contiguous free space
+ * @return Number of bytes that fit in region
+ */
+size_t input_decoder_space(InputDecoder* decoder, unsigned char** region);
+
+/**
+ * Mark bytes written into the region from input_decoder_space as filled
+ * @param decoder Decoder to fill
+ * @param count Number of bytes written
+ */
+void input_decoder_commit(InputDecoder* decoder, size_t count);
+
+/**
+ * Copy bytes into the ring buffer
+ * @param decoder Decoder to fill
+ * @param data Bytes to add
+ * @param len Number of bytes
+ * @return Number of bytes that fit
+ */
+size_t input_decoder_feed(InputDecoder* decoder, const char* data, size_t len);
+
+// Decoding
+/**
+ * Decode the next event from the buffered bytes
+ * Bytes of an incomplete sequence are kept in the decoder, so the ring is
+ * empty whenever this returns 0. A paste event owns its text, which the
+ * caller must free.
+ * @param decoder Decoder to read from
+ * @param event Set to the decoded event
+ * @return 1 if an event was decoded, 0 if more bytes are needed
+ */
+int input_decoder_next(InputDecoder* decoder, InputEvent* event);
+
+/**
+ * Check whether the decoder is holding a lone ESC
+ * @param decoder Decoder to query
+ * @return 1 if the last byte seen was an ESC that starts nothing yet, 0 otherwise
+ */
+int input_decoder_waiting(const InputDecoder* decoder);
+
+/**
+ * Give up waiting for the rest of a sequence after a lone ESC
+ * @param decoder Decoder to flush
+ * @param event Set to the Escape key event
+ * @return 1 if a lone ESC was flushed, 0 if there was none
+ */
+int input_decoder_flush(InputDecoder* decoder, InputEvent* event);
+
+/**
+ * Build a mouse event from an SGR mouse report (CSI < button ; x ; y M/m)
+ * @param button Button code, including the motion, wheel and modifier bits
+ * @param x 1-based column
+ * @param y 1-based row
+ * @param final 'M' for press, drag or wheel; 'm' for release
+ * @return The mouse event (type MOUSE_NONE if it isn't one the editor uses)
+ */
+MouseEvent input_mouse_event(int button, int x, int y, char final);
+
+/**
+ * Take the next raw byte, bypassing the decoder
+ * @param decoder Decoder to read from
+ * @param byte Set to the byte
+ * @return 1 if a byte was available, 0 otherwise
+ */
+int input_decoder_take_byte(InputDecoder* decoder, unsigned char* byte);
+
+#endif // INPUT_H
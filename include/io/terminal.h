@@ -21,6 +21,7 @@
 #define TERM_ALT_SCREEN_ON   CSI "?1049h"
 #define TERM_ALT_SCREEN_OFF  CSI "?1049l"
 #define TERM_CURSOR_HOME     CSI "H"
+#define TERM_RESET_SCROLL_REGION CSI "r"
 
 // Cursor styling
 #define TERM_CURSOR_BLOCK    CSI "2 q"
@@ -34,10 +35,25 @@
 #define TERM_CURSOR_RIGHT(n) CSI #n "C"
 #define TERM_CURSOR_LEFT(n)  CSI #n "D"
 
+// Synchronized output: the terminal shows a frame only once it is complete
+#define TERM_SYNC_BEGIN      CSI "?2026h"
+#define TERM_SYNC_END        CSI "?2026l"
+
+// Capability queries
+#define TERM_QUERY_SYNC      CSI "?2026$p"   // DECRQM for synchronized output
+#define TERM_QUERY_DA1       CSI "c"         // Primary device attributes (always answered)
+#define TERM_QUERY_TIMEOUT_MS 200            // How long to wait for the answers
+
 // Mouse support
 #define TERM_MOUSE_ON        CSI "?1000;1006;1015h"  // Enable mouse tracking
 #define TERM_MOUSE_OFF       CSI "?1000;1006;1015l"  // Disable mouse tracking
 
+// Bracketed paste: pasted text arrives between CSI 200~ and CSI 201~
+#define TERM_PASTE_ON        CSI "?2004h"
+#define TERM_PASTE_OFF       CSI "?2004l"
+#define TERM_PASTE_BEGIN     CSI "200~"
+#define TERM_PASTE_END       CSI "201~"
+
 // Special keys
 #define KEY_NULL      0
 #define KEY_CTRL_A    1
@@ -87,6 +103,13 @@
 #define KEY_CTRL_UP      1022  // Ctrl+Up
 #define KEY_CTRL_DOWN    1023  // Ctrl+Down
 
+// Modifier flags combined with a key code, e.g. KEY_ARROW_UP | KEY_MOD_SHIFT
+// (Ctrl with an arrow, Home or End maps to the KEY_CTRL_* / KEY_WORD_* codes above)
+#define KEY_MOD_SHIFT    0x10000
+#define KEY_MOD_ALT      0x20000
+#define KEY_MOD_CTRL     0x40000
+#define KEY_MOD_MASK     (KEY_MOD_SHIFT | KEY_MOD_ALT | KEY_MOD_CTRL)
+
 /**
  * Mouse event types
  * Represents different mouse interactions that can be captured
@@ -119,7 +142,9 @@ typedef enum {
     EVENT_NONE,     // No event
     EVENT_KEY,      // Keyboard event
     EVENT_MOUSE,    // Mouse event
-    EVENT_RESIZE    // Terminal resize event
+    EVENT_RESIZE,   // Terminal resize event
+    EVENT_FOCUS,    // Terminal window gained or lost focus
+    EVENT_PASTE     // Text pasted while bracketed paste is on
 } EventType;
 
 /**
@@ -128,9 +153,17 @@ typedef enum {
  */
 typedef struct {
     EventType type;   // Type of event
+    size_t count;     // Times it happened in a row (above 1 once coalesced)
+    long long time_us; // When it was decoded (monotonic microseconds)
+    long long read_us; // When the read that completed it returned
     union {
         int key;      // Keyboard key code
         MouseEvent mouse;  // Mouse event data
+        int focused;  // 1 if focus was gained, 0 if lost
+        struct {
+            char* text;    // Pasted bytes as sent, NUL-terminated; freed by the receiver
+            size_t length; // Number of bytes, not counting the terminator
+        } paste;
     };
 } InputEvent;
 
@@ -146,6 +179,24 @@ void terminal_init(void);
  */
 void terminal_cleanup(void);
 
+// Output
+/**
+ * Write a whole frame to the terminal
+ * Wraps the frame in synchronized update markers when the terminal supports
+ * them and writes it with as few system calls as possible, retrying partial
+ * writes and waiting out EAGAIN on non-blocking descriptors.
+ * @param data Frame contents
+ * @param len Length of the frame in bytes
+ * @return 1 on success, 0 on a write error
+ */
+int terminal_write_frame(const char* data, size_t len);
+
+/**
+ * Check whether the terminal reported support for synchronized output
+ * @return 1 if frames are wrapped in synchronized update markers, 0 otherwise
+ */
+int terminal_supports_sync(void);
+
 /**
  * Read a single character from terminal
  * Blocks until a character is available
@@ -184,12 +235,43 @@ InputEvent terminal_read_event(void);
 
 /**
  * Non-blocking version of terminal_read_event
- * Checks for input and returns immediately whether input is available or not
+ * Checks for input and returns immediately whether input is available or not.
+ * Input is read in large chunks, so one read may yield many events.
  * @param event Pointer to store the event if available
  * @return 1 if an event was read, 0 if no event was available
  */
 int terminal_read_event_nonblock(InputEvent* event);
 
+/**
+ * Get how long a lone ESC may still wait for the rest of a sequence
+ * After that long, terminal_read_event_nonblock returns it as the Escape key.
+ * @return Milliseconds to wait before reading events again, or -1 if nothing is pending
+ */
+int terminal_input_timeout(void);
+
+/**
+ * Callback run on the input thread after it queued events
+ * Must be safe to call from another thread.
+ */
+typedef void (*TerminalNotify)(void);
+
+/**
+ * Read and decode input on a separate thread from now on
+ * Bytes are taken from the terminal as soon as they arrive, whatever the
+ * calling thread is doing, and the decoded events are queued for
+ * terminal_read_event_nonblock. Raw character reads return nothing while
+ * the thread runs.
+ * @param notify Called after events were queued (NULL for none)
+ * @return 1 if the thread is running, 0 if it couldn't be started
+ */
+int terminal_start_input_thread(TerminalNotify notify);
+
+/**
+ * Stop the input thread and read input on the calling thread again
+ * Events still queued are dropped.
+ */
+void terminal_stop_input_thread(void);
+
 /**
  * Check if a sequence is a mouse event
  * @param sequence The character sequence to check
@@ -0,0 +1,98 @@
+#ifndef VTERM_H
+#define VTERM_H
+
+#include <stddef.h>
+
+/**
+ * Virtual Terminal Module
+ *
+ * An in-memory terminal that parses the escape sequences the renderer emits
+ * into a grid of cells, so frames can be checked and measured without a TTY.
+ * It understands cursor movement, erasing, scroll regions, scrolling and
+ * 256-color SGR; everything else is parsed and ignored. Each byte takes one
+ * cell, as in the render grid. The parser keeps its state between writes,
+ * so sequences may be split across them.
+ */
+
+// Color value for the terminal's default foreground or background
+#define VTERM_DEFAULT_COLOR -1
+
+// Most numeric parameters kept for one control sequence
+#define VTERM_MAX_PARAMS 16
+
+// One character cell
+typedef struct {
+    char ch;               // Character shown
+    short fg;              // Foreground palette index or VTERM_DEFAULT_COLOR
+    short bg;              // Background palette index or VTERM_DEFAULT_COLOR
+} VTermCell;
+
+// Forward declaration and typedef for VTerm
+struct VTerm;
+typedef struct VTerm VTerm;
+
+// Structure for the virtual terminal
+struct VTerm {
+    size_t rows;                  // Screen height
+    size_t cols;                  // Screen width
+    VTermCell* cells;             // Screen contents, row-major
+    size_t cursor_row;            // Cursor row
+    size_t cursor_col;            // Cursor column
+    int pending_wrap;             // Last column written; the next character wraps
+    short fg;                     // Current foreground
+    short bg;                     // Current background
+    size_t scroll_top;            // First row of the scroll region
+    size_t scroll_bottom;         // Last row of the scroll region
+    int state;                    // Parser state
+    char private_marker;          // '?' etc. after CSI, or 0
+    char intermediate;            // Intermediate byte before the final byte, or 0
+    long params[VTERM_MAX_PARAMS]; // Numeric parameters (-1 if omitted)
+    size_t param_count;           // Parameters seen so far
+    size_t bytes;                 // Bytes written since creation
+    size_t unknown;               // Sequences that were parsed but not understood
+};
+
+// Virtual terminal lifecycle
+/**
+ * Create a blank virtual terminal
+ * @param rows Screen height
+ * @param cols Screen width
+ * @return A new virtual terminal or NULL on error
+ */
+VTerm* vterm_create(size_t rows, size_t cols);
+
+/**
+ * Free a virtual terminal
+ * @param vterm Virtual terminal to free
+ */
+void vterm_free(VTerm* vterm);
+
+// Output
+/**
+ * Feed output to the virtual terminal
+ * @param vterm Virtual terminal to update
+ * @param data Bytes written to the terminal
+ * @param len Number of bytes
+ */
+void vterm_write(VTerm* vterm, const char* data, size_t len);
+
+/**
+ * Output sink adapter for vterm_write
+ * @param context Virtual terminal
+ * @param data Bytes written to the terminal
+ * @param len Number of bytes
+ * @return 1 on success, 0 on error
+ */
+int vterm_sink_write(void* context, const char* data, size_t len);
+
+// Inspection
+/**
+ * Get a cell of the screen
+ * @param vterm Virtual terminal to query
+ * @param row Cell row
+ * @param col Cell column
+ * @return The cell, or NULL if out of range
+ */
+const VTermCell* vterm_cell(const VTerm* vterm, size_t row, size_t col);
+
+#endif // VTERM_H
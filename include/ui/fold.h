@@ -0,0 +1,126 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <stddef.h>
+
+/**
+ * Fold Module
+ *
+ * Tracks collapsed line ranges. Each fold keeps its header line visible and
+ * hides the lines after it up to and including its end line. Top-level folds
+ * are kept in a balanced tree ordered by header line and augmented with the
+ * number of hidden lines per subtree, so mapping between buffer lines and
+ * visible rows takes O(log n) no matter how many lines are hidden. Folds
+ * collapsed inside another fold are parked under it and come back when it is
+ * expanded. Line positions shift lazily, so edits also cost O(log n).
+ */
+
+// Forward declaration and typedef for FoldNode
+struct FoldNode;
+typedef struct FoldNode FoldNode;
+
+// Structure for a collapsed fold
+struct FoldNode {
+    size_t start;          // Header line (stays visible)
+    size_t end;            // Last hidden line
+    long shift;            // Pending line shift for left, right and nested
+    size_t hidden;         // Hidden lines in this subtree (nested not counted)
+    unsigned priority;     // Heap priority for balancing
+    FoldNode* left;        // Folds before this one
+    FoldNode* right;       // Folds after this one
+    FoldNode* nested;      // Folds collapsed inside this one
+};
+
+// Forward declaration and typedef for FoldSet
+struct FoldSet;
+typedef struct FoldSet FoldSet;
+
+// Structure for the set of collapsed folds
+struct FoldSet {
+    FoldNode* root;        // Tree of top-level folds
+    unsigned seed;         // State of the priority generator
+};
+
+// Fold set lifecycle
+/**
+ * Create an empty fold set
+ * @return A new fold set or NULL on error
+ */
+FoldSet* fold_set_create(void);
+
+/**
+ * Free a fold set and all of its folds
+ * @param folds Fold set to free
+ */
+void fold_set_free(FoldSet* folds);
+
+// Folding
+/**
+ * Collapse a line range
+ * Folds already collapsed inside the range are nested under the new fold.
+ * @param folds Fold set to update
+ * @param start Header line that stays visible
+ * @param end Last line to hide (must be greater than start)
+ * @return 1 on success, 0 if the range is empty, hidden or partially overlaps a fold
+ */
+int fold_set_add(FoldSet* folds, size_t start, size_t end);
+
+/**
+ * Expand the top-level fold whose header is at a line
+ * @param folds Fold set to update
+ * @param start Header line of the fold
+ * @return 1 if a fold was expanded, 0 otherwise
+ */
+int fold_set_remove(FoldSet* folds, size_t start);
+
+/**
+ * Expand all folds
+ * @param folds Fold set to clear
+ */
+void fold_set_clear(FoldSet* folds);
+
+/**
+ * Update folds after lines were inserted or removed
+ * Folds touching the edited lines are expanded; folds after them move.
+ * @param folds Fold set to update
+ * @param line Line where the edit happened
+ * @param delta Lines added after line (positive) or joined into it (negative)
+ */
+void fold_set_shift(FoldSet* folds, size_t line, long delta);
+
+// Queries
+/**
+ * Find the top-level fold covering a line
+ * @param folds Fold set to query
+ * @param line Line to look up
+ * @param start Output parameter for the fold header (may be NULL)
+ * @param end Output parameter for the last hidden line (may be NULL)
+ * @return 1 if line is a fold header or hidden, 0 otherwise
+ */
+int fold_set_find(FoldSet* folds, size_t line, size_t* start, size_t* end);
+
+/**
+ * Get total number of hidden lines
+ * @param folds Fold set to query
+ * @return Number of lines hidden by top-level folds
+ */
+size_t fold_set_hidden(FoldSet* folds);
+
+/**
+ * Map a buffer line to its visible row
+ * Hidden lines map to the row of their fold header.
+ * @param folds Fold set to query
+ * @param line Buffer line (0-based)
+ * @return Visible row (0-based)
+ */
+size_t fold_set_to_visible(FoldSet* folds, size_t line);
+
+/**
+ * Map a visible row to its buffer line
+ * @param folds Fold set to query
+ * @param row Visible row (0-based)
+ * @return Buffer line shown on that row
+ */
+size_t fold_set_from_visible(FoldSet* folds, size_t row);
+
+#endif // FOLD_H
@@ -0,0 +1,173 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Grid Module
+ *
+ * Damage tracking for the terminal. The renderer draws each frame into a back
+ * grid of cells; the front grid mirrors what the terminal currently shows.
+ * Diffing the two emits only the cells that changed, so a keystroke costs a
+ * few bytes of output instead of a full repaint. Characters and attributes
+ * are stored in separate arrays so whole rows compare with memcmp. The back
+ * grid keeps its contents between frames, and rows are flagged when a write
+ * actually changes them, so rows left alone cost nothing to diff.
+ */
+
+// Cell attributes: foreground and background palette colors (0 = terminal default)
+typedef uint32_t GridAttr;
+
+#define GRID_COLOR_BITS  9
+#define GRID_COLOR_MASK  ((1u << GRID_COLOR_BITS) - 1)
+#define GRID_FG(color)   ((GridAttr)((color) + 1))                      // 256-color foreground
+#define GRID_BG(color)   ((GridAttr)((color) + 1) << GRID_COLOR_BITS)   // 256-color background
+#define GRID_ATTR_DEFAULT 0
+
+// Unchanged cells between two changed runs that are cheaper to rewrite than to skip
+#define GRID_MERGE_GAP 4
+
+// Forward declaration and typedef for ScreenBuffer
+struct ScreenBuffer;
+typedef struct ScreenBuffer ScreenBuffer;
+
+// One grid of cells, stored row-major
+typedef struct {
+    char* chars;           // Cell characters
+    GridAttr* attrs;       // Cell attributes
+} GridCells;
+
+// Forward declaration and typedef for Grid
+struct Grid;
+typedef struct Grid Grid;
+
+// Structure for the front/back grid pair
+struct Grid {
+    size_t rows;           // Grid height
+    size_t cols;           // Grid width
+    GridCells front;       // What the terminal shows
+    GridCells back;        // Frame being drawn
+    unsigned char* dirty;  // Per row: back may differ from front
+    int invalid;           // Front grid unknown; repaint everything next diff
+    size_t cursor_row;     // Terminal cursor row (SIZE_MAX if unknown)
+    size_t cursor_col;     // Terminal cursor column
+    size_t target_row;     // Where the cursor goes once the frame is drawn
+    size_t target_col;
+};
+
+// Grid lifecycle
+/**
+ * Create a grid pair
+ * @param rows Grid height
+ * @param cols Grid width
+ * @return A new grid or NULL on error
+ */
+Grid* grid_create(size_t rows, size_t cols);
+
+/**
+ * Free a grid pair
+ * @param grid Grid to free
+ */
+void grid_free(Grid* grid);
+
+/**
+ * Change grid dimensions
+ * Does nothing if the size is unchanged; otherwise the next diff repaints.
+ * @param grid Grid to resize
+ * @param rows New height
+ * @param cols New width
+ * @return 1 on success, 0 on error
+ */
+int grid_resize(Grid* grid, size_t rows, size_t cols);
+
+/**
+ * Forget what the terminal shows so the next diff repaints everything
+ * @param grid Grid to invalidate
+ */
+void grid_invalidate(Grid* grid);
+
+// Drawing into the back grid
+/**
+ * Blank the whole back grid
+ * @param grid Grid to clear
+ */
+void grid_clear(Grid* grid);
+
+/**
+ * Write text into a row of the back grid, clipped to the row
+ * Control characters are drawn as spaces.
+ * @param grid Grid to draw into
+ * @param row Row to draw on
+ * @param col First column
+ * @param text Text to write
+ * @param len Number of bytes to write
+ * @param attr Attributes for the written cells
+ * @return Number of cells written
+ */
+size_t grid_write(Grid* grid, size_t row, size_t col, const char* text, size_t len, GridAttr attr);
+
+/**
+ * Write a right-aligned unsigned integer into a row of the back grid
+ * @param grid Grid to draw into
+ * @param row Row to draw on
+ * @param col First column
+ * @param width Minimum number of cells, padded with spaces on the left
+ * @param value Value to write
+ * @param attr Attributes for the written cells
+ * @return Number of cells written
+ */
+size_t grid_write_uint(Grid* grid, size_t row, size_t col, size_t width, size_t value, GridAttr attr);
+
+/**
+ * Fill cells of a row of the back grid, clipped to the row
+ * @param grid Grid to draw into
+ * @param row Row to draw on
+ * @param col First column
+ * @param count Number of cells
+ * @param ch Character to fill with
+ * @param attr Attributes for the filled cells
+ */
+void grid_fill(Grid* grid, size_t row, size_t col, size_t count, char ch, GridAttr attr);
+
+/**
+ * Replace the whole back grid with a frame drawn elsewhere
+ * Rows are flagged only where they differ from what the terminal shows.
+ * @param grid Grid to draw into
+ * @param cells Cells of a frame the size of the grid
+ */
+void grid_load(Grid* grid, const GridCells* cells);
+
+/**
+ * Set where the terminal cursor is left after the frame
+ * @param grid Grid to update
+ * @param row Cursor row
+ * @param col Cursor column
+ */
+void grid_set_cursor(Grid* grid, size_t row, size_t col);
+
+// Output
+/**
+ * Scroll a band of rows on the terminal and in both grids
+ * Uses a scroll region so only the rows exposed at one edge need drawing.
+ * Must be called before grid_diff for the frame; does nothing while the
+ * grid is invalid. Without a screen buffer only the grid moves, for a frame
+ * that another grid puts on the terminal.
+ * @param grid Grid to scroll
+ * @param out Screen buffer receiving the escape sequences, or NULL
+ * @param top First row of the band
+ * @param bottom Last row of the band
+ * @param delta Rows the content moves up (positive) or down (negative)
+ * @return 1 if the band was scrolled, 0 otherwise
+ */
+int grid_scroll(Grid* grid, ScreenBuffer* out, size_t top, size_t bottom, long delta);
+
+/**
+ * Emit the changes from the front grid to the back grid
+ * Afterwards the front grid matches the back grid.
+ * @param grid Grid to diff
+ * @param out Screen buffer receiving the escape sequences
+ */
+void grid_diff(Grid* grid, ScreenBuffer* out);
+
+#endif // GRID_H
@@ -0,0 +1,57 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include "grid.h"
+#include "latency.h"
+
+/**
+ * Render Thread Module
+ *
+ * Puts frames on the terminal from a thread of their own, so a slow or
+ * congested terminal never holds up editing. The editor thread still draws
+ * each frame into its grid, then hands over a snapshot of the cells, the
+ * cursor position and how far the text scrolled. The snapshot is copied into
+ * one of two frame slots: the editor fills the pending slot while the render
+ * thread diffs the other against what the terminal shows and writes it out.
+ * A frame submitted before the previous one was taken replaces it, so when
+ * the editor produces frames faster than the terminal accepts them the
+ * intermediate ones are dropped and only the latest is drawn. Scroll offsets
+ * of replaced frames add up, so a dropped frame still scrolls the terminal
+ * instead of repainting the rows it moved.
+ */
+
+/**
+ * Start writing frames on a separate thread
+ * Until render_stop_thread, frames go to render_submit_frame and nothing
+ * else may write to the terminal.
+ * @return 1 if the thread is running, 0 if it couldn't be started
+ */
+int render_start_thread(void);
+
+/**
+ * Stop the render thread
+ * Waits for a frame being written to finish; a frame not taken yet is dropped.
+ */
+void render_stop_thread(void);
+
+/**
+ * Check whether frames go to the render thread
+ * @return 1 if the render thread is running, 0 otherwise
+ */
+int render_thread_running(void);
+
+/**
+ * Hand the frame drawn in a grid's back buffer to the render thread
+ * The grid's request for a full repaint is passed on and cleared; the grid
+ * never writes to the terminal itself while the thread runs.
+ * @param grid Grid holding the frame
+ * @param top First row of the band that scrolled
+ * @param bottom Last row of the band that scrolled
+ * @param scroll Rows the band moved up (negative: down) since the last frame, 0 if none
+ * @param trace Latency timestamps of the frame, completed once it is written
+ * @return 1 on success, 0 if the frame couldn't be stored
+ */
+int render_submit_frame(Grid* grid, size_t top, size_t bottom, long scroll, const LatencyFrame* trace);
+
+#endif // RENDER_H
@@ -0,0 +1,107 @@
+#ifndef ROWCACHE_H
+#define ROWCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Row Cache Module
+ *
+ * Remembers what each text row of the screen was rendered from, so a frame
+ * only re-formats rows whose inputs changed. The rendered cells themselves
+ * live in the back grid, which keeps its contents between frames; a row whose
+ * key still matches is left untouched there and costs nothing to redraw.
+ */
+
+// Line value for rows past the end of the content
+#define ROW_EMPTY SIZE_MAX
+
+// Row highlight state
+#define ROW_CURRENT 0x1       // Row shows the cursor line
+#define ROW_FOLDED  0x2       // Row shows a collapsed fold header
+
+// Everything a rendered text row depends on besides the line's text
+typedef struct {
+    size_t line;           // Buffer line shown (ROW_EMPTY if none)
+    size_t scroll_x;       // Horizontal scroll offset
+    size_t width;          // Screen width
+    unsigned flags;        // ROW_* highlight state
+    unsigned syntax;       // Lexer state at the start of the line
+    int valid;             // Whether the row holds anything reusable
+} RowKey;
+
+// Forward declaration and typedef for RowCache
+struct RowCache;
+typedef struct RowCache RowCache;
+
+// Structure for the keys of the rows on screen
+struct RowCache {
+    RowKey* keys;          // Key per screen row
+    RowKey* next;          // Keys of the frame being drawn
+    size_t rows;           // Number of rows
+};
+
+// Row cache lifecycle
+/**
+ * Create a row cache with every row invalid
+ * @param rows Number of screen rows
+ * @return A new row cache or NULL on error
+ */
+RowCache* row_cache_create(size_t rows);
+
+/**
+ * Free a row cache
+ * @param cache Row cache to free
+ */
+void row_cache_free(RowCache* cache);
+
+/**
+ * Change the number of rows, invalidating every row if it differs
+ * @param cache Row cache to resize
+ * @param rows New number of rows
+ * @return 1 on success, 0 on error
+ */
+int row_cache_resize(RowCache* cache, size_t rows);
+
+// Invalidation
+/**
+ * Invalidate every row
+ * @param cache Row cache to update
+ */
+void row_cache_invalidate(RowCache* cache);
+
+/**
+ * Invalidate rows showing lines whose text changed
+ * @param cache Row cache to update
+ * @param from First changed line
+ * @param to Last changed line
+ */
+void row_cache_invalidate_lines(RowCache* cache, size_t from, size_t to);
+
+/**
+ * Move row keys along with rows scrolled on screen
+ * @param cache Row cache to update
+ * @param delta Rows the content moved up (positive) or down (negative)
+ */
+void row_cache_scroll(RowCache* cache, long delta);
+
+// Lookup
+/**
+ * Find a vertical shift that lines up the last frame with the next one
+ * Compares the keys in next with the cached keys.
+ * @param cache Row cache to query
+ * @return Rows the content moved up (positive) or down (negative), 0 if it
+ *         didn't move or too few rows would be reused
+ */
+long row_cache_find_shift(const RowCache* cache);
+
+/**
+ * Check whether a row was rendered from a key, recording the key if not
+ * @param cache Row cache to query
+ * @param row Screen row
+ * @param key Inputs of the row in this frame
+ * @return 1 if the row can be reused as is, 0 if it must be redrawn
+ */
+int row_cache_check(RowCache* cache, size_t row, const RowKey* key);
+
+#endif // ROWCACHE_H
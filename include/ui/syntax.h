@@ -0,0 +1,232 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "lineindex.h"
+
+/**
+ * Syntax Module
+ *
+ * Table-driven syntax highlighting. Each language is a table of comment
+ * delimiters, string rules and keyword lists, and one lexer walks all of
+ * them. The lexer state at the end of every line is cached: after an edit,
+ * re-lexing starts at the edited line and stops as soon as a line ends in
+ * the state it ended in before, so typing re-lexes a few lines rather than
+ * the file. The renderer only lexes up to the last line on screen; a worker
+ * thread lexes the rest of the file ahead of time from the same immutable
+ * text, publishing states in chunks. When the screen is far past the lines
+ * known so far, rows get provisional colors until the worker catches up.
+ */
+
+// What a run of text is highlighted as
+typedef enum {
+    SYNTAX_NORMAL,
+    SYNTAX_COMMENT,
+    SYNTAX_KEYWORD,
+    SYNTAX_TYPE,
+    SYNTAX_STRING,
+    SYNTAX_NUMBER,
+    SYNTAX_PREPROC,
+    SYNTAX_VARIABLE,
+    SYNTAX_CLASS_COUNT
+} SyntaxClass;
+
+// Lexer state carried from the end of one line to the start of the next
+typedef unsigned char SyntaxState;
+#define SYNTAX_STATE_NORMAL 0
+
+// Lines the renderer lexes itself to reach the screen; past that it guesses
+#define SYNTAX_SYNC_LINES 1000
+
+// Lines the worker lexes between publishing results and checking for cancellation
+#define SYNTAX_CHUNK_LINES 512
+
+// Language rules
+#define SYNTAX_PREPROCESSOR      0x01  // '#' first on a line starts a directive (C)
+#define SYNTAX_TRIPLE_QUOTES     0x02  // ''' and """ strings span lines (Python)
+#define SYNTAX_MULTILINE_STRINGS 0x04  // Quoted strings span lines (shell)
+#define SYNTAX_ESCAPED_NEWLINE   0x08  // A backslash at the end of a line continues a string
+#define SYNTAX_RAW_SINGLE_QUOTES 0x10  // No escapes inside '...' (shell)
+#define SYNTAX_VARIABLES         0x20  // $name, ${...} and $1 are variables (shell)
+#define SYNTAX_WORD_COMMENTS     0x40  // Line comments only start a word (shell)
+
+// Table describing one language
+typedef struct {
+    const char* name;                    // Display name
+    const char* const* extensions;       // File name suffixes (NULL-terminated)
+    const char* const* interpreters;     // #! interpreter names (NULL-terminated)
+    const char* line_comment;            // Starts a comment to the end of the line, or NULL
+    const char* block_comment_start;     // Opens a block comment, or NULL
+    const char* block_comment_end;       // Closes a block comment
+    const char* word_chars;              // Punctuation that continues a word
+    const char* const* keywords;         // Sorted keyword list (NULL-terminated)
+    const char* const* types;            // Sorted type or builtin list (NULL-terminated)
+    unsigned flags;                      // SYNTAX_* rules
+} SyntaxLanguage;
+
+// Called on the worker thread when lines shown with provisional colors can be drawn for real
+typedef void (*SyntaxNotify)(void);
+
+// Background lexing job and the thread running it
+// The job reads text and index without locking: the owner cancels the job
+// (and waits) before either is freed. The worker only writes states and dirty
+// at or past published, so the owner may read entries before it.
+typedef struct {
+    pthread_t thread;               // Worker thread
+    pthread_mutex_t lock;           // Guards the fields below
+    pthread_cond_t wake;            // Signalled when a job is posted or on shutdown
+    pthread_cond_t idle;            // Signalled when the worker drops or finishes a job
+    int shutdown;                   // Thread should exit
+    int pending;                    // A job is posted and not finished or cancelled
+    int cancel;                     // The owner dropped the job
+    const SyntaxLanguage* language; // Language of the job
+    const char* content;            // Immutable buffer text
+    const LineIndex* index;         // Line index of content
+    size_t first;                   // First line of the job
+    size_t lines;                   // Lines in the buffer
+    SyntaxState start;              // State carried into the first line
+    SyntaxState* states;            // End state per line from first on
+    unsigned char* dirty;           // Flags per line from first on
+    size_t capacity;                // Allocated entries in states and dirty
+    size_t published;               // Lines from first on whose states are final
+    size_t lexed;                   // Lines lexed and not yet reported
+    SyntaxNotify notify;            // Wakes the owner (may be NULL)
+    size_t notify_line;             // Call notify once published reaches this line (SIZE_MAX: never)
+} SyntaxWorker;
+
+// Forward declaration and typedef for Syntax
+struct Syntax;
+typedef struct Syntax Syntax;
+
+// Structure for the per-line lexer state of one buffer
+struct Syntax {
+    const SyntaxLanguage* language; // Language being highlighted
+    SyntaxState* states;            // Lexer state at the end of each line
+    unsigned char* dirty;           // Per line: text or start state changed since it was lexed
+    size_t lines;                   // Number of lines tracked
+    size_t capacity;                // Allocated entries in states and dirty
+    size_t stale_from;              // Lines before this one are all up to date
+    size_t lexed;                   // Lines lexed since creation
+    unsigned char* classes;         // Scratch for syntax_line_classes
+    size_t classes_capacity;        // Allocated entries in classes
+    SyntaxWorker* worker;           // Background lexer (NULL if no thread could start)
+    int job_active;                 // The worker holds results for the current text
+    size_t collected;               // Job lines already copied into states
+    SyntaxState* provisional;       // Guessed end states of the lines on screen
+    size_t provisional_first;       // First line of the guessed window
+    size_t provisional_count;       // Lines in the guessed window (0 if none)
+    size_t provisional_capacity;    // Allocated entries in provisional
+};
+
+// Language selection
+/**
+ * Pick a language for a file
+ * Matches the file name suffix first, then a #! line at the top of content.
+ * @param filename File name (may be NULL)
+ * @param content File content (may be NULL)
+ * @return Language table or NULL if none matches
+ */
+const SyntaxLanguage* syntax_detect(const char* filename, const char* content);
+
+// Syntax lifecycle
+/**
+ * Create highlighting state for a buffer
+ * @param language Language to highlight
+ * @param lines Number of lines in the buffer
+ * @return New syntax state or NULL on error
+ */
+Syntax* syntax_create(const SyntaxLanguage* language, size_t lines);
+
+/**
+ * Free highlighting state
+ * @param syntax Syntax state to free
+ */
+void syntax_free(Syntax* syntax);
+
+/**
+ * Forget every cached state, e.g. when the whole text was replaced
+ * @param syntax Syntax state to reset
+ * @param lines New number of lines
+ * @return 1 on success, 0 on error
+ */
+int syntax_reset(Syntax* syntax, size_t lines);
+
+// Edit tracking
+/**
+ * Record an edit so the affected lines are re-lexed
+ * Cancels background work first. On allocation failure the line count is set to 0 so the next
+ * syntax_reset starts over.
+ * @param syntax Syntax state to update
+ * @param line Line where the edit happened
+ * @param delta Lines added (positive) or removed (negative) after it
+ */
+void syntax_lines_changed(Syntax* syntax, size_t line, long delta);
+
+/**
+ * Bring the cached line states up to date for the lines on screen
+ * Takes whatever the worker has published, then lexes from the first stale
+ * line, skipping runs of unedited lines once a line ends in the same state
+ * as before. If the screen is more than SYNTAX_SYNC_LINES past the known
+ * states, the screen is lexed from a guessed state instead. The worker is
+ * then set to work on the rest of the file.
+ * content and index must stay valid until syntax_cancel is called.
+ * @param syntax Syntax state to update
+ * @param content Buffer text
+ * @param index Line index of content
+ * @param first First line on screen
+ * @param last Last line on screen
+ */
+void syntax_update(Syntax* syntax, const char* content, const LineIndex* index,
+                   size_t first, size_t last);
+
+/**
+ * Stop background work on the current text, keeping what it finished
+ * Must be called before the text passed to syntax_update changes or is freed.
+ * @param syntax Syntax state to update
+ */
+void syntax_cancel(Syntax* syntax);
+
+/**
+ * Have the worker announce when syntax_poll would return 1
+ * Lets the owner sleep instead of polling while the worker catches up.
+ * @param syntax Syntax state to update
+ * @param notify Function called on the worker thread (NULL for none)
+ */
+void syntax_set_notify(Syntax* syntax, SyntaxNotify notify);
+
+/**
+ * Check whether the worker has reached lines shown with provisional colors
+ * @param syntax Syntax state to query
+ * @return 1 if a render would now show real colors, 0 otherwise
+ */
+int syntax_poll(Syntax* syntax);
+
+// Highlighting
+/**
+ * Get the lexer state at the start of a line
+ * Only meaningful for lines up to the last one passed to syntax_update;
+ * may be a guess for lines shown with provisional colors.
+ * @param syntax Syntax state to query
+ * @param line Line number
+ * @return Lexer state carried into the line
+ */
+SyntaxState syntax_state_before(const Syntax* syntax, size_t line);
+
+/**
+ * Classify part of a line
+ * The whole line is lexed from its start state; only bytes from..from+count
+ * are reported. The returned array belongs to syntax and is overwritten by
+ * the next call.
+ * @param syntax Syntax state (provides the language and scratch space)
+ * @param state Lexer state at the start of the line
+ * @param text Line text, without the newline
+ * @param len Line length
+ * @param from First byte to classify
+ * @param count Number of bytes to classify
+ * @return SyntaxClass per byte, or NULL on error
+ */
+const unsigned char* syntax_line_classes(Syntax* syntax, SyntaxState state, const char* text,
+                                         size_t len, size_t from, size_t count);
+
+#endif // SYNTAX_H
@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include "editor.h"
+#include "grid.h"
 
 /**
  * UI Module
@@ -17,59 +18,116 @@
 #define LINE_NUMBER_WIDTH 6       // Width of line number column
 #define LINE_NUMBER_PADDING 3     // Padding spaces between line number and content
 #define SCROLLBAR_WIDTH 1         // Width of scrollbar in columns
+#define FOLD_MARKER '+'           // Shown in the padding of collapsed fold headers
+#define FOLD_MARKER_COLUMN 1      // Padding column holding the fold marker
 
-// Color definitions
-#define COLOR_RESET       "\x1b[0m"
-#define COLOR_LINE_NUM    "\x1b[90m"            // Gray line numbers
-#define COLOR_STATUS_BAR  "\x1b[30;47m"         // Black on white
-#define COLOR_CURRENT_LINE "\x1b[38;5;236;48;5;255m"  // Subtle highlight
-#define COLOR_SCROLLBAR_TRACK "\x1b[48;5;236m"  // Dark gray scrollbar track
-#define COLOR_SCROLLBAR_THUMB "\x1b[48;5;248m"  // Light gray scrollbar thumb
+// Color definitions (cell attributes, see grid.h)
+#define COLOR_RESET            "\x1b[0m"
+#define COLOR_LINE_NUM         GRID_FG(8)                    // Gray line numbers
+#define COLOR_STATUS_BAR       (GRID_FG(0) | GRID_BG(7))     // Black on white
+#define COLOR_CURRENT_LINE     (GRID_FG(236) | GRID_BG(255)) // Subtle highlight
+#define COLOR_CURRENT_LINE_NUM (GRID_FG(8) | GRID_BG(255))   // Line number on the highlighted line
+#define COLOR_SCROLLBAR_TRACK  GRID_BG(236)                  // Dark gray scrollbar track
+#define COLOR_SCROLLBAR_THUMB  GRID_BG(248)                  // Light gray scrollbar thumb
+
+// Syntax colors: foregrounds only, so the current line keeps its background
+#define COLOR_SYNTAX_COMMENT   GRID_FG(244)                  // Gray
+#define COLOR_SYNTAX_KEYWORD   GRID_FG(127)                  // Purple
+#define COLOR_SYNTAX_TYPE      GRID_FG(31)                   // Teal
+#define COLOR_SYNTAX_STRING    GRID_FG(64)                   // Olive green
+#define COLOR_SYNTAX_NUMBER    GRID_FG(166)                  // Orange
+#define COLOR_SYNTAX_PREPROC   GRID_FG(133)                  // Magenta
+#define COLOR_SYNTAX_VARIABLE  GRID_FG(32)                   // Blue
+
+// Maximum decimal digits of a size_t
+#define UI_UINT_DIGITS 20
+
+// Frame size estimate: escape sequences per row on top of its text
+#define FRAME_ROW_OVERHEAD 96     // Colors, clears and scrollbar positioning
+#define FRAME_FIXED_OVERHEAD 512  // Cursor placement and other per-frame output
+
+/**
+ * Destination for flushed frames
+ * Receives each frame in one call; returns 1 on success, 0 on error.
+ */
+typedef int (*ScreenSinkWrite)(void* context, const char* data, size_t len);
 
 /**
  * Screen buffer for double buffering
  * Provides efficient rendering by batching screen updates
  */
-typedef struct {
+typedef struct ScreenBuffer {
     char* content;       // Buffer content
     size_t size;         // Current size of buffer
     size_t capacity;     // Maximum capacity of buffer
+    ScreenSinkWrite sink;  // Where frames go (NULL for the terminal)
+    void* sink_context;    // Passed to sink
 } ScreenBuffer;
 
 // Screen buffer operations
 ScreenBuffer* screen_buffer_create(size_t capacity);
 void screen_buffer_free(ScreenBuffer* buffer);
+int screen_buffer_reserve(ScreenBuffer* buffer, size_t capacity);
 void screen_buffer_append(ScreenBuffer* buffer, const char* str);
+void screen_buffer_append_n(ScreenBuffer* buffer, const char* data, size_t len);
+void screen_buffer_append_repeat(ScreenBuffer* buffer, char ch, size_t count);
+void screen_buffer_append_uint(ScreenBuffer* buffer, size_t value);
 void screen_buffer_appendf(ScreenBuffer* buffer, const char* format, ...);
 void screen_buffer_flush(ScreenBuffer* buffer);
+
+/**
+ * Send flushed frames somewhere other than the terminal, e.g. a virtual terminal
+ * @param buffer Screen buffer to redirect
+ * @param sink Function receiving each frame (NULL for the terminal)
+ * @param context Passed to sink
+ */
+void screen_buffer_set_sink(ScreenBuffer* buffer, ScreenSinkWrite sink, void* context);
 void screen_buffer_clear(ScreenBuffer* buffer);
 
 // UI rendering functions
+/**
+ * Format an unsigned integer in decimal without going through printf
+ * @param out Destination with room for UI_UINT_DIGITS bytes (not NUL-terminated)
+ * @param value Value to format
+ * @return Number of digits written
+ */
+size_t ui_format_uint(char* out, size_t value);
+
+/**
+ * Estimate the bytes needed to draw one full frame
+ * @param rows Terminal row count
+ * @param cols Terminal column count
+ * @return Capacity for a screen buffer that holds a frame without growing
+ */
+size_t ui_frame_capacity(size_t rows, size_t cols);
+
 /**
  * Render the editor content and UI elements
+ * While the render thread runs, the frame is handed to it instead of written.
  * @param state Editor state containing viewport and file information
  */
 void ui_render(EditorState* state);
 
 /**
  * Display welcome screen when no file is loaded
+ * @param buffer Screen buffer to draw into
  * @param rows Terminal row count
  * @param cols Terminal column count
  */
-void ui_welcome_screen(size_t rows, size_t cols);
+void ui_welcome_screen(ScreenBuffer* buffer, size_t rows, size_t cols);
 
 /**
  * Render status bar at the bottom of the screen
  * @param state Editor state
- * @param buffer Screen buffer to write to
+ * @param grid Grid to draw into
  */
-void ui_status_bar(EditorState* state, ScreenBuffer* buffer);
+void ui_status_bar(EditorState* state, Grid* grid);
 
 /**
  * Render vertical scrollbar
  * @param state Editor state
- * @param buffer Screen buffer to write to
+ * @param grid Grid to draw into
  */
-void ui_scrollbar(EditorState* state, ScreenBuffer* buffer);
+void ui_scrollbar(EditorState* state, Grid* grid);
 
 #endif // UI_H
\ No newline at end of file
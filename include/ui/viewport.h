@@ -2,6 +2,10 @@
 #define VIEWPORT_H
 
 #include <stddef.h>
+#include "lineindex.h"
+#include "fold.h"
+#include "anchor.h"
+#include "syntax.h"
 
 /**
  * Viewport Module
@@ -11,6 +15,9 @@
  * It represents part of the View in the MVC architecture.
  */
 
+// Lines per stored line index sample; raise to trade lookup time for memory
+#define VIEWPORT_LINE_STRIDE LINE_INDEX_DEFAULT_STRIDE
+
 // Forward declaration of editor state (to avoid circular dependency)
 struct EditorState;
 typedef struct EditorState EditorState;
@@ -31,8 +38,14 @@ struct Viewport {
     size_t screen_cols;    // Terminal width
     size_t total_lines;    // Total number of lines in buffer
     char* content;         // Content string (owner of memory)
-    char** line_cache;     // Cache of line start positions
-    size_t line_count;     // Number of lines in cache
+    size_t content_size;   // Length of content in bytes
+    size_t content_generation; // Buffer generation the content was taken from
+    LineIndex* lines;      // Compact index of line start offsets into content
+    FoldSet* folds;        // Collapsed line ranges
+    Syntax* syntax;        // Highlighting state (NULL when no language matches)
+    Anchor* fold_mark;     // Start of a pending manual fold (owned by the buffer), or NULL
+    size_t dirty_from;     // First line edited since the last render
+    size_t dirty_to;       // Last line edited (SIZE_MAX once lines shifted; < dirty_from when clean)
 };
 
 // Viewport lifecycle
@@ -62,9 +75,10 @@ void viewport_resize(Viewport* viewport, size_t rows, size_t cols);
 // Cursor movement
 /**
  * Move cursor by relative offset
+ * Horizontal moves wrap across line ends, one step per wrap.
  * @param viewport Viewport to update
- * @param dx Horizontal movement (-1 = left, 1 = right)
- * @param dy Vertical movement (-1 = up, 1 = down)
+ * @param dx Horizontal movement in characters (negative = left, positive = right)
+ * @param dy Vertical movement in visible lines (negative = up, positive = down)
  */
 void viewport_move_cursor(Viewport* viewport, int dx, int dy);
 
@@ -110,10 +124,92 @@ size_t viewport_line_length(Viewport* viewport, size_t line_number);
 
 /**
  * Refresh the viewport's content cache
+ * Does nothing if the buffer hasn't changed since the last refresh
  * @param viewport Viewport to refresh
  */
 void viewport_refresh_cache(Viewport* viewport);
 
+// Folding
+/**
+ * Get number of lines not hidden by folds
+ * @param viewport Viewport to query
+ * @return Visible line count
+ */
+size_t viewport_visible_lines(Viewport* viewport);
+
+/**
+ * Map a buffer line to its visible row (hidden lines map to their fold header)
+ * @param viewport Viewport to query
+ * @param line Buffer line (0-based)
+ * @return Visible row (0-based)
+ */
+size_t viewport_line_to_row(Viewport* viewport, size_t line);
+
+/**
+ * Map a visible row to the buffer line shown on it
+ * @param viewport Viewport to query
+ * @param row Visible row (0-based)
+ * @return Buffer line (0-based)
+ */
+size_t viewport_row_to_line(Viewport* viewport, size_t row);
+
+/**
+ * Collapse a line range, keeping the first line visible
+ * Moves the cursor to the first line if it ends up hidden.
+ * @param viewport Viewport to update
+ * @param start First line of the range (stays visible)
+ * @param end Last line of the range
+ * @return 1 on success, 0 if the range can't be folded
+ */
+int viewport_fold(Viewport* viewport, size_t start, size_t end);
+
+/**
+ * Expand the fold whose first line is at a line
+ * @param viewport Viewport to update
+ * @param line First line of the fold
+ * @return 1 if a fold was expanded, 0 otherwise
+ */
+int viewport_unfold(Viewport* viewport, size_t line);
+
+/**
+ * Expand all folds
+ * @param viewport Viewport to update
+ */
+void viewport_unfold_all(Viewport* viewport);
+
+/**
+ * Check whether a line is the first line of a collapsed fold
+ * @param viewport Viewport to query
+ * @param line Buffer line (0-based)
+ * @return 1 if line heads a fold, 0 otherwise
+ */
+int viewport_is_folded(Viewport* viewport, size_t line);
+
+/**
+ * Get the line a buffer position falls on
+ * @param viewport Viewport to query
+ * @param pos Buffer position
+ * @return Buffer line (0-based)
+ */
+size_t viewport_line_at(Viewport* viewport, size_t pos);
+
+/**
+ * Record an edit: keep folds and lexer states in place and mark the affected lines dirty
+ * @param viewport Viewport to update
+ * @param line Line where the edit happened
+ * @param delta Lines added after line (positive) or joined into it (negative)
+ */
+void viewport_lines_changed(Viewport* viewport, size_t line, long delta);
+
+/**
+ * Take the range of lines edited since the last call
+ * @param viewport Viewport to query
+ * @param from Output parameter for the first dirty line
+ * @param to Output parameter for the last dirty line (SIZE_MAX if every later line moved)
+ * @return 1 if any line is dirty, 0 otherwise
+ */
+int viewport_take_dirty(Viewport* viewport, size_t* from, size_t* to);
+
 // Coordinate mapping
 /**
  * Convert screen coordinates to buffer position
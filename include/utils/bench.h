@@ -0,0 +1,51 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/**
+ * Bench Module
+ *
+ * Headless benchmarks for automated runs. The render benchmark opens a file
+ * in an editor that is never attached to a terminal: frames go to a virtual
+ * terminal instead, which checks after every frame that the screen it ends up
+ * with is the one the renderer drew. Frame time and bytes per frame are
+ * measured for a few typical interactions and compared against budgets.
+ *
+ * The input benchmark times the input decoder on a typical byte stream, then
+ * fuzzes it with random streams that must decode to the same events however
+ * they are split between reads.
+ */
+
+// Render benchmark defaults
+#define BENCH_DEFAULT_FRAMES 200  // Frames per scenario
+#define BENCH_DEFAULT_ROWS   50   // Virtual terminal height
+#define BENCH_DEFAULT_COLS   160  // Virtual terminal width
+
+// Input benchmark defaults
+#define BENCH_DEFAULT_INPUT_BYTES (16 * 1024 * 1024)  // Bytes decoded for timing
+#define BENCH_DEFAULT_ITERATIONS  2000                // Random streams fuzzed
+#define BENCH_DEFAULT_SEED        1                   // Seed of the first stream
+
+/**
+ * Run the render benchmark (ncode --bench-render FILE [options])
+ * Options: --frames N, --size ROWSxCOLS, --max-frame-us US (p99 budget) and
+ * --max-frame-bytes BYTES (largest frame). Budgets apply to every scenario
+ * except the full repaint.
+ * @param argc Number of arguments after --bench-render
+ * @param argv Arguments after --bench-render
+ * @return Exit status: 0 if every frame matched and stayed within budget,
+ *         1 on a mismatch or a broken budget, 2 on bad arguments
+ */
+int bench_render(int argc, char** argv);
+
+/**
+ * Run the input decoder benchmark and fuzz test (ncode --bench-input [options])
+ * Options: --bytes N (stream size for timing), --iterations N (random
+ * streams) and --seed S.
+ * @param argc Number of arguments after --bench-input
+ * @param argv Arguments after --bench-input
+ * @return Exit status: 0 if every stream decoded consistently, 1 on a
+ *         mismatch, 2 on bad arguments
+ */
+int bench_input(int argc, char** argv);
+
+#endif // BENCH_H
@@ -45,18 +45,41 @@ void cmd_move_to_end_of_document(EditorState* state);
 void cmd_move_word(EditorState* state, int direction);
 
 /**
- * Move cursor by page (screen height)
+ * Move cursor by pages (screen height)
  * @param state Editor state
- * @param direction Direction to move: 1 for down, -1 for up
+ * @param pages Pages to move: positive for down, negative for up
  */
-void cmd_page_move(EditorState* state, int direction);
+void cmd_page_move(EditorState* state, int pages);
+
+// Folding
+/**
+ * Toggle a fold at the cursor line
+ * Folds the range from the fold mark to the cursor if a mark is set,
+ * otherwise expands the fold at the cursor or collapses the block
+ * indented deeper than the cursor line.
+ * @param state Editor state
+ */
+void cmd_toggle_fold(EditorState* state);
+
+/**
+ * Set or clear the fold mark at the cursor line
+ * @param state Editor state
+ */
+void cmd_set_fold_mark(EditorState* state);
+
+/**
+ * Expand all folds
+ * @param state Editor state
+ */
+void cmd_unfold_all(EditorState* state);
 
 // Mouse handling
 /**
  * Process a mouse event
  * @param state Editor state
  * @param event Mouse event to process
+ * @param count Times it happened in a row (wheel scrolls go count times as far)
  */
-void cmd_process_mouse_event(EditorState* state, MouseEvent event);
+void cmd_process_mouse_event(EditorState* state, MouseEvent event, size_t count);
 
 #endif // COMMANDS_H
\ No newline at end of file
@@ -0,0 +1,180 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "terminal.h"
+
+/**
+ * Latency Module
+ *
+ * Measures how long input takes to show up on screen. Every event carries the
+ * time its bytes were read and the time it was decoded; the editor stamps
+ * when it dispatches the event and when the buffer changes, and each frame
+ * stamps when it starts, when it is built and when it has been written to the
+ * terminal. The time spent in each stage goes into a histogram, and the
+ * whole path from the read to the written frame (keypress to photon) is
+ * measured from the oldest input whose effect a frame shows.
+ *
+ * Histograms are HDR-style: values are counted in buckets whose width grows
+ * with the value, LATENCY_SUB_BUCKETS buckets per power of two, so any value
+ * is kept to within about 3% in fixed memory and recording is a few
+ * instructions. Nothing is measured until latency_enable is called.
+ */
+
+// Buckets per power of two (precision of about 1 / LATENCY_SUB_BUCKETS)
+#define LATENCY_SUB_BITS    5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+
+// Values from 0 up to 2^LATENCY_RANGE_BITS microseconds are kept; larger ones are clamped
+#define LATENCY_RANGE_BITS  36
+#define LATENCY_BUCKETS     ((LATENCY_RANGE_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+// Stages of the path from a keypress to the frame showing it
+typedef enum {
+    LATENCY_DECODE,    // Bytes read until decoded into an event
+    LATENCY_DISPATCH,  // Decoded until the editor dispatched it
+    LATENCY_MUTATE,    // Dispatched until the buffer changed and was re-indexed (edits only)
+    LATENCY_BUILD,     // Drawing a frame
+    LATENCY_FLUSH,     // Frame drawn until written to the terminal
+    LATENCY_TOTAL,     // Input read until a frame showing it was written
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+// Histogram of latencies in microseconds
+typedef struct {
+    uint64_t counts[LATENCY_BUCKETS]; // Values per bucket
+    uint64_t total;                   // Values recorded
+    long long sum;                    // Sum of the values, for the mean
+    long long max;                    // Largest value
+} LatencyHistogram;
+
+// Timestamps of one frame on its way to the terminal
+typedef struct {
+    long long origin_us;   // When the oldest input it shows was read (0 if none)
+    long long start_us;    // When drawing started (0 if not measured)
+    long long built_us;    // When drawing finished
+} LatencyFrame;
+
+// Histograms
+/**
+ * Empty a histogram
+ * @param histogram Histogram to reset
+ */
+void latency_histogram_reset(LatencyHistogram* histogram);
+
+/**
+ * Count one value
+ * @param histogram Histogram to update
+ * @param us Latency in microseconds (negative values count as 0)
+ */
+void latency_histogram_record(LatencyHistogram* histogram, long long us);
+
+/**
+ * Get the value below which a share of the recorded values fall
+ * Reported as the largest value in its bucket, so it never understates.
+ * @param histogram Histogram to query
+ * @param percentile Share in percent (0 to 100)
+ * @return Latency in microseconds, or -1 if nothing was recorded
+ */
+long long latency_histogram_percentile(const LatencyHistogram* histogram, double percentile);
+
+// Measuring
+/**
+ * Start measuring
+ */
+void latency_enable(void);
+
+/**
+ * Check whether latency is being measured
+ * @return 1 if enabled, 0 otherwise
+ */
+int latency_enabled(void);
+
+/**
+ * Count one latency for a stage (safe to call from any thread)
+ * @param stage Stage measured
+ * @param us Latency in microseconds
+ */
+void latency_record(LatencyStage stage, long long us);
+
+/**
+ * Get a percentile of a stage's latencies (safe to call from any thread)
+ * @param stage Stage to query
+ * @param percentile Share in percent (0 to 100)
+ * @return Latency in microseconds, or -1 if nothing was recorded
+ */
+long long latency_percentile(LatencyStage stage, double percentile);
+
+/**
+ * Note that the editor is dispatching an input event
+ * Records its decode and dispatch stages.
+ * @param event Event being dispatched
+ */
+void latency_input(const InputEvent* event);
+
+/**
+ * Note that the event being dispatched changes what is on screen
+ * The next frame is then measured from this event if it is the oldest one.
+ * Input that changes nothing never shows up, so it isn't measured.
+ */
+void latency_input_visible(void);
+
+/**
+ * Note that the event being dispatched changed the buffer
+ * Called once the view has caught up; only the first change per event counts.
+ */
+void latency_mutation(void);
+
+/**
+ * Start measuring a frame
+ * The frame shows the visible input dispatched since the last frame.
+ * @param frame Set to the frame's timestamps
+ */
+void latency_frame_begin(LatencyFrame* frame);
+
+/**
+ * Note that a frame has been drawn and is ready to write
+ * @param frame Frame being measured
+ */
+void latency_frame_built(LatencyFrame* frame);
+
+/**
+ * Note that a frame has been written to the terminal
+ * @param frame Frame being measured
+ */
+void latency_frame_written(const LatencyFrame* frame);
+
+/**
+ * Fold a frame that was dropped into the one replacing it
+ * The replacing frame shows the dropped frame's input as well.
+ * @param frame Frame that replaces it
+ * @param dropped Frame that will never be written
+ */
+void latency_frame_merge(LatencyFrame* frame, const LatencyFrame* dropped);
+
+// Reporting
+/**
+ * Format a latency for display (microseconds below 1 ms, milliseconds above)
+ * @param out Destination
+ * @param size Size of out
+ * @param us Latency in microseconds, or -1 for none
+ * @return Number of characters written (excluding the terminator)
+ */
+size_t latency_format(char* out, size_t size, long long us);
+
+/**
+ * Write every stage's histogram to a file
+ * @param path File to write
+ * @return 1 on success, 0 on error
+ */
+int latency_dump(const char* path);
+
+/**
+ * Get the short name of a stage
+ * @param stage Stage to name
+ * @return Name used in reports
+ */
+const char* latency_stage_name(LatencyStage stage);
+
+#endif // LATENCY_H
@@ -0,0 +1,51 @@
+#ifndef PTYBENCH_H
+#define PTYBENCH_H
+
+/**
+ * Pty Benchmark Module
+ *
+ * Measures the editor end to end, the way a user sees it: the editor binary
+ * runs in a pseudo-terminal the benchmark controls, scripted keystrokes,
+ * pastes and wheel scrolls are written to it at a fixed rate, and its output
+ * is parsed by a virtual terminal to find when each input's effect shows up
+ * on screen. Nothing needs a real terminal, so event loop and renderer
+ * changes can be compared on any machine.
+ *
+ * Each workload runs twice. A reference run sends one input at a time and
+ * waits for the screen to settle, recording what the screen looks like after
+ * every input. The measured run then sends the same inputs at the requested
+ * rate to a fresh editor; an input counts as shown by the first frame that
+ * ends on its screen or a later one, so frames the editor merges or drops
+ * are handled. Screens are compared by their characters and cursor position
+ * only, without the status bar and colors, which change on their own.
+ *
+ * Frames are delimited by the synchronized output markers, which the
+ * benchmark tells the editor it supports; the editor's terminal queries are
+ * answered like a real terminal would.
+ */
+
+// Pty benchmark defaults
+#define PTYBENCH_DEFAULT_INPUTS     100    // Inputs per workload
+#define PTYBENCH_DEFAULT_RATE       200    // Inputs per second (0 = one at a time)
+#define PTYBENCH_DEFAULT_ROWS       40     // Pseudo-terminal height
+#define PTYBENCH_DEFAULT_COLS       120    // Pseudo-terminal width
+#define PTYBENCH_DEFAULT_PASTE      256    // Bytes per paste
+#define PTYBENCH_DEFAULT_LINES      20000  // Lines in the generated file
+#define PTYBENCH_DEFAULT_TIMEOUT_MS 2000   // Longest wait for any progress
+
+/**
+ * Run the pty benchmark (ncode --bench-pty [FILE] [options] [-- EDITOR OPTIONS])
+ * Options: --inputs N, --rate N (inputs per second, 0 for one at a time),
+ * --size ROWSxCOLS, --workload keys|paste|mouse|mixed (default: all),
+ * --paste-bytes N, --timeout-ms MS and --editor PATH (binary to run instead
+ * of this one). Arguments after -- are passed to the editor before the file.
+ * Without FILE a C source file is generated and removed afterwards.
+ * @param program Path of the running binary, run as the editor by default
+ * @param argc Number of arguments after --bench-pty
+ * @param argv Arguments after --bench-pty
+ * @return Exit status: 0 if every input showed up, 1 if one never did or
+ *         the editor couldn't be run, 2 on bad arguments
+ */
+int ptybench_run(const char* program, int argc, char** argv);
+
+#endif // PTYBENCH_H
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include "anchor.h"
+
+// Seed for the priority generator
+#define ANCHOR_SEED 0x2545f491u
+
+// xorshift32: cheap priorities are all a treap needs
+static unsigned next_priority(AnchorSet* anchors) {
+    unsigned x = anchors->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    anchors->seed = x;
+    return x;
+}
+
+// Move a whole subtree by delta bytes, deferring the work below its root
+static void apply_shift(Anchor* node, long delta) {
+    if (!node || delta == 0) return;
+    node->offset += delta;
+    node->shift += delta;
+}
+
+// Hand a pending shift down to the children
+static void push(Anchor* node) {
+    if (node->shift == 0) return;
+    apply_shift(node->left, node->shift);
+    apply_shift(node->right, node->shift);
+    node->shift = 0;
+}
+
+static void set_left(Anchor* node, Anchor* child) {
+    node->left = child;
+    if (child) child->parent = node;
+}
+
+static void set_right(Anchor* node, Anchor* child) {
+    node->right = child;
+    if (child) child->parent = node;
+}
+
+static void set_root(AnchorSet* anchors, Anchor* root) {
+    anchors->root = root;
+    if (root) root->parent = NULL;
+}
+
+// Split into anchors before key and anchors at or after key
+static void split(Anchor* node, size_t key, Anchor** before, Anchor** after) {
+    if (!node) {
+        *before = NULL;
+        *after = NULL;
+        return;
+    }
+
+    push(node);
+    if (node->offset < key) {
+        Anchor* right;
+        split(node->right, key, &right, after);
+        set_right(node, right);
+        *before = node;
+    } else {
+        Anchor* left;
+        split(node->left, key, before, &left);
+        set_left(node, left);
+        *after = node;
+    }
+}
+
+// Join two trees where every anchor in a comes before every anchor in b
+static Anchor* merge(Anchor* a, Anchor* b) {
+    if (!a) return b;
+    if (!b) return a;
+
+    if (a->priority > b->priority) {
+        push(a);
+        set_right(a, merge(a->right, b));
+        return a;
+    }
+
+    push(b);
+    set_left(b, merge(a, b->left));
+    return b;
+}
+
+static void free_tree(Anchor* node) {
+    if (!node) return;
+    free_tree(node->left);
+    free_tree(node->right);
+    free(node);
+}
+
+// Move every anchor of a subtree to offset (used for deleted ranges)
+static void collapse(Anchor* node, size_t offset) {
+    if (!node) return;
+    node->offset = offset;
+    node->shift = 0;
+    collapse(node->left, offset);
+    collapse(node->right, offset);
+}
+
+// Regroup anchors sitting at an insertion point by gravity
+static void split_gravity(Anchor* node, size_t pos, size_t length,
+                          Anchor** stay, Anchor** move) {
+    if (!node) return;
+
+    Anchor* left = node->left;
+    Anchor* right = node->right;
+    split_gravity(left, pos, length, stay, move);
+
+    node->left = NULL;
+    node->right = NULL;
+    node->shift = 0;
+    if (node->gravity == ANCHOR_RIGHT) {
+        node->offset = pos + length;
+        *move = merge(*move, node);
+    } else {
+        node->offset = pos;
+        *stay = merge(*stay, node);
+    }
+
+    split_gravity(right, pos, length, stay, move);
+}
+
+AnchorSet* anchor_set_create(void) {
+    AnchorSet* anchors = malloc(sizeof(AnchorSet));
+    if (!anchors) return NULL;
+
+    anchors->root = NULL;
+    anchors->count = 0;
+    anchors->seed = ANCHOR_SEED;
+    return anchors;
+}
+
+void anchor_set_free(AnchorSet* anchors) {
+    if (!anchors) return;
+    free_tree(anchors->root);
+    free(anchors);
+}
+
+Anchor* anchor_create(AnchorSet* anchors, size_t offset, AnchorGravity gravity) {
+    if (!anchors) return NULL;
+
+    Anchor* anchor = malloc(sizeof(Anchor));
+    if (!anchor) return NULL;
+
+    anchor->offset = offset;
+    anchor->shift = 0;
+    anchor->gravity = gravity;
+    anchor->priority = next_priority(anchors);
+    anchor->left = NULL;
+    anchor->right = NULL;
+    anchor->parent = NULL;
+
+    Anchor *before, *after;
+    split(anchors->root, offset, &before, &after);
+    set_root(anchors, merge(merge(before, anchor), after));
+    anchors->count++;
+
+    return anchor;
+}
+
+void anchor_remove(AnchorSet* anchors, Anchor* anchor) {
+    if (!anchors || !anchor) return;
+
+    // Shifts pending above the anchor still apply to whatever replaces it
+    push(anchor);
+    Anchor* replacement = merge(anchor->left, anchor->right);
+    Anchor* parent = anchor->parent;
+
+    if (!parent) {
+        set_root(anchors, replacement);
+    } else if (parent->left == anchor) {
+        set_left(parent, replacement);
+    } else {
+        set_right(parent, replacement);
+    }
+
+    free(anchor);
+    anchors->count--;
+}
+
+size_t anchor_offset(const Anchor* anchor) {
+    if (!anchor) return 0;
+
+    size_t offset = anchor->offset;
+    for (const Anchor* node = anchor->parent; node; node = node->parent) {
+        offset += node->shift;
+    }
+    return offset;
+}
+
+void anchor_set_insert(AnchorSet* anchors, size_t pos, size_t length) {
+    if (!anchors || length == 0) return;
+
+    Anchor *before, *at, *after;
+    split(anchors->root, pos, &before, &at);
+    split(at, pos + 1, &at, &after);
+
+    // Everything after the insertion point moves in one step
+    apply_shift(after, (long)length);
+
+    // Anchors exactly at the insertion point follow their gravity
+    Anchor* stay = NULL;
+    Anchor* move = NULL;
+    split_gravity(at, pos, length, &stay, &move);
+
+    set_root(anchors, merge(merge(before, stay), merge(move, after)));
+}
+
+void anchor_set_delete(AnchorSet* anchors, size_t pos, size_t length) {
+    if (!anchors || length == 0) return;
+
+    Anchor *before, *inside, *after;
+    split(anchors->root, pos, &before, &inside);
+    split(inside, pos + length, &inside, &after);
+
+    collapse(inside, pos);
+    apply_shift(after, -(long)length);
+
+    set_root(anchors, merge(merge(before, inside), after));
+}
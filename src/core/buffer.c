@@ -26,8 +26,11 @@ Buffer* buffer_create(const char* content) {
     buffer->add_size = 0;
     buffer->add_capacity = INITIAL_ADD_CAPACITY;
     buffer->modified = 0; // Initialize modified flag to false
+    buffer->generation = 0;
+    buffer->anchors = anchor_set_create();
+    buffer->head = NULL;
     
-    if (!buffer->original || !buffer->add) {
+    if (!buffer->original || !buffer->add || !buffer->anchors) {
         buffer_free(buffer);
         return NULL;
     }
@@ -53,6 +56,7 @@ void buffer_free(Buffer* buffer) {
         current = next;
     }
 
+    anchor_set_free(buffer->anchors);
     free(buffer->original);
     free(buffer->add);
     free(buffer);
@@ -88,10 +92,12 @@ void buffer_insert(Buffer* buffer, size_t pos, const char* text) {
         current = current->next;
     }
 
-    if (!current) return; // Position out of bounds
+    // Position out of bounds (a buffer emptied by deletes has no pieces left)
+    if (!current && (buffer->head || pos > 0)) return;
 
     // Ensure we have enough space in add buffer
     ensure_add_capacity(buffer, text_len);
+    if (buffer->add_size + text_len > buffer->add_capacity) return;
 
     // Copy new text to add buffer
     memcpy(buffer->add + buffer->add_size, text, text_len);
@@ -99,23 +105,38 @@ void buffer_insert(Buffer* buffer, size_t pos, const char* text) {
     // Split current piece if necessary
     size_t split_offset = pos - current_pos;
     Piece* new_piece = create_piece(ADD, buffer->add_size, text_len);
+    if (!new_piece) return;
     
-    if (split_offset > 0) {
+    if (split_offset == 0) {
+        // Only the first piece (or none) is entered at its start: insert before it
+        new_piece->next = current;
+        buffer->head = new_piece;
+    } else if (split_offset < current->length) {
         Piece* second_half = create_piece(current->type, 
                                         current->start + split_offset,
                                         current->length - split_offset);
+        if (!second_half) {
+            free(new_piece);
+            return;
+        }
         current->length = split_offset;
         new_piece->next = second_half;
         second_half->next = current->next;
+        current->next = new_piece;
     } else {
+        // At the end of the piece: nothing to split
         new_piece->next = current->next;
+        current->next = new_piece;
     }
     
-    current->next = new_piece;
     buffer->add_size += text_len;
     
     // Set the modified flag
     buffer->modified = 1;
+    buffer->generation++;
+    
+    // Move anchors after the insertion point
+    anchor_set_insert(buffer->anchors, pos, text_len);
 }
 
 char* buffer_get_content(Buffer* buffer) {
@@ -218,6 +239,8 @@ void buffer_delete(Buffer* buffer, size_t pos, size_t length) {
     // Set modified flag if any deletion occurred
     if (length > remaining) {
         buffer->modified = 1;
+        buffer->generation++;
+        anchor_set_delete(buffer->anchors, pos, length - remaining);
     }
 }
 
@@ -231,4 +254,18 @@ void buffer_set_modified(Buffer* buffer, int modified) {
     if (buffer) {
         buffer->modified = modified;
     }
+}
+
+Anchor* buffer_anchor_create(Buffer* buffer, size_t pos, AnchorGravity gravity) {
+    if (!buffer) return NULL;
+    return anchor_create(buffer->anchors, pos, gravity);
+}
+
+void buffer_anchor_remove(Buffer* buffer, Anchor* anchor) {
+    if (!buffer) return;
+    anchor_remove(buffer->anchors, anchor);
+}
+
+size_t buffer_generation(Buffer* buffer) {
+    return buffer ? buffer->generation : 0;
 }
\ No newline at end of file
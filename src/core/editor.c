@@ -1,16 +1,21 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h> // For usleep
+#include <time.h>
 #include "editor.h"
 #include "buffer.h"
 #include "viewport.h"
 #include "ui.h"
+#include "rowcache.h"
 #include "commands.h"
 #include "io.h"
 #include "terminal.h"
-
-#define SLEEP_LENGTH 5 * 1000
+#include "eventloop.h"
+#include "coalesce.h"
+#include "linescan.h"
+#include "render.h"
+#include "latency.h"
 
 // Create and initialize editor state
 EditorState* editor_init(const char* filename, size_t rows, size_t cols) {
@@ -24,10 +29,31 @@ EditorState* editor_init(const char* filename, size_t rows, size_t cols) {
     state->dirty = 0;
     state->rows = rows;
     state->cols = cols;
+    state->needs_render = 1;
+    state->last_render = 0;
+    state->resize_pending = 0;
+    
+    // Frame buffer is sized once for the terminal and reused by every render;
+    // the grid remembers what is on screen so frames only send what changed,
+    // and the row cache what each text row was drawn from
+    state->screen = screen_buffer_create(ui_frame_capacity(rows, cols));
+    state->grid = grid_create(rows, cols);
+    state->row_cache = row_cache_create(rows > 0 ? rows - 1 : 0);
+    if (!state->screen || !state->grid || !state->row_cache) {
+        screen_buffer_free(state->screen);
+        grid_free(state->grid);
+        row_cache_free(state->row_cache);
+        free(state->filename);
+        free(state);
+        return NULL;
+    }
     
     // Load file into buffer if provided
     if (filename) {
         if (!editor_open_file(state, filename)) {
+            screen_buffer_free(state->screen);
+            grid_free(state->grid);
+            row_cache_free(state->row_cache);
             free(state->filename);
             free(state);
             return NULL;
@@ -36,6 +62,9 @@ EditorState* editor_init(const char* filename, size_t rows, size_t cols) {
         // Create empty buffer
         state->buffer = buffer_create("");
         if (!state->buffer) {
+            screen_buffer_free(state->screen);
+            grid_free(state->grid);
+            row_cache_free(state->row_cache);
             free(state->filename);
             free(state);
             return NULL;
@@ -45,6 +74,9 @@ EditorState* editor_init(const char* filename, size_t rows, size_t cols) {
         state->viewport = viewport_create(state, rows, cols);
         if (!state->viewport) {
             buffer_free(state->buffer);
+            screen_buffer_free(state->screen);
+            grid_free(state->grid);
+            row_cache_free(state->row_cache);
             free(state->filename);
             free(state);
             return NULL;
@@ -66,52 +98,141 @@ void editor_free(EditorState* state) {
         buffer_free(state->buffer);
     }
     
+    screen_buffer_free(state->screen);
+    grid_free(state->grid);
+    row_cache_free(state->row_cache);
     free(state->filename);
     free(state);
 }
 
+// Current time in microseconds on a clock that never jumps
+static long long editor_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Draw a frame now and note when it was drawn
+static void editor_render_frame(EditorState* state) {
+    ui_render(state);
+    state->needs_render = 0;
+    state->last_render = editor_now_us();
+}
+
+// Whether enough time has passed since the last frame to draw another
+static int editor_frame_due(EditorState* state) {
+    return editor_now_us() - state->last_render >= 1000000 / EDITOR_MAX_FPS;
+}
+
+// Milliseconds until the next frame may be drawn, or -1 if none is wanted
+static int editor_frame_timeout(EditorState* state) {
+    if (!state->needs_render && !state->resize_pending) return -1;
+    
+    long long wait = state->last_render + 1000000 / EDITOR_MAX_FPS - editor_now_us();
+    return wait > 0 ? (int)((wait + 999) / 1000) : 0;
+}
+
+// Apply one (possibly coalesced) input event; returns 1 if the editor should exit
+static int editor_dispatch(EditorState* state, InputEvent* event, int* streaming) {
+    latency_input(event);
+    
+    switch (event->type) {
+        case EVENT_KEY:
+            if (terminal_is_quit(event->key)) {
+                return 1;  // Exit the editor
+            }
+            return editor_process_key_repeat(state, event->key, event->count);
+            
+        case EVENT_MOUSE:
+            if (event->mouse.type == MOUSE_DRAG ||
+                event->mouse.type == MOUSE_WHEEL_UP ||
+                event->mouse.type == MOUSE_WHEEL_DOWN) {
+                *streaming = 1;
+            }
+            if (state->viewport) {
+                cmd_process_mouse_event(state, event->mouse, event->count);
+            }
+            return 0;
+            
+        case EVENT_PASTE:
+            editor_paste(state, event->paste.text, event->paste.length);
+            free(event->paste.text);
+            return 0;
+            
+        default:
+            return 0;
+    }
+}
+
 // Run editor main loop
 int editor_run(EditorState* state) {
     if (!state) return -1;
     
+    // The syntax worker wakes the loop when provisional colors can be replaced
+    if (state->viewport) {
+        syntax_set_notify(state->viewport->syntax, eventloop_wake);
+    }
+    
     // Initial render
-    ui_render(state);
+    editor_render_frame(state);
     
     // Main input loop
     while (1) {
-        // Check for terminal size changes
-        size_t new_rows, new_cols;
-        terminal_get_size(&new_rows, &new_cols);
-        
-        if (new_rows != state->rows || new_cols != state->cols) {
-            editor_resize(state, new_rows, new_cols);
+        // Re-read the size after SIGWINCH at most once per frame, so dragging
+        // a window edge relayouts and renders once per frame at the latest size
+        if (state->resize_pending && editor_frame_due(state)) {
+            size_t new_rows, new_cols;
+            terminal_get_size(&new_rows, &new_cols);
+            state->resize_pending = 0;
+            
+            if (new_rows != state->rows || new_cols != state->cols) {
+                editor_resize(state, new_rows, new_cols);
+            }
         }
         
-        // Read input event (key or mouse) non-blocking
-        InputEvent event;
-        if (terminal_read_event_nonblock(&event)) {
-            // Only process events if they're available
-            switch (event.type) {
-                case EVENT_KEY:
-                    if (terminal_is_quit(event.key)) {
-                        return 0;  // Exit the editor
-                    }
-                    if (editor_process_key(state, event.key)) {
-                        return 0;  // Exit signaled by key handler
-                    }
-                    break;
-                    
-                case EVENT_MOUSE:
-                    editor_process_mouse(state, event.mouse);
-                    break;
-                    
-                default:
-                    break;
+        // Apply every pending event before drawing anything, with runs of
+        // repeated motions, wheel notches and drag positions merged first
+        InputEvent event, ready;
+        Coalescer coalescer;
+        coalesce_init(&coalescer);
+        int streaming = 0; // Drags and wheel scrolls arrive as continuous streams
+        while (terminal_read_event_nonblock(&event)) {
+            if (coalesce_push(&coalescer, &event, &ready) &&
+                editor_dispatch(state, &ready, &streaming)) {
+                return 0;
             }
         }
+        if (coalesce_flush(&coalescer, &ready) && editor_dispatch(state, &ready, &streaming)) {
+            return 0;
+        }
         
-        // Add a small sleep to avoid consuming 100% CPU
-        usleep(SLEEP_LENGTH); // Sleep for 10ms
+        // Redraw rows shown with provisional colors once real ones are ready
+        if (state->viewport && syntax_poll(state->viewport->syntax)) {
+            editor_request_render(state);
+        }
+        
+        // One frame for the whole batch; streams are capped at EDITOR_MAX_FPS
+        // and their last state is drawn once they stop. A pending resize
+        // draws the frame at the new size instead.
+        if (state->needs_render && !state->resize_pending &&
+            (!streaming || editor_frame_due(state))) {
+            editor_render_frame(state);
+        }
+        
+        // Sleep until input, a resize or worker wakeup, a held-back frame is
+        // due, or a lone ESC has waited long enough to be the Escape key
+        int timeout = editor_frame_timeout(state);
+        int input_timeout = terminal_input_timeout();
+        if (input_timeout >= 0 && (timeout < 0 || input_timeout < timeout)) {
+            timeout = input_timeout;
+        }
+        int woke = eventloop_wait(timeout);
+        if (woke & EVENTLOOP_HANGUP) {
+            return 0;
+        }
+        if (woke & EVENTLOOP_RESIZE) {
+            state->resize_pending = 1;
+        }
     }
     
     return 0;
@@ -207,62 +328,77 @@ int editor_save_file(EditorState* state, const char* filename) {
     return success;
 }
 
+/**
+ * Get the buffer offset of the cursor
+ * (cursor_x and cursor_y are a position in the text, not on the screen)
+ */
+static size_t editor_cursor_offset(EditorState* state) {
+    Viewport* viewport = state->viewport;
+    if (viewport->cursor_y >= line_index_count(viewport->lines)) return viewport->content_size;
+
+    size_t length = viewport_line_length(viewport, viewport->cursor_y);
+    size_t x = viewport->cursor_x < length ? viewport->cursor_x : length;
+    return line_index_start(viewport->lines, viewport->cursor_y) + x;
+}
+
+/**
+ * Put the cursor on a buffer offset (the line index must be up to date)
+ */
+static void editor_cursor_to_offset(EditorState* state, size_t pos) {
+    Viewport* viewport = state->viewport;
+    size_t line = line_index_line_at(viewport->lines, pos);
+    viewport_set_cursor(viewport, pos - line_index_start(viewport->lines, line), line);
+}
+
 // Content manipulation
 void editor_insert_text(EditorState* state, const char* text) {
     if (!state || !state->buffer || !state->viewport || !text) return;
     
-    // Calculate buffer position from cursor
-    size_t buffer_pos = viewport_screen_to_buffer_pos(
-        state->viewport, 
-        state->viewport->cursor_x, 
-        state->viewport->cursor_y
-    );
+    size_t len = strlen(text);
+    if (len == 0) return;
+    size_t buffer_pos = editor_cursor_offset(state);
     
     // Insert text at buffer position
     buffer_insert(state->buffer, buffer_pos, text);
     state->dirty = 1;
     
-    // Update cursor position if needed
-    size_t len = strlen(text);
-    for (size_t i = 0; i < len; i++) {
-        if (text[i] == '\n') {
-            viewport_move_cursor(state->viewport, 0, 1);
-            viewport_set_cursor(state->viewport, 0, state->viewport->cursor_y);
-        } else {
-            viewport_move_cursor(state->viewport, 1, 0);
-        }
-    }
+    // Keep folds attached to their lines and mark the edited lines for redraw
+    // (the viewport still indexes the text as it was before the insert)
+    size_t newlines = linescan_count(text, len);
+    viewport_lines_changed(state->viewport, state->viewport->cursor_y, (long)newlines);
     
-    // Refresh viewport to reflect changes
+    // Re-index once for the whole text, then place the cursor after it
     editor_refresh_view(state);
+    editor_cursor_to_offset(state, buffer_pos + len);
+    latency_mutation();
 }
 
 void editor_delete_text(EditorState* state, size_t amount) {
     if (!state || !state->buffer || !state->viewport || amount == 0) return;
     
-    // Calculate buffer position from cursor
-    size_t buffer_pos = viewport_screen_to_buffer_pos(
-        state->viewport, 
-        state->viewport->cursor_x, 
-        state->viewport->cursor_y
-    );
+    size_t buffer_pos = editor_cursor_offset(state);
     
     // Don't try to delete past the beginning
     if (buffer_pos < amount) {
         amount = buffer_pos;
     }
+    if (amount == 0) return;
+    
+    // Keep folds attached to their lines and mark the edited lines for redraw
+    // (content still holds the old text)
+    Viewport* viewport = state->viewport;
+    size_t newlines = linescan_count(viewport->content + buffer_pos - amount, amount);
+    size_t line = line_index_line_at(viewport->lines, buffer_pos - amount);
+    viewport_lines_changed(viewport, line, -(long)newlines);
     
     // Delete text from buffer
     buffer_delete(state->buffer, buffer_pos - amount, amount);
     state->dirty = buffer_is_modified(state->buffer);
     
-    // Update cursor position
-    for (size_t i = 0; i < amount; i++) {
-        viewport_move_cursor(state->viewport, -1, 0);
-    }
-    
-    // Refresh viewport to reflect changes
+    // Re-index, then place the cursor where the deleted text started
     editor_refresh_view(state);
+    editor_cursor_to_offset(state, buffer_pos - amount);
+    latency_mutation();
 }
 
 void editor_insert_newline(EditorState* state) {
@@ -270,29 +406,33 @@ void editor_insert_newline(EditorState* state) {
     editor_insert_text(state, "\n");
 }
 
+void editor_paste(EditorState* state, char* text, size_t length) {
+    if (!state || !text) return;
+    
+    // Terminals send line breaks as typed, usually \r; the buffer uses \n
+    size_t out = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '\r') {
+            if (i + 1 < length && text[i + 1] == '\n') continue;
+            text[out++] = '\n';
+        } else if (text[i] != '\0') {
+            text[out++] = text[i];
+        }
+    }
+    text[out] = '\0';
+    
+    // One insert, one re-index and one render however long the paste is
+    editor_insert_text(state, text);
+}
+
 // Input handling - only navigation, no editing
 int editor_process_key(EditorState* state, int key) {
-    if (!state || !state->viewport) return 0;
-    
+    return editor_process_key_repeat(state, key, 1);
+}
+
+// Apply a key that isn't a repeatable motion
+static int editor_process_command_key(EditorState* state, int key) {
     switch (key) {
-        // Basic cursor movement (arrow keys)
-        case KEY_ARROW_UP:
-            viewport_move_cursor(state->viewport, 0, -1);
-            ui_render(state);
-            break;
-        case KEY_ARROW_DOWN:
-            viewport_move_cursor(state->viewport, 0, 1);
-            ui_render(state);
-            break;
-        case KEY_ARROW_LEFT:
-            viewport_move_cursor(state->viewport, -1, 0);
-            ui_render(state);
-            break;
-        case KEY_ARROW_RIGHT:
-            viewport_move_cursor(state->viewport, 1, 0);
-            ui_render(state);
-            break;
-            
         // Line navigation
         case KEY_HOME:
             cmd_move_to_start_of_line(state);
@@ -301,22 +441,6 @@ int editor_process_key(EditorState* state, int key) {
             cmd_move_to_end_of_line(state);
             break;
             
-        // Document navigation
-        case KEY_PAGE_UP:
-            cmd_page_move(state, -1);
-            break;
-        case KEY_PAGE_DOWN:
-            cmd_page_move(state, 1);
-            break;
-            
-        // Word navigation
-        case KEY_WORD_LEFT:
-            cmd_move_word(state, -1);
-            break;
-        case KEY_WORD_RIGHT:
-            cmd_move_word(state, 1);
-            break;
-        
         // Document start/end
         case KEY_CTRL_HOME:
             cmd_move_to_start_of_document(state);
@@ -325,6 +449,17 @@ int editor_process_key(EditorState* state, int key) {
             cmd_move_to_end_of_document(state);
             break;
             
+        // Folding
+        case KEY_CTRL_K:
+            cmd_toggle_fold(state);
+            break;
+        case KEY_CTRL_B:
+            cmd_set_fold_mark(state);
+            break;
+        case KEY_CTRL_U:
+            cmd_unfold_all(state);
+            break;
+            
         // Ignore editing keys - we're not implementing editing yet
         case KEY_ENTER:
         case KEY_BACKSPACE:
@@ -342,8 +477,56 @@ int editor_process_key(EditorState* state, int key) {
     return 0; // Continue editing
 }
 
+int editor_process_key_repeat(EditorState* state, int key, size_t count) {
+    if (!state || !state->viewport) return 0;
+    
+    // Motions go the whole distance in one step
+    int steps = count < INT_MAX ? (int)count : INT_MAX;
+    switch (key) {
+        // Basic cursor movement (arrow keys)
+        case KEY_ARROW_UP:
+            viewport_move_cursor(state->viewport, 0, -steps);
+            editor_request_render(state);
+            return 0;
+        case KEY_ARROW_DOWN:
+            viewport_move_cursor(state->viewport, 0, steps);
+            editor_request_render(state);
+            return 0;
+        case KEY_ARROW_LEFT:
+            viewport_move_cursor(state->viewport, -steps, 0);
+            editor_request_render(state);
+            return 0;
+        case KEY_ARROW_RIGHT:
+            viewport_move_cursor(state->viewport, steps, 0);
+            editor_request_render(state);
+            return 0;
+            
+        // Document navigation
+        case KEY_PAGE_UP:
+            cmd_page_move(state, -steps);
+            return 0;
+        case KEY_PAGE_DOWN:
+            cmd_page_move(state, steps);
+            return 0;
+            
+        // Word navigation (words differ in length, so step through them)
+        case KEY_WORD_LEFT:
+        case KEY_WORD_RIGHT:
+            for (size_t i = 0; i < count; i++) {
+                cmd_move_word(state, key == KEY_WORD_RIGHT ? 1 : -1);
+            }
+            return 0;
+            
+        default:
+            for (size_t i = 0; i < count; i++) {
+                if (editor_process_command_key(state, key)) return 1;
+            }
+            return 0;
+    }
+}
+
 void editor_process_mouse(EditorState* state, MouseEvent event) {
-    cmd_process_mouse_event(state, event);
+    cmd_process_mouse_event(state, event, 1);
 }
 
 void editor_resize(EditorState* state, size_t rows, size_t cols) {
@@ -352,18 +535,37 @@ void editor_resize(EditorState* state, size_t rows, size_t cols) {
     state->rows = rows;
     state->cols = cols;
     
+    // Only a resize changes how large a frame can get
+    screen_buffer_reserve(state->screen, ui_frame_capacity(rows, cols));
+    
     if (state->viewport) {
         viewport_resize(state->viewport, rows, cols);
-        ui_render(state);
+        editor_request_render(state);
     }
 }
 
+// Anchors
+Anchor* editor_anchor_create(EditorState* state, size_t pos, AnchorGravity gravity) {
+    if (!state || !state->buffer) return NULL;
+    return buffer_anchor_create(state->buffer, pos, gravity);
+}
+
+void editor_anchor_remove(EditorState* state, Anchor* anchor) {
+    if (!state || !state->buffer || !anchor) return;
+    buffer_anchor_remove(state->buffer, anchor);
+}
+
 // State access
 char* editor_get_content(EditorState* state) {
     if (!state || !state->buffer) return NULL;
     return buffer_get_content(state->buffer);
 }
 
+size_t editor_get_generation(EditorState* state) {
+    if (!state || !state->buffer) return 0;
+    return buffer_generation(state->buffer);
+}
+
 void editor_get_cursor_position(EditorState* state, size_t* x, size_t* y) {
     if (!state || !state->viewport) {
         if (x) *x = 0;
@@ -410,33 +612,62 @@ void editor_refresh_view(EditorState* state) {
     if (!state || !state->viewport) return;
     
     viewport_refresh_cache(state->viewport);
-    ui_render(state);
+    editor_request_render(state);
+}
+
+void editor_request_render(EditorState* state) {
+    if (!state) return;
+    state->needs_render = 1;
+    latency_input_visible();
 }
 
 void editor_initialize_terminal(size_t* rows, size_t* cols) {
     terminal_init();
+    eventloop_init();
     terminal_get_size(rows, cols);
 }
 
+int editor_start_input_thread(void) {
+    // The thread wakes the loop when it queued events, so the loop no
+    // longer needs to watch the terminal itself
+    if (!terminal_start_input_thread(eventloop_wake)) return 0;
+    eventloop_watch_input(0);
+    return 1;
+}
+
+int editor_start_render_thread(void) {
+    return render_start_thread();
+}
+
 void editor_cleanup_terminal(void) {
+    // Let the frame being written finish before the terminal is reset
+    render_stop_thread();
+    
+    // Stop the input thread before the wakeup pipe it writes to goes away
+    terminal_stop_input_thread();
+    eventloop_watch_input(1);
+    eventloop_cleanup();
     terminal_cleanup();
 }
 
 void editor_show_welcome_screen(size_t rows, size_t cols) {
-    ui_welcome_screen(rows, cols);
+    ScreenBuffer* screen = screen_buffer_create(ui_frame_capacity(rows, cols));
+    ui_welcome_screen(screen, rows, cols);
+    screen_buffer_free(screen);
     
-    // Wait for user to press Ctrl+Q to quit
+    // Wait for user to press Ctrl+Q to quit, sleeping between keys
     int quit = 0;
     while (!quit) {
         char c;
-        if (terminal_read_char_nonblock(&c)) {
+        while (!quit && terminal_read_char_nonblock(&c)) {
             if (terminal_is_quit(c)) {
                 quit = 1;
             }
         }
         
-        // Add a small sleep to avoid consuming 100% CPU
-        usleep(SLEEP_LENGTH); // Sleep for 10ms
+        if (!quit && (eventloop_wait(-1) & EVENTLOOP_HANGUP)) {
+            quit = 1;
+        }
     }
 }
 
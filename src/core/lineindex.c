@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lineindex.h"
+#include "linescan.h"
+
+// Newline offsets gathered per linescan_find call while building
+#define BUILD_BATCH 1024
+
+// Per-chunk state for parallel index building
+typedef struct {
+    size_t first_newline;           // Global index of the chunk's first newline
+    size_t fixup_first;             // First sample whose block base lives in an earlier chunk
+    size_t fixup_count;             // Number of entries in fixup
+    uint64_t fixup[LINE_INDEX_BLOCK]; // Absolute offsets of those samples
+} ChunkState;
+
+typedef struct {
+    LineIndex* index;
+    ChunkState* chunks;
+} BuildJob;
+
+static void count_chunk(void* ctx, size_t chunk, size_t begin, size_t end) {
+    BuildJob* job = ctx;
+    job->chunks[chunk].first_newline = linescan_count(job->index->data + begin, end - begin);
+}
+
+static void fill_chunk(void* ctx, size_t chunk, size_t begin, size_t end) {
+    BuildJob* job = ctx;
+    LineIndex* index = job->index;
+    ChunkState* state = &job->chunks[chunk];
+    size_t mask = index->stride - 1;
+    size_t newline = state->first_newline;
+    size_t base_block = SIZE_MAX; // Block whose base this chunk has written
+    size_t batch[BUILD_BATCH];
+
+    state->fixup_count = 0;
+
+    while (begin < end) {
+        size_t scanned;
+        size_t found = linescan_find(index->data + begin, end - begin, begin,
+                                     batch, BUILD_BATCH, &scanned);
+
+        for (size_t i = 0; i < found; i++, newline++) {
+            size_t line = newline + 1; // Line started by this newline
+            if (line & mask) continue;
+
+            size_t sample = line >> index->stride_shift;
+            size_t block = sample / LINE_INDEX_BLOCK;
+            uint64_t offset = batch[i] + 1;
+
+            if (sample % LINE_INDEX_BLOCK == 0) {
+                index->block_base[block] = offset;
+                index->sample_rel[sample] = 0;
+                base_block = block;
+            } else if (block == base_block) {
+                uint64_t rel = offset - index->block_base[block];
+                index->sample_rel[sample] = rel < LINE_INDEX_FAR ? (uint32_t)rel : LINE_INDEX_FAR;
+            } else {
+                // Block started in an earlier chunk; resolve once all chunks are done
+                if (state->fixup_count == 0) state->fixup_first = sample;
+                state->fixup[state->fixup_count++] = offset;
+            }
+        }
+
+        begin += scanned;
+    }
+}
+
+LineIndex* line_index_create(const char* data, size_t size, size_t stride) {
+    if (!data) return NULL;
+
+    LineIndex* index = malloc(sizeof(LineIndex));
+    if (!index) return NULL;
+
+    index->data = data;
+    index->size = size;
+    index->stride = 1;
+    index->stride_shift = 0;
+    while (index->stride < stride) {
+        index->stride <<= 1;
+        index->stride_shift++;
+    }
+    index->block_base = NULL;
+    index->sample_rel = NULL;
+
+    size_t chunk_count = linescan_chunk_count(size);
+    ChunkState* chunks = malloc(sizeof(ChunkState) * chunk_count);
+    if (!chunks) {
+        free(index);
+        return NULL;
+    }
+
+    BuildJob job = { index, chunks };
+
+    // First pass: count newlines per chunk to size the sample arrays exactly
+    linescan_parallel(size, chunk_count, count_chunk, &job);
+
+    size_t newlines = 0;
+    for (size_t c = 0; c < chunk_count; c++) {
+        size_t count = chunks[c].first_newline;
+        chunks[c].first_newline = newlines;
+        newlines += count;
+    }
+
+    index->line_count = newlines + 1;
+    index->sample_count = ((index->line_count - 1) >> index->stride_shift) + 1;
+    size_t block_count = (index->sample_count + LINE_INDEX_BLOCK - 1) / LINE_INDEX_BLOCK;
+
+    index->block_base = malloc(sizeof(uint64_t) * block_count);
+    index->sample_rel = malloc(sizeof(uint32_t) * index->sample_count);
+    if (!index->block_base || !index->sample_rel) {
+        free(chunks);
+        line_index_free(index);
+        return NULL;
+    }
+
+    // Line 0 always starts at the beginning
+    index->block_base[0] = 0;
+    index->sample_rel[0] = 0;
+
+    // Second pass: each chunk records the samples that start inside it
+    linescan_parallel(size, chunk_count, fill_chunk, &job);
+
+    for (size_t c = 0; c < chunk_count; c++) {
+        for (size_t i = 0; i < chunks[c].fixup_count; i++) {
+            size_t sample = chunks[c].fixup_first + i;
+            uint64_t rel = chunks[c].fixup[i] - index->block_base[sample / LINE_INDEX_BLOCK];
+            index->sample_rel[sample] = rel < LINE_INDEX_FAR ? (uint32_t)rel : LINE_INDEX_FAR;
+        }
+    }
+
+    free(chunks);
+    return index;
+}
+
+void line_index_free(LineIndex* index) {
+    if (!index) return;
+    free(index->block_base);
+    free(index->sample_rel);
+    free(index);
+}
+
+size_t line_index_count(const LineIndex* index) {
+    return index ? index->line_count : 0;
+}
+
+// Skip forward n lines from a known line start
+static size_t skip_lines(const LineIndex* index, size_t offset, size_t n) {
+    const char* p = linescan_skip(index->data + offset, index->size - offset, n);
+    return p ? (size_t)(p - index->data) : index->size;
+}
+
+// Offset of a stored sample, scanning from an earlier sample if it was too far
+static size_t sample_offset(const LineIndex* index, size_t sample) {
+    size_t block = sample / LINE_INDEX_BLOCK;
+    uint32_t rel = index->sample_rel[sample];
+    if (rel != LINE_INDEX_FAR) return index->block_base[block] + rel;
+
+    // The block's first sample is always representable (relative offset 0)
+    size_t near = sample;
+    while (index->sample_rel[near] == LINE_INDEX_FAR) near--;
+
+    size_t offset = index->block_base[block] + index->sample_rel[near];
+    return skip_lines(index, offset, (sample - near) << index->stride_shift);
+}
+
+size_t line_index_start(const LineIndex* index, size_t line) {
+    if (!index || line >= index->line_count) return index ? index->size : 0;
+
+    size_t offset = sample_offset(index, line >> index->stride_shift);
+    size_t within = line & (index->stride - 1);
+    return within ? skip_lines(index, offset, within) : offset;
+}
+
+size_t line_index_end(const LineIndex* index, size_t line) {
+    if (!index || line >= index->line_count) return index ? index->size : 0;
+    if (line + 1 == index->line_count) return index->size;
+
+    // Next line's start is stored directly; use it rather than scanning this line
+    if (((line + 1) & (index->stride - 1)) == 0) {
+        return sample_offset(index, (line + 1) >> index->stride_shift) - 1;
+    }
+
+    size_t start = line_index_start(index, line);
+    const char* nl = memchr(index->data + start, '\n', index->size - start);
+    return nl ? (size_t)(nl - index->data) : index->size;
+}
+
+size_t line_index_line_at(const LineIndex* index, size_t offset) {
+    if (!index) return 0;
+    if (offset > index->size) offset = index->size;
+
+    // Find the last sample starting at or before offset
+    size_t lo = 0;
+    size_t hi = index->sample_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sample_offset(index, mid) <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    size_t start = sample_offset(index, lo);
+    return (lo << index->stride_shift) +
+           linescan_count(index->data + start, offset - start);
+}
+
+size_t line_index_memory(const LineIndex* index) {
+    if (!index) return 0;
+    size_t block_count = (index->sample_count + LINE_INDEX_BLOCK - 1) / LINE_INDEX_BLOCK;
+    return sizeof(LineIndex) +
+           block_count * sizeof(uint64_t) +
+           index->sample_count * sizeof(uint32_t);
+}
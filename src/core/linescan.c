@@ -0,0 +1,389 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "linescan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINESCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Chunks of a parallel scan are never smaller than this
+#define LINESCAN_CHUNK_MIN (4 * 1024 * 1024)
+
+// Set of kernels implementing the public scanning operations
+typedef struct {
+    const char* name;
+    size_t (*count)(const char* data, size_t len);
+    size_t (*find)(const char* data, size_t len, size_t base,
+                   size_t* out, size_t max, size_t* scanned);
+    const char* (*skip)(const char* data, size_t len, size_t n);
+} LineScanKernel;
+
+static const LineScanKernel* kernel = NULL;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+// Scalar kernels (memchr is vectorized by most C libraries)
+
+static size_t count_scalar(const char* data, size_t len) {
+    const char* p = data;
+    const char* end = data + len;
+    size_t count = 0;
+
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        count++;
+        p++;
+    }
+    return count;
+}
+
+static size_t find_scalar(const char* data, size_t len, size_t base,
+                          size_t* out, size_t max, size_t* scanned) {
+    const char* p = data;
+    const char* end = data + len;
+    size_t n = 0;
+
+    while (n < max) {
+        const char* nl = memchr(p, '\n', end - p);
+        if (!nl) {
+            p = end;
+            break;
+        }
+        out[n++] = base + (size_t)(nl - data);
+        p = nl + 1;
+    }
+
+    if (scanned) *scanned = p - data;
+    return n;
+}
+
+static const char* skip_scalar(const char* data, size_t len, size_t n) {
+    const char* p = data;
+    const char* end = data + len;
+
+    while (n > 0) {
+        const char* nl = memchr(p, '\n', end - p);
+        if (!nl) return NULL;
+        p = nl + 1;
+        n--;
+    }
+    return p;
+}
+
+static const LineScanKernel scalar_kernel = {
+    "scalar", count_scalar, find_scalar, skip_scalar
+};
+
+#ifdef LINESCAN_X86
+
+// SSE2 kernels: 16 bytes per step
+
+__attribute__((target("sse2")))
+static size_t count_sse2(const char* data, size_t len) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+    size_t i = 0;
+
+    while (i + 16 <= len) {
+        // Byte counters overflow after 255 steps, so fold them periodically
+        size_t steps = (len - i) / 16;
+        if (steps > 255) steps = 255;
+
+        __m128i acc = zero;
+        for (size_t s = 0; s < steps; s++, i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, nl));
+        }
+        total = _mm_add_epi64(total, _mm_sad_epu8(acc, zero));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, total);
+    return (size_t)(lanes[0] + lanes[1]) + count_scalar(data + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static size_t find_sse2(const char* data, size_t len, size_t base,
+                        size_t* out, size_t max, size_t* scanned) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i + 16 <= len && max - n >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        while (mask) {
+            out[n++] = base + i + (size_t)__builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+
+    size_t tail_scanned;
+    n += find_scalar(data + i, len - i, base + i, out + n, max - n, &tail_scanned);
+    if (scanned) *scanned = i + tail_scanned;
+    return n;
+}
+
+__attribute__((target("sse2")))
+static const char* skip_sse2(const char* data, size_t len, size_t n) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t i = 0;
+
+    if (n == 0) return data;
+
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        size_t hits = (size_t)__builtin_popcount(mask);
+        if (hits >= n) {
+            while (--n) mask &= mask - 1;
+            return data + i + __builtin_ctz(mask) + 1;
+        }
+        n -= hits;
+        i += 16;
+    }
+    return skip_scalar(data + i, len - i, n);
+}
+
+static const LineScanKernel sse2_kernel = {
+    "sse2", count_sse2, find_sse2, skip_sse2
+};
+
+// AVX2 kernels: 32 bytes per step
+
+__attribute__((target("avx2")))
+static size_t count_avx2(const char* data, size_t len) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    size_t i = 0;
+
+    while (i + 32 <= len) {
+        size_t steps = (len - i) / 32;
+        if (steps > 255) steps = 255;
+
+        __m256i acc = zero;
+        for (size_t s = 0; s < steps; s++, i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, nl));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, zero));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, total);
+    return (size_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) +
+           count_sse2(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t find_avx2(const char* data, size_t len, size_t base,
+                        size_t* out, size_t max, size_t* scanned) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i + 32 <= len && max - n >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+        while (mask) {
+            out[n++] = base + i + (size_t)__builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+        i += 32;
+    }
+
+    size_t tail_scanned;
+    n += find_sse2(data + i, len - i, base + i, out + n, max - n, &tail_scanned);
+    if (scanned) *scanned = i + tail_scanned;
+    return n;
+}
+
+__attribute__((target("avx2,popcnt")))
+static const char* skip_avx2(const char* data, size_t len, size_t n) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t i = 0;
+
+    if (n == 0) return data;
+
+    while (i + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+        size_t hits = (size_t)__builtin_popcount(mask);
+        if (hits >= n) {
+            while (--n) mask &= mask - 1;
+            return data + i + __builtin_ctz(mask) + 1;
+        }
+        n -= hits;
+        i += 32;
+    }
+    return skip_sse2(data + i, len - i, n);
+}
+
+static const LineScanKernel avx2_kernel = {
+    "avx2", count_avx2, find_avx2, skip_avx2
+};
+
+#endif // LINESCAN_X86
+
+// Pick the widest kernel the running CPU supports
+static void select_kernel(void) {
+    kernel = &scalar_kernel;
+#ifdef LINESCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        kernel = &avx2_kernel;
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernel = &sse2_kernel;
+    }
+#endif
+}
+
+static const LineScanKernel* get_kernel(void) {
+    pthread_once(&kernel_once, select_kernel);
+    return kernel;
+}
+
+const char* linescan_kernel_name(void) {
+    return get_kernel()->name;
+}
+
+size_t linescan_count(const char* data, size_t len) {
+    if (!data || len == 0) return 0;
+    return get_kernel()->count(data, len);
+}
+
+size_t linescan_find(const char* data, size_t len, size_t base,
+                     size_t* out, size_t max, size_t* scanned) {
+    if (!data || !out || len == 0 || max == 0) {
+        if (scanned) *scanned = 0;
+        return 0;
+    }
+    return get_kernel()->find(data, len, base, out, max, scanned);
+}
+
+const char* linescan_skip(const char* data, size_t len, size_t n) {
+    if (!data) return NULL;
+    if (n == 0) return data;
+    return get_kernel()->skip(data, len, n);
+}
+
+// Parallel chunk scanning
+
+typedef struct {
+    LineScanChunkFn fn;
+    void* ctx;
+    size_t chunk;
+    size_t begin;
+    size_t end;
+} ChunkJob;
+
+static void* chunk_thread(void* arg) {
+    ChunkJob* job = arg;
+    job->fn(job->ctx, job->chunk, job->begin, job->end);
+    return NULL;
+}
+
+size_t linescan_chunk_count(size_t len) {
+    if (len < LINESCAN_PARALLEL_MIN) return 1;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t chunks = cpus > 0 ? (size_t)cpus : 1;
+    if (chunks > LINESCAN_MAX_THREADS) chunks = LINESCAN_MAX_THREADS;
+    if (chunks > len / LINESCAN_CHUNK_MIN) chunks = len / LINESCAN_CHUNK_MIN;
+
+    return chunks > 0 ? chunks : 1;
+}
+
+void linescan_parallel(size_t len, size_t chunks, LineScanChunkFn fn, void* ctx) {
+    if (!fn) return;
+    if (chunks > LINESCAN_MAX_THREADS) chunks = LINESCAN_MAX_THREADS;
+    if (chunks <= 1) {
+        fn(ctx, 0, 0, len);
+        return;
+    }
+
+    ChunkJob jobs[LINESCAN_MAX_THREADS];
+    pthread_t threads[LINESCAN_MAX_THREADS];
+    int started[LINESCAN_MAX_THREADS];
+    size_t chunk_size = len / chunks;
+
+    for (size_t c = 0; c < chunks; c++) {
+        jobs[c].fn = fn;
+        jobs[c].ctx = ctx;
+        jobs[c].chunk = c;
+        jobs[c].begin = c * chunk_size;
+        jobs[c].end = (c + 1 == chunks) ? len : (c + 1) * chunk_size;
+        started[c] = 0;
+    }
+
+    // Chunk 0 runs on the calling thread; fall back to inline if a thread can't start
+    for (size_t c = 1; c < chunks; c++) {
+        started[c] = pthread_create(&threads[c], NULL, chunk_thread, &jobs[c]) == 0;
+    }
+
+    chunk_thread(&jobs[0]);
+
+    for (size_t c = 1; c < chunks; c++) {
+        if (started[c]) {
+            pthread_join(threads[c], NULL);
+        } else {
+            chunk_thread(&jobs[c]);
+        }
+    }
+}
+
+// Line start array building
+
+typedef struct {
+    const char* data;
+    size_t counts[LINESCAN_MAX_THREADS];  // Newlines per chunk, then first slot per chunk
+    size_t* out;
+} LineStartsJob;
+
+static void count_chunk(void* ctx, size_t chunk, size_t begin, size_t end) {
+    LineStartsJob* job = ctx;
+    job->counts[chunk] = linescan_count(job->data + begin, end - begin);
+}
+
+static void fill_chunk(void* ctx, size_t chunk, size_t begin, size_t end) {
+    LineStartsJob* job = ctx;
+    // A line starts one byte past each newline
+    linescan_find(job->data + begin, end - begin, begin + 1,
+                  job->out + job->counts[chunk], SIZE_MAX, NULL);
+}
+
+size_t* linescan_line_starts(const char* data, size_t len, size_t* line_count) {
+    if (!data) return NULL;
+
+    LineStartsJob job;
+    job.data = data;
+    job.out = NULL;
+
+    size_t chunks = linescan_chunk_count(len);
+    if (chunks > LINESCAN_MAX_THREADS) chunks = LINESCAN_MAX_THREADS;
+
+    // First pass: count newlines per chunk so the array is allocated exactly once
+    linescan_parallel(len, chunks, count_chunk, &job);
+
+    size_t total = 1; // Slot 0 holds the first line
+    for (size_t c = 0; c < chunks; c++) {
+        size_t count = job.counts[c];
+        job.counts[c] = total;
+        total += count;
+    }
+
+    job.out = malloc(sizeof(size_t) * total);
+    if (!job.out) return NULL;
+    job.out[0] = 0;
+
+    // Second pass: each chunk writes its own slice of the array
+    linescan_parallel(len, chunks, fill_chunk, &job);
+
+    if (line_count) *line_count = total;
+    return job.out;
+}
@@ -0,0 +1,103 @@
+#include "coalesce.h"
+
+/**
+ * Check whether repeats of a key can be merged into one move
+ * (moves by a fixed step that don't depend on anything but the cursor)
+ */
+static int is_motion_key(int key) {
+    switch (key) {
+        case KEY_ARROW_UP:
+        case KEY_ARROW_DOWN:
+        case KEY_ARROW_LEFT:
+        case KEY_ARROW_RIGHT:
+        case KEY_PAGE_UP:
+        case KEY_PAGE_DOWN:
+        case KEY_WORD_LEFT:
+        case KEY_WORD_RIGHT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Check whether a mouse event is a wheel notch
+ */
+static int is_wheel(const MouseEvent* mouse) {
+    return mouse->type == MOUSE_WHEEL_UP || mouse->type == MOUSE_WHEEL_DOWN;
+}
+
+/**
+ * Try to fold an event into the pending one
+ * @return 1 if merged, 0 if the two must stay separate
+ */
+static int merge(Coalescer* coalescer, const InputEvent* event) {
+    InputEvent* pending = &coalescer->pending;
+    if (pending->type != event->type) return 0;
+
+    switch (event->type) {
+        case EVENT_KEY:
+            if (pending->key != event->key || !is_motion_key(event->key)) return 0;
+            if (pending->count + event->count > COALESCE_MAX_COUNT) return 0;
+            pending->count += event->count;
+            return 1;
+
+        case EVENT_MOUSE:
+            if (is_wheel(&pending->mouse) && is_wheel(&event->mouse)) {
+                // Sum the notches, treating up as negative
+                long total = (pending->mouse.type == MOUSE_WHEEL_DOWN ? 1 : -1) * (long)pending->count +
+                             (event->mouse.type == MOUSE_WHEEL_DOWN ? 1 : -1) * (long)event->count;
+                if (total > COALESCE_MAX_COUNT || total < -COALESCE_MAX_COUNT) return 0;
+                if (total == 0) {
+                    // Scrolled back where it started: nothing to do
+                    coalescer->has_pending = 0;
+                    return 1;
+                }
+                pending->mouse = event->mouse;
+                pending->mouse.type = total > 0 ? MOUSE_WHEEL_DOWN : MOUSE_WHEEL_UP;
+                pending->count = (size_t)(total > 0 ? total : -total);
+                return 1;
+            }
+            if (pending->mouse.type == MOUSE_DRAG && event->mouse.type == MOUSE_DRAG &&
+                pending->mouse.button == event->mouse.button) {
+                // Only where the drag got to matters
+                long long first = pending->time_us;
+                long long first_read = pending->read_us;
+                *pending = *event;
+                pending->time_us = first;
+                pending->read_us = first_read;
+                return 1;
+            }
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+void coalesce_init(Coalescer* coalescer) {
+    if (!coalescer) return;
+    coalescer->has_pending = 0;
+}
+
+int coalesce_push(Coalescer* coalescer, const InputEvent* event, InputEvent* ready) {
+    if (!coalescer || !event || !ready) return 0;
+
+    InputEvent next = *event;
+    if (next.count == 0) next.count = 1;
+
+    if (coalescer->has_pending && merge(coalescer, &next)) return 0;
+
+    int has_ready = coalescer->has_pending;
+    if (has_ready) *ready = coalescer->pending;
+    coalescer->pending = next;
+    coalescer->has_pending = 1;
+    return has_ready;
+}
+
+int coalesce_flush(Coalescer* coalescer, InputEvent* ready) {
+    if (!coalescer || !ready || !coalescer->has_pending) return 0;
+    *ready = coalescer->pending;
+    coalescer->has_pending = 0;
+    return 1;
+}
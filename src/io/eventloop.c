@@ -0,0 +1,123 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include "eventloop.h"
+
+// Self-pipe: wakeups write a byte to one end, waits poll the other
+static int wake_pipe[2] = { -1, -1 };
+
+// Poll events watched on the terminal input (0 still reports hangups)
+static short input_events = POLLIN;
+
+// Handler that was installed for SIGWINCH before ours
+static struct sigaction old_winch;
+static int winch_installed = 0;
+
+// SIGWINCH count, bumped by the handler; a burst of signals reads as one change
+static volatile sig_atomic_t winch_count = 0;
+static sig_atomic_t winch_seen = 0;
+
+/**
+ * Make a descriptor non-blocking and close-on-exec
+ * @return 1 on success, 0 on error
+ */
+static int set_flags(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) return 0;
+    flags = fcntl(fd, F_GETFD);
+    if (flags == -1 || fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1) return 0;
+    return 1;
+}
+
+/**
+ * Signal handler: note the resize and wake the loop
+ */
+static void handle_winch(int signo) {
+    (void)signo;
+    winch_count++;
+    eventloop_wake();
+}
+
+int eventloop_init(void) {
+    if (wake_pipe[0] != -1) return 1;
+
+    if (pipe(wake_pipe) == -1) {
+        wake_pipe[0] = wake_pipe[1] = -1;
+        return 0;
+    }
+    if (!set_flags(wake_pipe[0]) || !set_flags(wake_pipe[1])) {
+        eventloop_cleanup();
+        return 0;
+    }
+
+    // Resizes interrupt the wait instead of waiting for the next keypress
+    struct sigaction action;
+    action.sa_handler = handle_winch;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGWINCH, &action, &old_winch) == 0) {
+        winch_installed = 1;
+    }
+    return 1;
+}
+
+void eventloop_cleanup(void) {
+    if (winch_installed) {
+        sigaction(SIGWINCH, &old_winch, NULL);
+        winch_installed = 0;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (wake_pipe[i] != -1) close(wake_pipe[i]);
+        wake_pipe[i] = -1;
+    }
+}
+
+void eventloop_watch_input(int watch) {
+    input_events = watch ? POLLIN : 0;
+}
+
+int eventloop_wait(int timeout_ms) {
+    // A negative descriptor is skipped by poll, so this works without the pipe
+    struct pollfd fds[2] = {
+        { STDIN_FILENO, input_events, 0 },
+        { wake_pipe[0], POLLIN, 0 }
+    };
+
+    int result = 0;
+    if (poll(fds, 2, timeout_ms) < 0) {
+        // Interrupted by a signal: report it like a wakeup
+        fds[0].revents = fds[1].revents = 0;
+        if (errno == EINTR) result |= EVENTLOOP_WAKE;
+    }
+
+    if (fds[0].revents & POLLIN) result |= EVENTLOOP_INPUT;
+    if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) result |= EVENTLOOP_HANGUP;
+
+    if (fds[1].revents & POLLIN) {
+        // Any number of wakeups since the last wait count as one
+        char drain[64];
+        while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+        result |= EVENTLOOP_WAKE;
+    }
+
+    // Compared rather than cleared, so a signal landing now isn't lost
+    sig_atomic_t count = winch_count;
+    if (count != winch_seen) {
+        winch_seen = count;
+        result |= EVENTLOOP_RESIZE;
+    }
+    return result;
+}
+
+void eventloop_wake(void) {
+    if (wake_pipe[1] == -1) return;
+
+    // A full pipe already holds a pending wakeup
+    int saved_errno = errno;
+    char byte = 0;
+    ssize_t written = write(wake_pipe[1], &byte, 1);
+    (void)written;
+    errno = saved_errno;
+}
@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include "eventqueue.h"
+
+EventQueue* event_queue_create(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size *= 2;
+
+    EventQueue* queue = malloc(sizeof(EventQueue));
+    if (!queue) return NULL;
+
+    queue->events = malloc(sizeof(InputEvent) * size);
+    if (!queue->events) {
+        free(queue);
+        return NULL;
+    }
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return queue;
+}
+
+void event_queue_free(EventQueue* queue) {
+    if (!queue) return;
+
+    InputEvent event;
+    while (event_queue_pop(queue, &event)) {
+        if (event.type == EVENT_PASTE) free(event.paste.text);
+    }
+    free(queue->events);
+    free(queue);
+}
+
+int event_queue_push(EventQueue* queue, const InputEvent* event) {
+    if (!queue || !event) return 0;
+
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head > queue->mask) return 0;
+
+    // Fill the slot before publishing it
+    queue->events[tail & queue->mask] = *event;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+int event_queue_pop(EventQueue* queue, InputEvent* event) {
+    if (!queue || !event) return 0;
+
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) return 0;
+
+    // Copy the slot out before handing it back to the producer
+    *event = queue->events[head & queue->mask];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 1;
+}
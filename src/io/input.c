@@ -0,0 +1,416 @@
+#include <stdlib.h>
+#include <string.h>
+#include "input.h"
+
+#define RING_MASK (INPUT_RING_SIZE - 1)
+
+// Decoder states
+#define STATE_GROUND 0     // Between events
+#define STATE_ESCAPE 1     // After ESC
+#define STATE_CSI    2     // After ESC [
+#define STATE_SS3    3     // After ESC O
+#define STATE_PASTE  4     // Between the bracketed paste markers
+
+// Smallest allocation for pasted text
+#define PASTE_INITIAL_CAPACITY 4096
+
+// What ends a bracketed paste
+static const char paste_end[] = TERM_PASTE_END;
+#define PASTE_END_LENGTH (sizeof(paste_end) - 1)
+
+// SGR mouse button code bits
+#define MOUSE_BUTTON_BITS   0x03  // Button number, or wheel direction
+#define MOUSE_MODIFIER_BITS 0x1c  // Shift, Alt, Ctrl
+#define MOUSE_MOTION_BIT    0x20  // Moved with the button held
+#define MOUSE_WHEEL_BIT     0x40  // Wheel rather than button
+#define MOUSE_EXTRA_BIT     0x80  // Buttons 8-11
+
+// Keys selected by the final byte of a CSI or SS3 sequence
+static const int final_keys[128] = {
+    ['A'] = KEY_ARROW_UP,
+    ['B'] = KEY_ARROW_DOWN,
+    ['C'] = KEY_ARROW_RIGHT,
+    ['D'] = KEY_ARROW_LEFT,
+    ['H'] = KEY_HOME,
+    ['F'] = KEY_END,
+};
+
+// Keys selected by the number in CSI n ~
+static const int tilde_keys[] = {
+    [1] = KEY_HOME,
+    [2] = KEY_INSERT,
+    [3] = KEY_DELETE,
+    [4] = KEY_END,
+    [5] = KEY_PAGE_UP,
+    [6] = KEY_PAGE_DOWN,
+    [7] = KEY_HOME,
+    [8] = KEY_END,
+};
+#define TILDE_KEY_COUNT (sizeof(tilde_keys) / sizeof(tilde_keys[0]))
+
+// Dedicated codes for the arrows, Home and End pressed with Ctrl alone,
+// indexed from KEY_ARROW_UP
+static const int ctrl_keys[] = {
+    KEY_CTRL_UP,      // KEY_ARROW_UP
+    KEY_CTRL_DOWN,    // KEY_ARROW_DOWN
+    KEY_WORD_LEFT,    // KEY_ARROW_LEFT
+    KEY_WORD_RIGHT,   // KEY_ARROW_RIGHT
+    KEY_CTRL_HOME,    // KEY_HOME
+    KEY_CTRL_END,     // KEY_END
+};
+
+/**
+ * Get a numeric parameter of the current sequence
+ * @return The parameter, or fallback if it was omitted
+ */
+static int param(const InputDecoder* decoder, size_t i, int fallback) {
+    if (i >= decoder->param_count || i >= INPUT_MAX_PARAMS) return fallback;
+    return decoder->params[i] > 0 ? decoder->params[i] : fallback;
+}
+
+/**
+ * Apply an xterm modifier parameter (1 + Shift 1 | Alt 2 | Ctrl 4 | Meta 8) to a key
+ */
+static int with_modifiers(int key, int modifiers) {
+    int bits = modifiers - 1;
+    if (bits <= 0) return key;
+
+    int flags = 0;
+    if (bits & 1) flags |= KEY_MOD_SHIFT;
+    if (bits & (2 | 8)) flags |= KEY_MOD_ALT;
+    if (bits & 4) flags |= KEY_MOD_CTRL;
+
+    if ((flags & KEY_MOD_CTRL) && key >= KEY_ARROW_UP && key <= KEY_END) {
+        key = ctrl_keys[key - KEY_ARROW_UP];
+        flags &= ~KEY_MOD_CTRL;
+    }
+    return key | flags;
+}
+
+/**
+ * Start collecting a new sequence
+ */
+static void begin_sequence(InputDecoder* decoder, int state) {
+    decoder->state = state;
+    decoder->marker = 0;
+    decoder->param_count = 0;
+    decoder->malformed = 0;
+}
+
+/**
+ * Add a parameter byte (digit or separator) to the current sequence
+ */
+static void add_param_byte(InputDecoder* decoder, unsigned char byte) {
+    if (decoder->param_count == 0) {
+        decoder->params[0] = 0;
+        decoder->param_count = 1;
+    }
+
+    if (byte == ';') {
+        if (decoder->param_count < INPUT_MAX_PARAMS) decoder->params[decoder->param_count] = 0;
+        decoder->param_count++;
+        return;
+    }
+
+    size_t i = decoder->param_count - 1;
+    if (i < INPUT_MAX_PARAMS) {
+        int value = decoder->params[i] * 10 + (byte - '0');
+        decoder->params[i] = value < INPUT_PARAM_MAX ? value : INPUT_PARAM_MAX;
+    }
+}
+
+/**
+ * Turn a complete CSI sequence into an event
+ * @return 1 if it produced an event, 0 if it was dropped
+ */
+static int decode_csi(InputDecoder* decoder, unsigned char final, InputEvent* event) {
+    if (decoder->malformed) return 0;
+
+    if (decoder->marker == '<') {
+        // SGR mouse: CSI < button ; x ; y M/m
+        if ((final != 'M' && final != 'm') || decoder->param_count != 3) return 0;
+        event->type = EVENT_MOUSE;
+        event->mouse = input_mouse_event(decoder->params[0], decoder->params[1],
+                                         decoder->params[2], (char)final);
+        return event->mouse.type != MOUSE_NONE;
+    }
+    if (decoder->marker) return 0;
+
+    if (final == '~') {
+        size_t number = (size_t)param(decoder, 0, 0);
+        if (number == INPUT_PASTE_BEGIN) {
+            // Collect the text; the event comes with the end marker
+            decoder->state = STATE_PASTE;
+            decoder->paste_length = 0;
+            decoder->paste_match = 0;
+            return 0;
+        }
+        if (number >= TILDE_KEY_COUNT || !tilde_keys[number]) return 0;
+        event->type = EVENT_KEY;
+        event->key = with_modifiers(tilde_keys[number], param(decoder, 1, 1));
+        return 1;
+    }
+
+    if ((final == 'I' || final == 'O') && decoder->param_count == 0) {
+        event->type = EVENT_FOCUS;
+        event->focused = final == 'I';
+        return 1;
+    }
+
+    // CSI A or, with modifiers, CSI 1 ; m A
+    if (final < 128 && final_keys[final]) {
+        event->type = EVENT_KEY;
+        event->key = with_modifiers(final_keys[final], param(decoder, 1, 1));
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Add bytes to the paste being collected
+ * @return 1 on success, 0 if out of memory (the bytes are dropped)
+ */
+static int paste_append(InputDecoder* decoder, const char* data, size_t len) {
+    // One byte more than the text for the terminator
+    if (decoder->paste_length + len + 1 > decoder->paste_capacity) {
+        size_t capacity = decoder->paste_capacity ? decoder->paste_capacity : PASTE_INITIAL_CAPACITY;
+        while (decoder->paste_length + len + 1 > capacity) capacity *= 2;
+        char* grown = realloc(decoder->paste, capacity);
+        if (!grown) return 0;
+        decoder->paste = grown;
+        decoder->paste_capacity = capacity;
+    }
+    memcpy(decoder->paste + decoder->paste_length, data, len);
+    decoder->paste_length += len;
+    return 1;
+}
+
+/**
+ * Collect paste text from the ring until the end marker
+ * @return 1 if the paste ended and event holds it, 0 if more bytes are needed
+ */
+static int decode_paste(InputDecoder* decoder, InputEvent* event) {
+    while (decoder->head != decoder->tail) {
+        if (decoder->paste_match == 0) {
+            // Copy up to the next ESC, which may start the end marker, in one go
+            size_t offset = decoder->head & RING_MASK;
+            size_t available = decoder->tail - decoder->head;
+            if (available > INPUT_RING_SIZE - offset) available = INPUT_RING_SIZE - offset;
+
+            const unsigned char* run = decoder->ring + offset;
+            const unsigned char* esc = memchr(run, paste_end[0], available);
+            size_t count = esc ? (size_t)(esc - run) : available;
+            paste_append(decoder, (const char*)run, count);
+            decoder->head += count;
+            if (!esc) continue;
+        }
+
+        // Match the end marker a byte at a time
+        unsigned char byte = decoder->ring[decoder->head & RING_MASK];
+        decoder->head++;
+        if (byte == (unsigned char)paste_end[decoder->paste_match]) {
+            if (++decoder->paste_match < PASTE_END_LENGTH) continue;
+
+            // Hand the text over to the event
+            decoder->state = STATE_GROUND;
+            decoder->paste_match = 0;
+            if (!decoder->paste && !paste_append(decoder, "", 0)) return 0;
+            decoder->paste[decoder->paste_length] = '\0';
+            event->type = EVENT_PASTE;
+            event->paste.text = decoder->paste;
+            event->paste.length = decoder->paste_length;
+            decoder->paste = NULL;
+            decoder->paste_length = 0;
+            decoder->paste_capacity = 0;
+            return 1;
+        }
+
+        // Not the end after all: what matched so far was pasted text
+        paste_append(decoder, paste_end, decoder->paste_match);
+        decoder->paste_match = 0;
+        if (byte == (unsigned char)paste_end[0]) {
+            decoder->paste_match = 1;
+        } else {
+            paste_append(decoder, (const char*)&byte, 1);
+        }
+    }
+    return 0;
+}
+
+MouseEvent input_mouse_event(int button, int x, int y, char final) {
+    MouseEvent event = {MOUSE_NONE, 0, 0, 0};
+
+    // Adjust coordinates (1-based to 0-based)
+    event.x = x > 0 ? (size_t)(x - 1) : 0;
+    event.y = y > 0 ? (size_t)(y - 1) : 0;
+
+    int code = button & ~MOUSE_MODIFIER_BITS;
+    if (code & MOUSE_EXTRA_BIT) return event;
+
+    if (code & MOUSE_WHEEL_BIT) {
+        // 64 and 65 scroll vertically; 66 and 67 scroll sideways, which isn't used
+        if ((code & MOUSE_BUTTON_BITS) == 0) event.type = MOUSE_WHEEL_UP;
+        else if ((code & MOUSE_BUTTON_BITS) == 1) event.type = MOUSE_WHEEL_DOWN;
+        return event;
+    }
+
+    event.button = code & MOUSE_BUTTON_BITS;
+    if (final == 'm') {
+        event.type = MOUSE_RELEASE;
+    } else if (final == 'M') {
+        event.type = (code & MOUSE_MOTION_BIT) ? MOUSE_DRAG : MOUSE_PRESS;
+    }
+    return event;
+}
+
+void input_decoder_init(InputDecoder* decoder) {
+    if (!decoder) return;
+    decoder->head = 0;
+    decoder->tail = 0;
+    decoder->paste = NULL;
+    decoder->paste_length = 0;
+    decoder->paste_capacity = 0;
+    decoder->paste_match = 0;
+    begin_sequence(decoder, STATE_GROUND);
+}
+
+void input_decoder_cleanup(InputDecoder* decoder) {
+    if (!decoder) return;
+    free(decoder->paste);
+    decoder->paste = NULL;
+    decoder->paste_length = 0;
+    decoder->paste_capacity = 0;
+}
+
+size_t input_decoder_space(InputDecoder* decoder, unsigned char** region) {
+    if (!decoder || !region) return 0;
+
+    // Free space runs from tail to the end of the ring or up to head
+    size_t offset = decoder->tail & RING_MASK;
+    size_t available = INPUT_RING_SIZE - (decoder->tail - decoder->head);
+    size_t contiguous = INPUT_RING_SIZE - offset;
+    *region = decoder->ring + offset;
+    return available < contiguous ? available : contiguous;
+}
+
+void input_decoder_commit(InputDecoder* decoder, size_t count) {
+    if (!decoder) return;
+    decoder->tail += count;
+}
+
+size_t input_decoder_feed(InputDecoder* decoder, const char* data, size_t len) {
+    if (!decoder || !data) return 0;
+
+    size_t copied = 0;
+    while (copied < len) {
+        unsigned char* region;
+        size_t space = input_decoder_space(decoder, &region);
+        if (space == 0) break;
+        if (space > len - copied) space = len - copied;
+        memcpy(region, data + copied, space);
+        input_decoder_commit(decoder, space);
+        copied += space;
+    }
+    return copied;
+}
+
+int input_decoder_next(InputDecoder* decoder, InputEvent* event) {
+    if (!decoder || !event) return 0;
+    event->count = 1;
+
+    while (decoder->head != decoder->tail) {
+        unsigned char byte = decoder->ring[decoder->head & RING_MASK];
+
+        switch (decoder->state) {
+            case STATE_GROUND:
+                decoder->head++;
+                if (byte == (unsigned char)ESC[0]) {
+                    decoder->state = STATE_ESCAPE;
+                    break;
+                }
+                event->type = EVENT_KEY;
+                event->key = byte;
+                return 1;
+
+            case STATE_ESCAPE:
+                if (byte == '[' || byte == 'O') {
+                    decoder->head++;
+                    begin_sequence(decoder, byte == '[' ? STATE_CSI : STATE_SS3);
+                    break;
+                }
+
+                decoder->state = STATE_GROUND;
+                event->type = EVENT_KEY;
+                if (byte >= 0x20 && byte <= 0x7f) {
+                    // ESC before a printable character (or DEL) is Alt held with it
+                    decoder->head++;
+                    event->key = byte | KEY_MOD_ALT;
+                } else {
+                    // Otherwise the ESC was the Escape key; the byte after it
+                    // is decoded on its own
+                    event->key = KEY_ESC;
+                }
+                return 1;
+
+            case STATE_CSI:
+                if (byte >= 0x40 && byte <= 0x7e) {
+                    // Final byte
+                    decoder->head++;
+                    decoder->state = STATE_GROUND;
+                    if (decode_csi(decoder, byte, event)) return 1;
+                } else if ((byte >= '0' && byte <= '9') || byte == ';') {
+                    decoder->head++;
+                    add_param_byte(decoder, byte);
+                } else if (byte >= 0x20 && byte <= 0x3f) {
+                    // A private marker may only lead; ':' sub-parameters and
+                    // intermediate bytes belong to nothing decoded here
+                    decoder->head++;
+                    if (byte >= '<' && decoder->param_count == 0 && !decoder->marker) {
+                        decoder->marker = (char)byte;
+                    } else {
+                        decoder->malformed = 1;
+                    }
+                } else {
+                    // Anything else cuts the sequence short; decode the byte afresh
+                    decoder->state = STATE_GROUND;
+                }
+                break;
+
+            case STATE_SS3:
+                decoder->head++;
+                decoder->state = STATE_GROUND;
+                if (byte < 128 && final_keys[byte]) {
+                    event->type = EVENT_KEY;
+                    event->key = final_keys[byte];
+                    return 1;
+                }
+                break;
+
+            case STATE_PASTE:
+                if (decode_paste(decoder, event)) return 1;
+                break;
+        }
+    }
+    return 0;
+}
+
+int input_decoder_waiting(const InputDecoder* decoder) {
+    return decoder && decoder->state == STATE_ESCAPE;
+}
+
+int input_decoder_flush(InputDecoder* decoder, InputEvent* event) {
+    if (!decoder || !event || decoder->state != STATE_ESCAPE) return 0;
+
+    decoder->state = STATE_GROUND;
+    event->type = EVENT_KEY;
+    event->count = 1;
+    event->key = KEY_ESC;
+    return 1;
+}
+
+int input_decoder_take_byte(InputDecoder* decoder, unsigned char* byte) {
+    if (!decoder || !byte || decoder->head == decoder->tail) return 0;
+    *byte = decoder->ring[decoder->head & RING_MASK];
+    decoder->head++;
+    return 1;
+}
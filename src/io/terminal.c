@@ -5,15 +5,183 @@
 #include <sys/ioctl.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/time.h>
-#include <sys/select.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include "terminal.h"
+#include "input.h"
+#include "eventqueue.h"
 
-#define MAX_SEQUENCE_LENGTH 32
+#define QUERY_REPLY_LENGTH 128
 
 // Store original terminal state to restore later
 static struct termios orig_termios;
 
+// Whether frames are wrapped in synchronized update markers
+static int sync_supported = 0;
+
+// Bytes read from the terminal and the decoder turning them into events
+static InputDecoder input;
+
+// When a lone ESC was first seen waiting for the rest of a sequence (0 if none)
+static long long escape_since = 0;
+
+// When the last chunk of input was read, the read time of events it completes
+static long long last_read_us = 0;
+
+// How long a producer facing a full queue waits before trying again
+#define INPUT_QUEUE_RETRY_MS 1
+
+// Input thread: while it runs, only it reads and decodes input, and
+// events reach the caller through the queue
+static pthread_t input_thread;
+static int input_threaded = 0;
+static EventQueue* input_queue = NULL;
+static TerminalNotify input_notify = NULL;
+static atomic_int input_stop;
+static int stop_pipe[2] = { -1, -1 };
+
+/**
+ * Current time in microseconds on a clock that never jumps
+ */
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Current time in milliseconds on a clock that never jumps
+ */
+static long long now_ms(void) {
+    return now_us() / 1000;
+}
+
+/**
+ * Read whatever input is waiting, up to the free space in the ring, in one call
+ * Raw mode sets VMIN and VTIME to 0, so the read never blocks.
+ * @return Number of bytes read
+ */
+static size_t fill_input(void) {
+    unsigned char* region;
+    size_t space = input_decoder_space(&input, &region);
+    if (space == 0) return 0;
+    
+    ssize_t nread;
+    do {
+        nread = read(STDIN_FILENO, region, space);
+    } while (nread < 0 && errno == EINTR);
+    if (nread <= 0) return 0;
+    
+    last_read_us = now_us();
+    input_decoder_commit(&input, (size_t)nread);
+    return (size_t)nread;
+}
+
+/**
+ * Block until input arrives or the timeout expires
+ * @param timeout_ms Longest wait in milliseconds, or -1 to wait indefinitely
+ */
+static void wait_for_input(int timeout_ms) {
+    if (input_threaded) {
+        // The input thread takes the bytes; check its queue again shortly
+        poll(NULL, 0, INPUT_QUEUE_RETRY_MS);
+        return;
+    }
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    poll(&pfd, 1, timeout_ms);
+}
+
+/**
+ * Write a list of buffers to stdout, resuming after partial writes
+ * @return 1 on success, 0 on a write error
+ */
+static int write_all(struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(STDOUT_FILENO, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Non-blocking terminal is full: wait until it drains
+                struct pollfd pfd = { STDOUT_FILENO, POLLOUT, 0 };
+                if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return 0;
+                continue;
+            }
+            return 0;
+        }
+        
+        // Drop the buffers written in full, then trim the partial one
+        size_t done = (size_t)written;
+        while (count > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Check whether a reply contains a primary device attributes answer
+ * (CSI ? Ps ; ... c), which a DECRQM answer (ending in $y) never matches
+ */
+static int has_da1_reply(const char* reply) {
+    for (const char* p = strstr(reply, CSI "?"); p; p = strstr(p + 1, CSI "?")) {
+        const char* end = p + strlen(CSI "?");
+        while ((*end >= '0' && *end <= '9') || *end == ';') end++;
+        if (*end == 'c') return 1;
+    }
+    return 0;
+}
+
+/**
+ * Ask the terminal whether it supports synchronized output
+ * DECRQM reports the mode state; the DA1 query behind it is answered by every
+ * terminal, so its reply marks the end of the wait even when DECRQM is ignored.
+ * @return 1 if the mode is recognized, 0 otherwise
+ */
+static int detect_sync_support(void) {
+    struct iovec query = { TERM_QUERY_SYNC TERM_QUERY_DA1, strlen(TERM_QUERY_SYNC TERM_QUERY_DA1) };
+    if (!write_all(&query, 1)) return 0;
+    
+    char reply[QUERY_REPLY_LENGTH + 1];
+    size_t len = 0;
+    struct timeval start, now;
+    gettimeofday(&start, NULL);
+    
+    while (len < QUERY_REPLY_LENGTH) {
+        gettimeofday(&now, NULL);
+        long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000;
+        if (elapsed >= TERM_QUERY_TIMEOUT_MS) break;
+        
+        struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+        if (poll(&pfd, 1, TERM_QUERY_TIMEOUT_MS - elapsed) <= 0) break;
+        
+        ssize_t nread = read(STDIN_FILENO, reply + len, QUERY_REPLY_LENGTH - len);
+        if (nread <= 0) break;
+        len += nread;
+        reply[len] = '\0';
+        
+        // The DA1 reply comes last
+        if (has_da1_reply(reply)) break;
+    }
+    reply[len] = '\0';
+    
+    // Reply is CSI ? 2026 ; Ps $ y where Ps 1 or 2 means set or reset
+    char* mode = strstr(reply, CSI "?2026;");
+    if (!mode) return 0;
+    char state = mode[strlen(CSI "?2026;")];
+    return state == '1' || state == '2';
+}
+
 /**
  * Private function to restore terminal to original state
  * Called automatically at program exit
@@ -22,8 +190,9 @@ static void disable_raw_mode() {
     // Restore terminal settings
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
     
-    // Disable mouse tracking
+    // Disable mouse tracking and bracketed paste
     printf(TERM_MOUSE_OFF);
+    printf(TERM_PASTE_OFF);
     
     // Restore cursor style and visibility before switching screens
     printf(TERM_CURSOR_SHOW);    // Ensure cursor is visible
@@ -35,9 +204,11 @@ static void disable_raw_mode() {
 
 /**
  * Initialize terminal for raw mode
- * Sets up escape sequences, cursor style, mouse tracking
+ * Sets up escape sequences, cursor style, mouse tracking, bracketed paste
  */
 void terminal_init(void) {
+    input_decoder_init(&input);
+    
     // Save original terminal settings
     if (tcgetattr(STDIN_FILENO, &orig_termios) == -1) {
         perror("tcgetattr");
@@ -52,9 +223,10 @@ void terminal_init(void) {
     raw.c_cflag |= (CS8);
     raw.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
     
-    // Set minimum chars and timeout
-    raw.c_cc[VMIN] = 0;  // Return immediately when any char is available
-    raw.c_cc[VTIME] = 1; // Wait up to 100ms for input
+    // Reads never block: they return what is buffered, possibly nothing,
+    // and waiting for input is done with poll
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
     
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) {
         perror("tcsetattr");
@@ -69,43 +241,56 @@ void terminal_init(void) {
     // Enable mouse tracking
     printf(TERM_MOUSE_ON);
     
+    // Pastes arrive as one event instead of a stream of keys
+    printf(TERM_PASTE_ON);
+    
     fflush(stdout);
+    
+    // Raw mode is on, so the terminal's answers can be read back directly
+    sync_supported = detect_sync_support();
+}
+
+int terminal_write_frame(const char* data, size_t len) {
+    if (!data || len == 0) return 1;
+    
+    // One writev per frame; the markers make the terminal show it atomically
+    struct iovec iov[3] = {
+        { TERM_SYNC_BEGIN, strlen(TERM_SYNC_BEGIN) },
+        { (void*)data, len },
+        { TERM_SYNC_END, strlen(TERM_SYNC_END) }
+    };
+    
+    if (sync_supported) return write_all(iov, 3);
+    return write_all(iov + 1, 1);
+}
+
+int terminal_supports_sync(void) {
+    return sync_supported;
 }
 
 void terminal_cleanup(void) {
+    terminal_stop_input_thread();
     disable_raw_mode();
+    input_decoder_cleanup(&input);
 }
 
 char terminal_read_char(void) {
-    int nread;
     char c;
-    while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-        if (nread == -1 && errno != EAGAIN) {
-            perror("read");
-            exit(1);
-        }
+    while (!terminal_read_char_nonblock(&c)) {
+        wait_for_input(-1);
     }
     return c;
 }
 
-// Add this new function after terminal_read_char
 int terminal_read_char_nonblock(char* c) {
-    int nread;
-    fd_set readfds;
-    struct timeval tv = {0, 0}; // Zero timeout for non-blocking behavior
+    if (input_threaded) return 0;  // Bytes go to the input thread's decoder
     
-    FD_ZERO(&readfds);
-    FD_SET(STDIN_FILENO, &readfds);
-    
-    // Check if input is available without blocking
-    if (select(STDIN_FILENO + 1, &readfds, NULL, NULL, &tv) > 0) {
-        nread = read(STDIN_FILENO, c, 1);
-        if (nread == 1) {
-            return 1; // Character available and read
-        }
+    unsigned char byte;
+    if (!input_decoder_take_byte(&input, &byte)) {
+        if (!fill_input() || !input_decoder_take_byte(&input, &byte)) return 0;
     }
-    
-    return 0; // No character available
+    *c = (char)byte;
+    return 1;
 }
 
 int terminal_is_quit(char c) {
@@ -125,71 +310,6 @@ void terminal_get_size(size_t* rows, size_t* cols) {
     }
 }
 
-/**
- * Parse an escape sequence to determine which key was pressed
- * @param sequence The escape sequence to parse
- * @param seq_len Length of the sequence
- * @return Key code or KEY_ESC if not recognized
- */
-static int parse_escape_sequence(const char* sequence, int seq_len) {
-    if (seq_len < 2) return KEY_ESC;
-    
-    // Handle common arrow keys and navigation keys
-    if (sequence[0] == ESC[0] && sequence[1] == '[') {
-        if (seq_len == 3) {
-            switch (sequence[2]) {
-                case 'A': return KEY_ARROW_UP;
-                case 'B': return KEY_ARROW_DOWN;
-                case 'C': return KEY_ARROW_RIGHT;
-                case 'D': return KEY_ARROW_LEFT;
-                case 'H': return KEY_HOME;
-                case 'F': return KEY_END;
-            }
-        } else if (seq_len > 3) {
-            if (sequence[2] == '1' && sequence[3] == '~') return KEY_HOME;
-            if (sequence[2] == '4' && sequence[3] == '~') return KEY_END;
-            if (sequence[2] == '5' && sequence[3] == '~') return KEY_PAGE_UP;
-            if (sequence[2] == '6' && sequence[3] == '~') return KEY_PAGE_DOWN;
-            if (sequence[2] == '3' && sequence[3] == '~') return KEY_DELETE;
-            if (sequence[2] == '2' && sequence[3] == '~') return KEY_INSERT;
-            
-            // VSCode control key combinations
-            if (seq_len >= 6 && sequence[2] == '1' && sequence[3] == ';' && sequence[4] == '5') {
-                switch(sequence[5]) {
-                    case 'A': return KEY_CTRL_UP;      // Ctrl+Up
-                    case 'B': return KEY_CTRL_DOWN;    // Ctrl+Down
-                    case 'C': return KEY_WORD_RIGHT;   // Ctrl+Right
-                    case 'D': return KEY_WORD_LEFT;    // Ctrl+Left
-                    case 'H': return KEY_CTRL_HOME;    // Ctrl+Home
-                    case 'F': return KEY_CTRL_END;     // Ctrl+End
-                }
-            }
-            
-            // Some terminals have different sequences for these
-            if (seq_len >= 5) {
-                if (sequence[2] == '1' && sequence[3] == ';' && sequence[4] == '5' && sequence[5] == 'H')
-                    return KEY_CTRL_HOME;
-                if (sequence[2] == '1' && sequence[3] == ';' && sequence[4] == '5' && sequence[5] == 'F')
-                    return KEY_CTRL_END;
-            }
-        }
-    } else if (sequence[0] == ESC[0] && sequence[1] == 'O') {
-        // Handle alternate arrow key representation
-        if (seq_len == 3) {
-            switch(sequence[2]) {
-                case 'A': return KEY_ARROW_UP;
-                case 'B': return KEY_ARROW_DOWN;
-                case 'C': return KEY_ARROW_RIGHT;
-                case 'D': return KEY_ARROW_LEFT;
-                case 'H': return KEY_HOME;
-                case 'F': return KEY_END;
-            }
-        }
-    }
-    
-    return KEY_ESC; // Default to ESC if not recognized
-}
-
 int terminal_is_mouse_sequence(const char* sequence) {
     if (strlen(sequence) >= 3 && sequence[0] == ESC[0] && sequence[1] == '[' && sequence[2] == '<') {
         return 1; // SGR mouse encoding
@@ -198,166 +318,164 @@ int terminal_is_mouse_sequence(const char* sequence) {
 }
 
 MouseEvent terminal_parse_mouse_sequence(const char* sequence) {
-    MouseEvent event = {MOUSE_NONE, 0, 0, 0};
-    
     // SGR encoded mouse event format: ESC[<button;x;y[M|m]
     // Where 'M' indicates press/drag and 'm' indicates release
-    
     int button, x, y;
     char final;
     if (sscanf(sequence + 3, "%d;%d;%d%c", &button, &x, &y, &final) != 4) {
+        MouseEvent event = {MOUSE_NONE, 0, 0, 0};
         return event;
     }
     
-    // Adjust coordinates (1-based to 0-based)
-    event.x = x - 1;
-    event.y = y - 1;
-    
-    // Process button value
-    if (button == 0) {
-        event.button = 0; // Left button
-    } else if (button == 1) {
-        event.button = 1; // Middle button
-    } else if (button == 2) {
-        event.button = 2; // Right button
-    } else if (button >= 64) {
-        // Mouse wheel (64 + button)
-        if (button == 64) {
-            event.type = MOUSE_WHEEL_UP;
-            return event;
-        } else if (button == 65) {
-            event.type = MOUSE_WHEEL_DOWN;
-            return event;
-        }
-    }
-    
-    // Determine event type based on final character
-    if (final == 'M') {
-        if (button & 32) {
-            event.type = MOUSE_DRAG;
-        } else {
-            event.type = MOUSE_PRESS;
-        }
-    } else if (final == 'm') {
-        event.type = MOUSE_RELEASE;
+    return input_mouse_event(button, x, y, final);
+}
+
+InputEvent terminal_read_event(void) {
+    InputEvent event;
+    while (!terminal_read_event_nonblock(&event)) {
+        wait_for_input(terminal_input_timeout());
     }
-    
     return event;
 }
 
-InputEvent terminal_read_event(void) {
-    InputEvent event = {EVENT_NONE};
-    char sequence[MAX_SEQUENCE_LENGTH] = {0};
-    int seq_pos = 0;
-    
-    // Read first character
-    char c = terminal_read_char();
+/**
+ * Decode the next event from what the terminal sent, reading more if needed
+ * @return 1 if an event was decoded, 0 otherwise
+ */
+static int decode_event(InputEvent* event) {
+    // Decode what is buffered; read another chunk only when it runs dry
+    do {
+        if (input_decoder_next(&input, event)) {
+            escape_since = 0;
+            event->time_us = now_us();
+            event->read_us = last_read_us;
+            return 1;
+        }
+    } while (fill_input());
     
-    if (c == ESC[0]) {
-        // Could be an escape sequence
-        sequence[seq_pos++] = c;
-        
-        // Try to read more characters to form a complete sequence
-        while (seq_pos < MAX_SEQUENCE_LENGTH - 1) {
-            int nread;
-            char next_char;
-            
-            // Short timeout to check if more characters are coming
-            struct timeval tv = {0, 10000}; // 10ms timeout
-            fd_set readfds;
-            FD_ZERO(&readfds);
-            FD_SET(STDIN_FILENO, &readfds);
-            
-            if (select(STDIN_FILENO + 1, &readfds, NULL, NULL, &tv) <= 0) {
-                // Timeout or error - no more chars to read
-                break;
-            }
-            
-            if ((nread = read(STDIN_FILENO, &next_char, 1)) != 1) {
-                break;
-            }
-            
-            sequence[seq_pos++] = next_char;
-            sequence[seq_pos] = '\0';
-            
-            // Check if we've read a complete mouse sequence
-            if (terminal_is_mouse_sequence(sequence) && 
-                (seq_pos >= 3 && (sequence[seq_pos-1] == 'M' || sequence[seq_pos-1] == 'm'))) {
-                event.type = EVENT_MOUSE;
-                event.mouse = terminal_parse_mouse_sequence(sequence);
-                return event;
-            }
+    // A lone ESC is the Escape key once nothing has followed it for a while
+    if (input_decoder_waiting(&input)) {
+        long long now = now_ms();
+        if (escape_since == 0) escape_since = now;
+        if (now - escape_since >= INPUT_ESC_TIMEOUT_MS) {
+            escape_since = 0;
+            event->time_us = now_us();
+            event->read_us = last_read_us;
+            return input_decoder_flush(&input, event);
         }
-        
-        // If it wasn't a mouse event, check for special keys
-        event.type = EVENT_KEY;
-        event.key = parse_escape_sequence(sequence, seq_pos);
-    } else {
-        // Regular key press
-        event.type = EVENT_KEY;
-        event.key = c;
     }
     
-    return event;
+    return 0;  // No event available
+}
+
+/**
+ * Milliseconds a lone ESC may still wait, or -1 if none is pending
+ */
+static int escape_timeout(void) {
+    if (!input_decoder_waiting(&input)) return -1;
+    if (escape_since == 0) return INPUT_ESC_TIMEOUT_MS;
+    
+    long long left = escape_since + INPUT_ESC_TIMEOUT_MS - now_ms();
+    return left > 0 ? (int)left : 0;
 }
 
 int terminal_read_event_nonblock(InputEvent* event) {
     if (!event) return 0;
-    
-    // Initialize event to NONE by default
     event->type = EVENT_NONE;
     
-    // Check if input is available without blocking
-    char c;
-    if (terminal_read_char_nonblock(&c)) {
-        // Input is available, start processing
-        char sequence[MAX_SEQUENCE_LENGTH] = {0};
-        int seq_pos = 0;
-        
-        if (c == ESC[0]) {
-            // Could be an escape sequence
-            sequence[seq_pos++] = c;
-            
-            // Try to read more characters to form a complete sequence
-            while (seq_pos < MAX_SEQUENCE_LENGTH - 1) {
-                // Short timeout to check if more characters are coming
-                struct timeval tv = {0, 5000}; // 5ms timeout - reduced from original
-                fd_set readfds;
-                FD_ZERO(&readfds);
-                FD_SET(STDIN_FILENO, &readfds);
-                
-                if (select(STDIN_FILENO + 1, &readfds, NULL, NULL, &tv) <= 0) {
-                    // Timeout or error - no more chars to read
-                    break;
-                }
-                
-                char next_char;
-                int nread = read(STDIN_FILENO, &next_char, 1);
-                if (nread != 1) break;
-                
-                sequence[seq_pos++] = next_char;
-                sequence[seq_pos] = '\0';
-                
-                // Check if we've read a complete mouse sequence
-                if (terminal_is_mouse_sequence(sequence) && 
-                    (seq_pos >= 3 && (sequence[seq_pos-1] == 'M' || sequence[seq_pos-1] == 'm'))) {
-                    event->type = EVENT_MOUSE;
-                    event->mouse = terminal_parse_mouse_sequence(sequence);
-                    return 1;  // Event available
+    if (input_threaded) return event_queue_pop(input_queue, event);
+    return decode_event(event);
+}
+
+int terminal_input_timeout(void) {
+    // The input thread times out a lone ESC itself
+    if (input_threaded) return -1;
+    return escape_timeout();
+}
+
+/**
+ * Input thread: decode events as bytes arrive and queue them
+ */
+static void* input_thread_main(void* arg) {
+    (void)arg;
+    
+    while (!atomic_load(&input_stop)) {
+        InputEvent event;
+        int queued = 0;
+        while (decode_event(&event)) {
+            // A full queue means the editor is busy; wait for it to catch up
+            while (!event_queue_push(input_queue, &event)) {
+                if (input_notify) input_notify();
+                struct pollfd stop = { stop_pipe[0], POLLIN, 0 };
+                poll(&stop, 1, INPUT_QUEUE_RETRY_MS);
+                if (atomic_load(&input_stop)) {
+                    if (event.type == EVENT_PASTE) free(event.paste.text);
+                    return NULL;
                 }
             }
-            
-            // If it wasn't a mouse event, check for special keys
-            event->type = EVENT_KEY;
-            event->key = parse_escape_sequence(sequence, seq_pos);
-        } else {
-            // Regular key press
-            event->type = EVENT_KEY;
-            event->key = c;
+            queued = 1;
         }
+        if (queued && input_notify) input_notify();
+        
+        struct pollfd fds[2] = {
+            { STDIN_FILENO, POLLIN, 0 },
+            { stop_pipe[0], POLLIN, 0 }
+        };
+        if (poll(fds, 2, escape_timeout()) < 0 && errno != EINTR) break;
         
-        return 1;  // Event available
+        // Once the terminal is gone nothing more can arrive; the editor
+        // sees the hangup itself
+        if ((fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) && !(fds[0].revents & POLLIN)) break;
     }
+    return NULL;
+}
+
+int terminal_start_input_thread(TerminalNotify notify) {
+    if (input_threaded) return 1;
     
-    return 0;  // No event available
-}
\ No newline at end of file
+    input_queue = event_queue_create(EVENT_QUEUE_DEFAULT_CAPACITY);
+    if (!input_queue) return 0;
+    if (pipe(stop_pipe) == -1) {
+        stop_pipe[0] = stop_pipe[1] = -1;
+        event_queue_free(input_queue);
+        input_queue = NULL;
+        return 0;
+    }
+    input_notify = notify;
+    atomic_store(&input_stop, 0);
+    
+    // Signals such as SIGWINCH stay with the threads that handle them
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    int started = pthread_create(&input_thread, NULL, input_thread_main, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    
+    if (!started) {
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        stop_pipe[0] = stop_pipe[1] = -1;
+        event_queue_free(input_queue);
+        input_queue = NULL;
+        return 0;
+    }
+    input_threaded = 1;
+    return 1;
+}
+
+void terminal_stop_input_thread(void) {
+    if (!input_threaded) return;
+    
+    atomic_store(&input_stop, 1);
+    char byte = 0;
+    ssize_t written = write(stop_pipe[1], &byte, 1);
+    (void)written;
+    pthread_join(input_thread, NULL);
+    
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    stop_pipe[0] = stop_pipe[1] = -1;
+    event_queue_free(input_queue);
+    input_queue = NULL;
+    input_threaded = 0;
+}
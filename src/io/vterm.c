@@ -0,0 +1,402 @@
+#include <stdlib.h>
+#include "vterm.h"
+
+// Parser states
+#define STATE_GROUND 0     // Plain text
+#define STATE_ESCAPE 1     // After ESC
+#define STATE_CSI    2     // Inside a control sequence
+#define STATE_STRING 3     // Inside an OSC/DCS string, until ST or BEL
+#define STATE_STRING_ESCAPE 4  // ESC seen inside a string
+
+// Tab stops every eight columns
+#define TAB_WIDTH 8
+
+/**
+ * Blank cells with the current background
+ */
+static void erase_cells(VTerm* vterm, size_t from, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        VTermCell* cell = &vterm->cells[from + i];
+        cell->ch = ' ';
+        cell->fg = VTERM_DEFAULT_COLOR;
+        cell->bg = vterm->bg;
+    }
+}
+
+/**
+ * Move rows top..bottom up (positive) or down (negative), blanking the rows exposed
+ */
+static void scroll_rows(VTerm* vterm, size_t top, size_t bottom, long delta) {
+    if (top > bottom || bottom >= vterm->rows || delta == 0) return;
+
+    size_t height = bottom - top + 1;
+    size_t shift = delta > 0 ? (size_t)delta : (size_t)-delta;
+    if (shift > height) shift = height;
+
+    size_t cols = vterm->cols;
+    size_t kept = height - shift;
+    if (delta > 0) {
+        for (size_t row = top; row < top + kept; row++) {
+            for (size_t col = 0; col < cols; col++) {
+                vterm->cells[row * cols + col] = vterm->cells[(row + shift) * cols + col];
+            }
+        }
+        erase_cells(vterm, (top + kept) * cols, shift * cols);
+    } else {
+        for (size_t row = bottom; row >= top + shift; row--) {
+            for (size_t col = 0; col < cols; col++) {
+                vterm->cells[row * cols + col] = vterm->cells[(row - shift) * cols + col];
+            }
+        }
+        erase_cells(vterm, top * cols, shift * cols);
+    }
+}
+
+/**
+ * Move the cursor down one row, scrolling at the bottom of the scroll region
+ */
+static void line_feed(VTerm* vterm) {
+    if (vterm->cursor_row == vterm->scroll_bottom) {
+        scroll_rows(vterm, vterm->scroll_top, vterm->scroll_bottom, 1);
+    } else if (vterm->cursor_row + 1 < vterm->rows) {
+        vterm->cursor_row++;
+    }
+}
+
+/**
+ * Draw a character at the cursor and advance it, wrapping before the next
+ * character when the last column is reached
+ */
+static void put_char(VTerm* vterm, char ch) {
+    if (vterm->pending_wrap) {
+        vterm->cursor_col = 0;
+        line_feed(vterm);
+        vterm->pending_wrap = 0;
+    }
+
+    VTermCell* cell = &vterm->cells[vterm->cursor_row * vterm->cols + vterm->cursor_col];
+    cell->ch = ch;
+    cell->fg = vterm->fg;
+    cell->bg = vterm->bg;
+
+    if (vterm->cursor_col + 1 < vterm->cols) {
+        vterm->cursor_col++;
+    } else {
+        vterm->pending_wrap = 1;
+    }
+}
+
+/**
+ * Get a numeric parameter, or a default if it was omitted or zero
+ */
+static size_t param(const VTerm* vterm, size_t i, size_t fallback) {
+    if (i >= vterm->param_count || vterm->params[i] <= 0) return fallback;
+    return (size_t)vterm->params[i];
+}
+
+/**
+ * Clamp a 1-based position parameter to a 0-based coordinate below limit
+ */
+static size_t position(const VTerm* vterm, size_t i, size_t limit) {
+    size_t value = param(vterm, i, 1) - 1;
+    return value < limit ? value : limit - 1;
+}
+
+/**
+ * Apply a Select Graphic Rendition sequence
+ * @return 1 if every parameter was understood, 0 otherwise
+ */
+static int select_graphic_rendition(VTerm* vterm) {
+    int understood = 1;
+    size_t count = vterm->param_count ? vterm->param_count : 1;
+
+    for (size_t i = 0; i < count; i++) {
+        long code = i < vterm->param_count && vterm->params[i] >= 0 ? vterm->params[i] : 0;
+
+        if (code == 0) {
+            vterm->fg = VTERM_DEFAULT_COLOR;
+            vterm->bg = VTERM_DEFAULT_COLOR;
+        } else if (code == 38 || code == 48) {
+            // 256-color form only: 38;5;n or 48;5;n
+            if (i + 2 < vterm->param_count && vterm->params[i + 1] == 5 &&
+                vterm->params[i + 2] >= 0 && vterm->params[i + 2] < 256) {
+                short color = (short)vterm->params[i + 2];
+                if (code == 38) vterm->fg = color;
+                else vterm->bg = color;
+                i += 2;
+            } else {
+                return 0;
+            }
+        } else if (code == 39) {
+            vterm->fg = VTERM_DEFAULT_COLOR;
+        } else if (code == 49) {
+            vterm->bg = VTERM_DEFAULT_COLOR;
+        } else if (code >= 30 && code <= 37) {
+            vterm->fg = (short)(code - 30);
+        } else if (code >= 40 && code <= 47) {
+            vterm->bg = (short)(code - 40);
+        } else if (code >= 90 && code <= 97) {
+            vterm->fg = (short)(code - 90 + 8);
+        } else if (code >= 100 && code <= 107) {
+            vterm->bg = (short)(code - 100 + 8);
+        } else {
+            // Bold, underline and the like have no place in the cell model
+            understood = 0;
+        }
+    }
+    return understood;
+}
+
+/**
+ * Execute a complete control sequence
+ * @return 1 if it was understood, 0 otherwise
+ */
+static int dispatch_csi(VTerm* vterm, char final) {
+    size_t rows = vterm->rows;
+    size_t cols = vterm->cols;
+    size_t row = vterm->cursor_row;
+    size_t col = vterm->cursor_col;
+
+    if (vterm->private_marker) {
+        // Private modes (?25 cursor, ?1049 alternate screen, ?2026 synchronized
+        // output, ...) don't change the cells
+        return final == 'h' || final == 'l';
+    }
+    if (vterm->intermediate) {
+        // Cursor shape (CSI n SP q) only
+        return vterm->intermediate == ' ' && final == 'q';
+    }
+
+    vterm->pending_wrap = 0;
+
+    switch (final) {
+        case 'A': {
+            size_t n = param(vterm, 0, 1);
+            vterm->cursor_row = n < row ? row - n : 0;
+            return 1;
+        }
+        case 'B': {
+            size_t n = param(vterm, 0, 1);
+            vterm->cursor_row = row + n < rows ? row + n : rows - 1;
+            return 1;
+        }
+        case 'C': {
+            size_t n = param(vterm, 0, 1);
+            vterm->cursor_col = col + n < cols ? col + n : cols - 1;
+            return 1;
+        }
+        case 'D': {
+            size_t n = param(vterm, 0, 1);
+            vterm->cursor_col = n < col ? col - n : 0;
+            return 1;
+        }
+        case 'G':
+            vterm->cursor_col = position(vterm, 0, cols);
+            return 1;
+        case 'd':
+            vterm->cursor_row = position(vterm, 0, rows);
+            return 1;
+        case 'H':
+        case 'f':
+            vterm->cursor_row = position(vterm, 0, rows);
+            vterm->cursor_col = position(vterm, 1, cols);
+            return 1;
+        case 'J': {
+            size_t here = row * cols + col;
+            long mode = vterm->param_count ? vterm->params[0] : 0;
+            if (mode <= 0) erase_cells(vterm, here, rows * cols - here);
+            else if (mode == 1) erase_cells(vterm, 0, here + 1);
+            else if (mode == 2 || mode == 3) erase_cells(vterm, 0, rows * cols);
+            else return 0;
+            return 1;
+        }
+        case 'K': {
+            size_t start = row * cols;
+            long mode = vterm->param_count ? vterm->params[0] : 0;
+            if (mode <= 0) erase_cells(vterm, start + col, cols - col);
+            else if (mode == 1) erase_cells(vterm, start, col + 1);
+            else if (mode == 2) erase_cells(vterm, start, cols);
+            else return 0;
+            return 1;
+        }
+        case 'X': {
+            size_t n = param(vterm, 0, 1);
+            erase_cells(vterm, row * cols + col, n < cols - col ? n : cols - col);
+            return 1;
+        }
+        case 'S':
+            scroll_rows(vterm, vterm->scroll_top, vterm->scroll_bottom, (long)param(vterm, 0, 1));
+            return 1;
+        case 'T':
+            scroll_rows(vterm, vterm->scroll_top, vterm->scroll_bottom, -(long)param(vterm, 0, 1));
+            return 1;
+        case 'r': {
+            size_t top = position(vterm, 0, rows);
+            size_t bottom = vterm->param_count > 1 && vterm->params[1] > 0
+                ? position(vterm, 1, rows) : rows - 1;
+            if (top >= bottom) return 0;
+            vterm->scroll_top = top;
+            vterm->scroll_bottom = bottom;
+            // Setting the region homes the cursor
+            vterm->cursor_row = 0;
+            vterm->cursor_col = 0;
+            return 1;
+        }
+        case 'm':
+            return select_graphic_rendition(vterm);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Handle a control character outside of a sequence
+ */
+static void control(VTerm* vterm, char ch) {
+    switch (ch) {
+        case '\r':
+            vterm->cursor_col = 0;
+            vterm->pending_wrap = 0;
+            break;
+        case '\n':
+        case '\v':
+        case '\f':
+            line_feed(vterm);
+            vterm->pending_wrap = 0;
+            break;
+        case '\b':
+            if (vterm->pending_wrap) vterm->pending_wrap = 0;
+            else if (vterm->cursor_col > 0) vterm->cursor_col--;
+            break;
+        case '\t': {
+            size_t next = (vterm->cursor_col / TAB_WIDTH + 1) * TAB_WIDTH;
+            vterm->cursor_col = next < vterm->cols ? next : vterm->cols - 1;
+            vterm->pending_wrap = 0;
+            break;
+        }
+        case '\a':
+            break;
+        default:
+            vterm->unknown++;
+            break;
+    }
+}
+
+VTerm* vterm_create(size_t rows, size_t cols) {
+    if (rows == 0 || cols == 0) return NULL;
+
+    VTerm* vterm = (VTerm*)calloc(1, sizeof(VTerm));
+    if (!vterm) return NULL;
+
+    vterm->cells = (VTermCell*)malloc(sizeof(VTermCell) * rows * cols);
+    if (!vterm->cells) {
+        free(vterm);
+        return NULL;
+    }
+
+    vterm->rows = rows;
+    vterm->cols = cols;
+    vterm->fg = VTERM_DEFAULT_COLOR;
+    vterm->bg = VTERM_DEFAULT_COLOR;
+    vterm->scroll_top = 0;
+    vterm->scroll_bottom = rows - 1;
+    vterm->state = STATE_GROUND;
+    erase_cells(vterm, 0, rows * cols);
+    return vterm;
+}
+
+void vterm_free(VTerm* vterm) {
+    if (!vterm) return;
+    free(vterm->cells);
+    free(vterm);
+}
+
+void vterm_write(VTerm* vterm, const char* data, size_t len) {
+    if (!vterm || !data) return;
+    vterm->bytes += len;
+
+    for (size_t i = 0; i < len; i++) {
+        char ch = data[i];
+        unsigned char byte = (unsigned char)ch;
+
+        switch (vterm->state) {
+            case STATE_GROUND:
+                if (ch == '\x1b') {
+                    vterm->state = STATE_ESCAPE;
+                } else if (byte < 0x20 || byte == 0x7f) {
+                    control(vterm, ch);
+                } else {
+                    put_char(vterm, ch);
+                }
+                break;
+
+            case STATE_ESCAPE:
+                if (ch == '[') {
+                    vterm->state = STATE_CSI;
+                    vterm->private_marker = 0;
+                    vterm->intermediate = 0;
+                    vterm->param_count = 0;
+                } else if (ch == ']' || ch == 'P' || ch == '_' || ch == '^') {
+                    vterm->state = STATE_STRING;
+                } else {
+                    // Two-byte escapes (save/restore cursor, keypad modes) don't reach the cells
+                    vterm->unknown++;
+                    vterm->state = STATE_GROUND;
+                }
+                break;
+
+            case STATE_CSI:
+                if (ch >= '0' && ch <= '9') {
+                    if (vterm->param_count == 0) {
+                        vterm->params[0] = -1;
+                        vterm->param_count = 1;
+                    }
+                    long* value = &vterm->params[vterm->param_count - 1];
+                    if (*value < 0) *value = 0;
+                    if (*value < 100000) *value = *value * 10 + (ch - '0');
+                } else if (ch == ';' || ch == ':') {
+                    if (vterm->param_count == 0) {
+                        vterm->params[0] = -1;
+                        vterm->param_count = 1;
+                    }
+                    if (vterm->param_count < VTERM_MAX_PARAMS) {
+                        vterm->params[vterm->param_count++] = -1;
+                    }
+                } else if (ch >= '<' && ch <= '?') {
+                    vterm->private_marker = ch;
+                } else if (byte >= 0x20 && byte <= 0x2f) {
+                    vterm->intermediate = ch;
+                } else if (byte >= 0x40 && byte <= 0x7e) {
+                    if (!dispatch_csi(vterm, ch)) vterm->unknown++;
+                    vterm->state = STATE_GROUND;
+                } else if (ch == '\x1b') {
+                    // Sequence abandoned for a new one
+                    vterm->unknown++;
+                    vterm->state = STATE_ESCAPE;
+                } else {
+                    control(vterm, ch);
+                }
+                break;
+
+            case STATE_STRING:
+                if (ch == '\a') vterm->state = STATE_GROUND;
+                else if (ch == '\x1b') vterm->state = STATE_STRING_ESCAPE;
+                break;
+
+            case STATE_STRING_ESCAPE:
+                vterm->state = ch == '\\' ? STATE_GROUND : STATE_STRING;
+                break;
+        }
+    }
+}
+
+int vterm_sink_write(void* context, const char* data, size_t len) {
+    if (!context) return 0;
+    vterm_write((VTerm*)context, data, len);
+    return 1;
+}
+
+const VTermCell* vterm_cell(const VTerm* vterm, size_t row, size_t col) {
+    if (!vterm || row >= vterm->rows || col >= vterm->cols) return NULL;
+    return &vterm->cells[row * vterm->cols + col];
+}
@@ -2,17 +2,49 @@
 #include <stdlib.h>
 #include <string.h>
 #include "editor.h"
+#include "bench.h"
+#include "ptybench.h"
+#include "latency.h"
 
 /**
  * Main entry point for the editor
  * Handles initialization, command line arguments, and delegates to editor component
  */
 int main(int argc, char *argv[]) {
+    // Headless benchmarks never touch the terminal
+    if (argc >= 2 && strcmp(argv[1], "--bench-render") == 0) {
+        return bench_render(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bench-input") == 0) {
+        return bench_input(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bench-pty") == 0) {
+        return ptybench_run(argv[0], argc - 2, argv + 2);
+    }
+
+    // Options come before the file name
+    int arg = 1;
+    int input_thread = 0;
+    int render_thread = 0;
+    const char* latency_file = NULL;
+    while (arg < argc) {
+        if (strcmp(argv[arg], "--input-thread") == 0) {
+            input_thread = 1;
+        } else if (strcmp(argv[arg], "--render-thread") == 0) {
+            render_thread = 1;
+        } else if (strcmp(argv[arg], "--latency") == 0 && arg + 1 < argc) {
+            latency_file = argv[++arg];
+        } else {
+            break;
+        }
+        arg++;
+    }
+
     // Initialize terminal and get dimensions
     size_t rows, cols;
     editor_initialize_terminal(&rows, &cols);
     
-    if (argc < 2) {
+    if (arg >= argc) {
         // No file specified, show welcome screen
         editor_show_welcome_screen(rows, cols);
         editor_cleanup_terminal();
@@ -20,7 +52,7 @@ int main(int argc, char *argv[]) {
     }
 
     // Check if file exists and is regular file
-    const char *filename = argv[1];
+    const char *filename = argv[arg];
     if (!editor_validate_file(filename)) {
         editor_cleanup_terminal();
         printf("'%s' is not a regular file\n", filename);
@@ -35,6 +67,21 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    // Measure keypress-to-screen latency, shown in the status bar
+    if (latency_file) {
+        latency_enable();
+    }
+    
+    // Keep reading input while the editor works (falls back to one thread)
+    if (input_thread) {
+        editor_start_input_thread();
+    }
+    
+    // Write frames while the editor works (falls back to one thread)
+    if (render_thread) {
+        editor_start_render_thread();
+    }
+    
     // Run editor main loop
     int result = editor_run(state);
     
@@ -42,5 +89,11 @@ int main(int argc, char *argv[]) {
     editor_free(state);
     editor_cleanup_terminal();
     
+    // The render thread has stopped, so every written frame is counted
+    if (latency_file && !latency_dump(latency_file)) {
+        fprintf(stderr, "Failed to write latency histograms to %s\n", latency_file);
+        return 1;
+    }
+    
     return result;
 }
\ No newline at end of file
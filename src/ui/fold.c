@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include "fold.h"
+
+// Seed for the priority generator
+#define FOLD_SEED 0x9e3779b9u
+
+// xorshift32: cheap priorities are all a treap needs
+static unsigned next_priority(FoldSet* folds) {
+    unsigned x = folds->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    folds->seed = x;
+    return x;
+}
+
+static size_t subtree_hidden(FoldNode* node) {
+    return node ? node->hidden : 0;
+}
+
+// Move a whole subtree by delta lines, deferring the work below its root
+static void apply_shift(FoldNode* node, long delta) {
+    if (!node || delta == 0) return;
+    node->start += delta;
+    node->end += delta;
+    node->shift += delta;
+}
+
+// Hand a pending shift down to the children
+static void push(FoldNode* node) {
+    if (node->shift == 0) return;
+    apply_shift(node->left, node->shift);
+    apply_shift(node->right, node->shift);
+    apply_shift(node->nested, node->shift);
+    node->shift = 0;
+}
+
+static void update(FoldNode* node) {
+    node->hidden = (node->end - node->start) +
+                   subtree_hidden(node->left) + subtree_hidden(node->right);
+}
+
+// Split into folds starting before key and folds starting at or after key
+static void split(FoldNode* node, size_t key, FoldNode** before, FoldNode** after) {
+    if (!node) {
+        *before = NULL;
+        *after = NULL;
+        return;
+    }
+
+    push(node);
+    if (node->start < key) {
+        split(node->right, key, &node->right, after);
+        *before = node;
+    } else {
+        split(node->left, key, before, &node->left);
+        *after = node;
+    }
+    update(node);
+}
+
+// Join two trees where every fold in a comes before every fold in b
+static FoldNode* merge(FoldNode* a, FoldNode* b) {
+    if (!a) return b;
+    if (!b) return a;
+
+    if (a->priority > b->priority) {
+        push(a);
+        a->right = merge(a->right, b);
+        update(a);
+        return a;
+    }
+
+    push(b);
+    b->left = merge(a, b->left);
+    update(b);
+    return b;
+}
+
+static void free_tree(FoldNode* node) {
+    if (!node) return;
+    free_tree(node->left);
+    free_tree(node->right);
+    free_tree(node->nested);
+    free(node);
+}
+
+// Detach the last fold of a tree
+static FoldNode* pop_last(FoldNode** tree) {
+    FoldNode* node = *tree;
+    if (!node) return NULL;
+
+    push(node);
+    if (node->right) {
+        FoldNode* last = pop_last(&node->right);
+        update(node);
+        return last;
+    }
+
+    *tree = node->left;
+    node->left = NULL;
+    update(node);
+    return node;
+}
+
+// Peek at the last fold of a tree (shifts are pushed on the way down)
+static FoldNode* peek_last(FoldNode* node) {
+    if (!node) return NULL;
+    push(node);
+    while (node->right) {
+        node = node->right;
+        push(node);
+    }
+    return node;
+}
+
+FoldSet* fold_set_create(void) {
+    FoldSet* folds = malloc(sizeof(FoldSet));
+    if (!folds) return NULL;
+
+    folds->root = NULL;
+    folds->seed = FOLD_SEED;
+    return folds;
+}
+
+void fold_set_free(FoldSet* folds) {
+    if (!folds) return;
+    free_tree(folds->root);
+    free(folds);
+}
+
+int fold_set_add(FoldSet* folds, size_t start, size_t end) {
+    if (!folds || end <= start) return 0;
+
+    FoldNode *before, *inside, *after;
+    split(folds->root, start, &before, &inside);
+    split(inside, end + 1, &inside, &after);
+
+    // Reject ranges that are hidden or partially overlap an existing fold
+    FoldNode* prev = peek_last(before);
+    FoldNode* last = peek_last(inside);
+    int valid = !(prev && prev->end >= start) && !(last && last->end > end);
+
+    // A fold with the same header must be strictly smaller to nest
+    if (valid && inside) {
+        FoldNode* first = inside;
+        push(first);
+        while (first->left) {
+            first = first->left;
+            push(first);
+        }
+        if (first->start == start && first->end >= end) valid = 0;
+    }
+
+    FoldNode* node = valid ? malloc(sizeof(FoldNode)) : NULL;
+    if (!node) {
+        folds->root = merge(merge(before, inside), after);
+        return 0;
+    }
+
+    node->start = start;
+    node->end = end;
+    node->shift = 0;
+    node->priority = next_priority(folds);
+    node->left = NULL;
+    node->right = NULL;
+    node->nested = inside;
+    update(node);
+
+    folds->root = merge(merge(before, node), after);
+    return 1;
+}
+
+int fold_set_remove(FoldSet* folds, size_t start) {
+    if (!folds) return 0;
+
+    FoldNode *before, *match, *after;
+    split(folds->root, start, &before, &match);
+    split(match, start + 1, &match, &after);
+
+    if (!match) {
+        folds->root = merge(before, after);
+        return 0;
+    }
+
+    // Folds collapsed inside come back as top-level folds
+    push(match);
+    FoldNode* nested = match->nested;
+    free(match);
+
+    folds->root = merge(merge(before, nested), after);
+    return 1;
+}
+
+void fold_set_clear(FoldSet* folds) {
+    if (!folds) return;
+    free_tree(folds->root);
+    folds->root = NULL;
+}
+
+void fold_set_shift(FoldSet* folds, size_t line, long delta) {
+    if (!folds || delta == 0) return;
+
+    // Lines line+1 .. line+span are gone after a removal
+    size_t span = delta < 0 ? (size_t)(-delta) : 0;
+
+    FoldNode *before, *after;
+    split(folds->root, line, &before, &after);
+
+    // Expand folds covering the edited line, keeping their nested folds
+    FoldNode* last;
+    while ((last = peek_last(before)) != NULL && last->end >= line) {
+        last = pop_last(&before);
+        FoldNode *nested_before, *nested_after;
+        split(last->nested, line, &nested_before, &nested_after);
+        last->nested = NULL;
+        free(last);
+        before = merge(before, nested_before);
+        after = merge(nested_after, after);
+    }
+
+    // Drop folds whose header was edited or removed, keeping nested folds past the edit
+    FoldNode* touched;
+    FoldNode* kept = NULL;
+    split(after, line + span + 1, &touched, &after);
+    while ((last = pop_last(&touched)) != NULL) {
+        FoldNode *nested_before, *nested_after;
+        split(last->nested, line + span + 1, &nested_before, &nested_after);
+        free(last);
+        touched = merge(touched, nested_before);
+        kept = merge(nested_after, kept);
+    }
+    after = merge(kept, after);
+
+    apply_shift(after, delta);
+    folds->root = merge(before, after);
+}
+
+int fold_set_find(FoldSet* folds, size_t line, size_t* start, size_t* end) {
+    if (!folds) return 0;
+
+    // Last fold whose header is at or before line
+    FoldNode* node = folds->root;
+    FoldNode* found = NULL;
+    while (node) {
+        push(node);
+        if (node->start <= line) {
+            found = node;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+
+    if (!found || found->end < line) return 0;
+    if (start) *start = found->start;
+    if (end) *end = found->end;
+    return 1;
+}
+
+size_t fold_set_hidden(FoldSet* folds) {
+    return folds ? subtree_hidden(folds->root) : 0;
+}
+
+size_t fold_set_to_visible(FoldSet* folds, size_t line) {
+    if (!folds) return line;
+
+    size_t hidden = 0; // Hidden lines before the current subtree
+    FoldNode* node = folds->root;
+    while (node) {
+        push(node);
+        if (node->start < line) {
+            size_t left_hidden = hidden + subtree_hidden(node->left);
+            if (line <= node->end) {
+                // Hidden line: report the header's row
+                return node->start - left_hidden;
+            }
+            hidden = left_hidden + (node->end - node->start);
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return line - hidden;
+}
+
+size_t fold_set_from_visible(FoldSet* folds, size_t row) {
+    if (!folds) return row;
+
+    size_t hidden = 0; // Hidden lines before the current subtree
+    FoldNode* node = folds->root;
+    while (node) {
+        push(node);
+        size_t left_hidden = hidden + subtree_hidden(node->left);
+        size_t header_row = node->start - left_hidden;
+        if (row <= header_row) {
+            node = node->left;
+        } else {
+            hidden = left_hidden + (node->end - node->start);
+            node = node->right;
+        }
+    }
+    return row + hidden;
+}
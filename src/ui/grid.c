@@ -0,0 +1,492 @@
+#include <stdlib.h>
+#include <string.h>
+#include "grid.h"
+#include "ui.h"
+#include "terminal.h"
+
+// Length of TERM_CLEAR_LINE; shorter blank tails are written as spaces
+#define CLEAR_LINE_COST 3
+
+static int cells_alloc(GridCells* cells, size_t count) {
+    cells->chars = malloc(count ? count : 1);
+    cells->attrs = malloc(sizeof(GridAttr) * (count ? count : 1));
+    if (!cells->chars || !cells->attrs) {
+        free(cells->chars);
+        free(cells->attrs);
+        return 0;
+    }
+    return 1;
+}
+
+static void cells_free(GridCells* cells) {
+    free(cells->chars);
+    free(cells->attrs);
+}
+
+static void fill_attrs(GridAttr* attrs, size_t count, GridAttr attr) {
+    for (size_t i = 0; i < count; i++) {
+        attrs[i] = attr;
+    }
+}
+
+static void cells_blank(GridCells* cells, size_t count) {
+    memset(cells->chars, ' ', count);
+    fill_attrs(cells->attrs, count, GRID_ATTR_DEFAULT);
+}
+
+Grid* grid_create(size_t rows, size_t cols) {
+    Grid* grid = malloc(sizeof(Grid));
+    if (!grid) return NULL;
+
+    grid->rows = 0;
+    grid->cols = 0;
+    grid->front.chars = NULL;
+    grid->front.attrs = NULL;
+    grid->back.chars = NULL;
+    grid->back.attrs = NULL;
+    grid->dirty = NULL;
+    grid->target_row = 0;
+    grid->target_col = 0;
+
+    if (!grid_resize(grid, rows, cols)) {
+        free(grid);
+        return NULL;
+    }
+    return grid;
+}
+
+void grid_free(Grid* grid) {
+    if (!grid) return;
+    cells_free(&grid->front);
+    cells_free(&grid->back);
+    free(grid->dirty);
+    free(grid);
+}
+
+int grid_resize(Grid* grid, size_t rows, size_t cols) {
+    if (!grid) return 0;
+    if (grid->front.chars && rows == grid->rows && cols == grid->cols) return 1;
+
+    GridCells front, back;
+    unsigned char* dirty = malloc(rows ? rows : 1);
+    if (!dirty) return 0;
+    if (!cells_alloc(&front, rows * cols)) {
+        free(dirty);
+        return 0;
+    }
+    if (!cells_alloc(&back, rows * cols)) {
+        cells_free(&front);
+        free(dirty);
+        return 0;
+    }
+
+    cells_free(&grid->front);
+    cells_free(&grid->back);
+    free(grid->dirty);
+    grid->front = front;
+    grid->back = back;
+    grid->dirty = dirty;
+    grid->rows = rows;
+    grid->cols = cols;
+
+    cells_blank(&grid->back, rows * cols);
+    grid_invalidate(grid);
+    return 1;
+}
+
+void grid_invalidate(Grid* grid) {
+    if (!grid) return;
+    grid->invalid = 1;
+    memset(grid->dirty, 1, grid->rows);
+    grid->cursor_row = SIZE_MAX;
+    grid->cursor_col = 0;
+}
+
+void grid_clear(Grid* grid) {
+    if (!grid) return;
+    cells_blank(&grid->back, grid->rows * grid->cols);
+    memset(grid->dirty, 1, grid->rows);
+}
+
+// Flag a row if the span just written differs from what the terminal shows
+static void mark_span(Grid* grid, size_t row, size_t base, size_t count) {
+    if (grid->dirty[row]) return;
+    grid->dirty[row] =
+        memcmp(grid->back.chars + base, grid->front.chars + base, count) != 0 ||
+        memcmp(grid->back.attrs + base, grid->front.attrs + base, sizeof(GridAttr) * count) != 0;
+}
+
+size_t grid_write(Grid* grid, size_t row, size_t col, const char* text, size_t len, GridAttr attr) {
+    if (!grid || row >= grid->rows || col >= grid->cols) return 0;
+    if (len > grid->cols - col) len = grid->cols - col;
+
+    size_t base = row * grid->cols + col;
+    char* chars = grid->back.chars + base;
+
+    // Copy the span whole, then blank out any control characters
+    memcpy(chars, text, len);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = (unsigned char)chars[i];
+        chars[i] = (ch < ' ' || ch == 0x7f) ? ' ' : (char)ch;
+    }
+    fill_attrs(grid->back.attrs + base, len, attr);
+    mark_span(grid, row, base, len);
+    return len;
+}
+
+size_t grid_write_uint(Grid* grid, size_t row, size_t col, size_t width, size_t value, GridAttr attr) {
+    char digits[UI_UINT_DIGITS];
+    size_t len = ui_format_uint(digits, value);
+
+    // Right-align in width cells; wider numbers are written in full
+    size_t pad = width > len ? width - len : 0;
+    grid_fill(grid, row, col, pad, ' ', attr);
+    return pad + grid_write(grid, row, col + pad, digits, len, attr);
+}
+
+void grid_fill(Grid* grid, size_t row, size_t col, size_t count, char ch, GridAttr attr) {
+    if (!grid || row >= grid->rows || col >= grid->cols) return;
+    if (count > grid->cols - col) count = grid->cols - col;
+
+    size_t base = row * grid->cols + col;
+    memset(grid->back.chars + base, ch, count);
+    fill_attrs(grid->back.attrs + base, count, attr);
+    mark_span(grid, row, base, count);
+}
+
+void grid_load(Grid* grid, const GridCells* cells) {
+    if (!grid || !cells) return;
+
+    for (size_t row = 0; row < grid->rows; row++) {
+        size_t base = row * grid->cols;
+        memcpy(grid->back.chars + base, cells->chars + base, grid->cols);
+        memcpy(grid->back.attrs + base, cells->attrs + base, sizeof(GridAttr) * grid->cols);
+        mark_span(grid, row, base, grid->cols);
+    }
+}
+
+void grid_set_cursor(Grid* grid, size_t row, size_t col) {
+    if (!grid) return;
+    grid->target_row = row;
+    grid->target_col = col;
+}
+
+// Decimal digits of a value
+static size_t uint_len(size_t value) {
+    size_t len = 1;
+    while (value >= 10) {
+        value /= 10;
+        len++;
+    }
+    return len;
+}
+
+// Bytes of CSI n final, where a parameter of 1 is left out
+static size_t csi_n_len(size_t n) {
+    return strlen(CSI) + 1 + (n == 1 ? 0 : uint_len(n));
+}
+
+// Append CSI n final (or just its length when out is NULL)
+static size_t csi_n(ScreenBuffer* out, size_t n, const char* final) {
+    if (out) {
+        screen_buffer_append(out, CSI);
+        if (n != 1) screen_buffer_append_uint(out, n);
+        screen_buffer_append(out, final);
+    }
+    return csi_n_len(n);
+}
+
+// Append n copies of a control character (or just count them when out is NULL)
+static size_t repeat_control(ScreenBuffer* out, char ch, size_t n) {
+    if (out) screen_buffer_append_repeat(out, ch, n);
+    return n;
+}
+
+// Cheapest way to change rows keeping the column: LF, CUD/CUU or VPA
+static size_t move_vertical(ScreenBuffer* out, size_t from, size_t to) {
+    if (from == to) return 0;
+
+    size_t absolute = csi_n_len(to + 1);
+    if (to > from) {
+        size_t down = to - from;
+        if (down <= csi_n_len(down) && down <= absolute) return repeat_control(out, '\n', down);
+        if (csi_n_len(down) <= absolute) return csi_n(out, down, "B");
+    } else if (csi_n_len(from - to) <= absolute) {
+        return csi_n(out, from - to, "A");
+    }
+    return csi_n(out, to + 1, "d");
+}
+
+// Cheapest way to change columns on the same row: CR, BS, CUF/CUB or CHA
+static size_t move_horizontal(ScreenBuffer* out, size_t from, size_t to) {
+    if (from == to) return 0;
+    if (to == 0) return repeat_control(out, '\r', 1);
+
+    size_t absolute = csi_n_len(to + 1);
+    if (to > from) {
+        if (csi_n_len(to - from) <= absolute) return csi_n(out, to - from, "C");
+    } else {
+        if (from - to == 1) return repeat_control(out, '\b', 1);
+        if (csi_n_len(from - to) <= absolute) return csi_n(out, from - to, "D");
+    }
+    return csi_n(out, to + 1, "G");
+}
+
+static void move_cursor(Grid* grid, ScreenBuffer* out, size_t row, size_t col) {
+    if (grid->cursor_row == row && grid->cursor_col == col) return;
+
+    // Absolute position, always valid
+    size_t absolute = (row == 0 && col == 0)
+                    ? strlen(TERM_CURSOR_HOME)
+                    : strlen(CSI) + uint_len(row + 1) + 1 + uint_len(col + 1) + 1;
+
+    // Relative moves from a known position are often a byte or two
+    if (grid->cursor_row != SIZE_MAX &&
+        move_vertical(NULL, grid->cursor_row, row) +
+        move_horizontal(NULL, grid->cursor_col, col) < absolute) {
+        move_vertical(out, grid->cursor_row, row);
+        move_horizontal(out, grid->cursor_col, col);
+    } else if (row == 0 && col == 0) {
+        screen_buffer_append(out, TERM_CURSOR_HOME);
+    } else {
+        screen_buffer_append(out, CSI);
+        screen_buffer_append_uint(out, row + 1);
+        screen_buffer_append(out, ";");
+        screen_buffer_append_uint(out, col + 1);
+        screen_buffer_append(out, "H");
+    }
+    grid->cursor_row = row;
+    grid->cursor_col = col;
+}
+
+// Write the SGR parameters selecting one color field (0 = terminal default)
+static size_t color_params(char* out, unsigned field, unsigned normal, unsigned bright,
+                           unsigned extended, unsigned reset) {
+    if (field == 0) return ui_format_uint(out, reset);
+
+    unsigned color = field - 1;
+    if (color < 8) return ui_format_uint(out, normal + color);
+    if (color < 16) return ui_format_uint(out, bright + color - 8);
+
+    size_t len = ui_format_uint(out, extended);
+    memcpy(out + len, ";5;", 3);
+    len += 3;
+    return len + ui_format_uint(out + len, color);
+}
+
+// Switch the terminal from one attribute state to another with the shortest SGR
+static void emit_attr(ScreenBuffer* out, GridAttr from, GridAttr to) {
+    unsigned fg = to & GRID_COLOR_MASK;
+    unsigned bg = (to >> GRID_COLOR_BITS) & GRID_COLOR_MASK;
+    char reset[64], change[64];
+    size_t reset_len = 0, change_len = 0;
+
+    // Either reset and set every non-default field...
+    if (to != GRID_ATTR_DEFAULT) {
+        reset[reset_len++] = '0';
+        if (fg) {
+            reset[reset_len++] = ';';
+            reset_len += color_params(reset + reset_len, fg, 30, 90, 38, 39);
+        }
+        if (bg) {
+            reset[reset_len++] = ';';
+            reset_len += color_params(reset + reset_len, bg, 40, 100, 48, 49);
+        }
+    }
+
+    // ...or set only the fields that differ
+    if (fg != (from & GRID_COLOR_MASK)) {
+        change_len += color_params(change, fg, 30, 90, 38, 39);
+    }
+    if (bg != ((from >> GRID_COLOR_BITS) & GRID_COLOR_MASK)) {
+        if (change_len) change[change_len++] = ';';
+        change_len += color_params(change + change_len, bg, 40, 100, 48, 49);
+    }
+
+    screen_buffer_append(out, CSI);
+    if (change_len < reset_len) {
+        screen_buffer_append_n(out, change, change_len);
+    } else {
+        screen_buffer_append_n(out, reset, reset_len);
+    }
+    screen_buffer_append(out, "m");
+}
+
+// Write back-grid cells [start, end) of a row, switching attributes as needed
+static void emit_cells(Grid* grid, ScreenBuffer* out, size_t row, size_t start, size_t end, GridAttr* pen) {
+    if (start >= end) return;
+
+    const char* chars = grid->back.chars + row * grid->cols;
+    const GridAttr* attrs = grid->back.attrs + row * grid->cols;
+    int wide = 0; // Bytes the terminal may not draw as one column each
+
+    move_cursor(grid, out, row, start);
+
+    size_t col = start;
+    while (col < end) {
+        if (attrs[col] != *pen) {
+            emit_attr(out, *pen, attrs[col]);
+            *pen = attrs[col];
+        }
+
+        size_t span = col + 1;
+        while (span < end && attrs[span] == *pen) span++;
+
+        for (size_t i = col; i < span; i++) {
+            if ((unsigned char)chars[i] >= 0x80) wide = 1;
+        }
+        screen_buffer_append_n(out, chars + col, span - col);
+        col = span;
+    }
+
+    // A write into the last column leaves the cursor in a pending-wrap state
+    if (wide || end == grid->cols) {
+        grid->cursor_row = SIZE_MAX;
+    } else {
+        grid->cursor_col = end;
+    }
+}
+
+static int cell_changed(const Grid* grid, size_t i) {
+    return grid->front.chars[i] != grid->back.chars[i] ||
+           grid->front.attrs[i] != grid->back.attrs[i];
+}
+
+static void diff_row(Grid* grid, ScreenBuffer* out, size_t row, GridAttr* pen) {
+    size_t cols = grid->cols;
+    size_t base = row * cols;
+
+    if (memcmp(grid->front.chars + base, grid->back.chars + base, cols) == 0 &&
+        memcmp(grid->front.attrs + base, grid->back.attrs + base, sizeof(GridAttr) * cols) == 0) {
+        return;
+    }
+
+    // Blank default-colored tail of the new row, which TERM_CLEAR_LINE can produce
+    size_t tail = cols;
+    while (tail > 0 && grid->back.chars[base + tail - 1] == ' ' &&
+           grid->back.attrs[base + tail - 1] == GRID_ATTR_DEFAULT) {
+        tail--;
+    }
+
+    size_t col = 0;
+    while (col < cols) {
+        if (!cell_changed(grid, base + col)) {
+            col++;
+            continue;
+        }
+
+        // Extend the run over changes separated by short unchanged gaps
+        size_t start = col;
+        size_t end = col + 1;
+        for (size_t c = end; c < cols && c - end < GRID_MERGE_GAP; c++) {
+            if (cell_changed(grid, base + c)) end = c + 1;
+        }
+
+        size_t blank = tail > start ? tail : start;
+        if (end > blank && end - blank > CLEAR_LINE_COST) {
+            // The rest of the row is blank: draw up to it and clear the remainder
+            emit_cells(grid, out, row, start, blank, pen);
+            move_cursor(grid, out, row, blank);
+            if (*pen != GRID_ATTR_DEFAULT) {
+                emit_attr(out, *pen, GRID_ATTR_DEFAULT);
+                *pen = GRID_ATTR_DEFAULT;
+            }
+            screen_buffer_append(out, TERM_CLEAR_LINE);
+            break;
+        }
+
+        emit_cells(grid, out, row, start, end, pen);
+        col = end;
+    }
+
+    memcpy(grid->front.chars + base, grid->back.chars + base, cols);
+    memcpy(grid->front.attrs + base, grid->back.attrs + base, sizeof(GridAttr) * cols);
+}
+
+// Move rows [top, bottom] of a cell grid by delta, blanking the exposed rows
+static void cells_scroll(const Grid* grid, GridCells* cells, size_t top, size_t bottom, long delta) {
+    size_t shift = delta > 0 ? (size_t)delta : (size_t)-delta;
+    size_t kept = (bottom - top + 1 - shift) * grid->cols;
+    size_t upper = top * grid->cols;
+    size_t lower = (top + shift) * grid->cols;
+    size_t src = delta > 0 ? lower : upper;
+    size_t dst = delta > 0 ? upper : lower;
+    size_t exposed = delta > 0 ? upper + kept : upper;
+
+    memmove(cells->chars + dst, cells->chars + src, kept);
+    memmove(cells->attrs + dst, cells->attrs + src, sizeof(GridAttr) * kept);
+    memset(cells->chars + exposed, ' ', shift * grid->cols);
+    fill_attrs(cells->attrs + exposed, shift * grid->cols, GRID_ATTR_DEFAULT);
+}
+
+int grid_scroll(Grid* grid, ScreenBuffer* out, size_t top, size_t bottom, long delta) {
+    if (!grid || grid->invalid || delta == 0) return 0;
+    if (top > bottom || bottom >= grid->rows) return 0;
+
+    size_t shift = delta > 0 ? (size_t)delta : (size_t)-delta;
+    if (shift > bottom - top) return 0;
+
+    if (out) {
+        // Restrict scrolling to the band, shift it, then restore the full screen;
+        // frames start with default attributes so exposed rows come up blank
+        screen_buffer_append(out, CSI);
+        screen_buffer_append_uint(out, top + 1);
+        screen_buffer_append(out, ";");
+        screen_buffer_append_uint(out, bottom + 1);
+        screen_buffer_append(out, "r" CSI);
+        screen_buffer_append_uint(out, shift);
+        screen_buffer_append(out, delta > 0 ? "S" : "T");
+        screen_buffer_append(out, TERM_RESET_SCROLL_REGION);
+
+        // Setting the scroll region homes the cursor
+        grid->cursor_row = 0;
+        grid->cursor_col = 0;
+    }
+
+    cells_scroll(grid, &grid->front, top, bottom, delta);
+    cells_scroll(grid, &grid->back, top, bottom, delta);
+
+    // Row flags travel with their rows; exposed rows need drawing
+    size_t kept = bottom - top + 1 - shift;
+    if (delta > 0) {
+        memmove(grid->dirty + top, grid->dirty + top + shift, kept);
+        memset(grid->dirty + top + kept, 1, shift);
+    } else {
+        memmove(grid->dirty + top + shift, grid->dirty + top, kept);
+        memset(grid->dirty + top, 1, shift);
+    }
+    return 1;
+}
+
+void grid_diff(Grid* grid, ScreenBuffer* out) {
+    if (!grid || !out) return;
+
+    GridAttr pen = GRID_ATTR_DEFAULT; // Frames start and end with default attributes
+
+    if (grid->invalid) {
+        // Start from a known blank screen; only non-blank cells get drawn
+        screen_buffer_append(out, COLOR_RESET);
+        screen_buffer_append(out, TERM_CURSOR_HOME);
+        screen_buffer_append(out, TERM_CLEAR_SCREEN);
+        cells_blank(&grid->front, grid->rows * grid->cols);
+        grid->cursor_row = 0;
+        grid->cursor_col = 0;
+        grid->invalid = 0;
+    }
+
+    for (size_t row = 0; row < grid->rows; row++) {
+        if (!grid->dirty[row]) continue;
+        diff_row(grid, out, row, &pen);
+        grid->dirty[row] = 0;
+    }
+
+    if (pen != GRID_ATTR_DEFAULT) {
+        emit_attr(out, pen, GRID_ATTR_DEFAULT);
+    }
+
+    if (grid->rows && grid->cols) {
+        size_t row = grid->target_row < grid->rows ? grid->target_row : grid->rows - 1;
+        size_t col = grid->target_col < grid->cols ? grid->target_col : grid->cols - 1;
+        move_cursor(grid, out, row, col);
+    }
+}
@@ -0,0 +1,209 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include "render.h"
+#include "ui.h"
+
+// One frame snapshot handed from the editor thread to the render thread
+typedef struct {
+    size_t rows;           // Frame height
+    size_t cols;           // Frame width
+    GridCells cells;       // Cells of the frame, row-major
+    size_t capacity;       // Cells allocated
+    size_t cursor_row;     // Where the cursor is left
+    size_t cursor_col;
+    size_t scroll_top;     // Band that scrolled since the frame on screen
+    size_t scroll_bottom;
+    long scroll;           // Rows the band moved up (negative: down)
+    int repaint;           // Terminal contents unknown: redraw everything
+    LatencyFrame trace;    // Latency timestamps, including those of replaced frames
+} RenderFrame;
+
+// Render thread and the two frame slots: the editor fills pending, the
+// thread draws the other; the lock is held only to copy in or swap
+static pthread_t render_thread;
+static int render_threaded = 0;
+static pthread_mutex_t render_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t render_wakeup = PTHREAD_COND_INITIALIZER;
+static RenderFrame frames[2];
+static RenderFrame* pending = &frames[0];
+static RenderFrame* drawing = &frames[1];
+static int frame_waiting = 0;
+static int render_stop = 0;
+
+// What the terminal shows and the buffer frames are written through (render thread only)
+static Grid* screen_grid = NULL;
+static ScreenBuffer* screen_out = NULL;
+
+/**
+ * Make room for a frame's cells in a slot
+ * @return 1 on success, 0 on allocation failure
+ */
+static int frame_reserve(RenderFrame* frame, size_t count) {
+    if (count <= frame->capacity) return 1;
+
+    char* chars = realloc(frame->cells.chars, count);
+    if (!chars) return 0;
+    frame->cells.chars = chars;
+    GridAttr* attrs = realloc(frame->cells.attrs, sizeof(GridAttr) * count);
+    if (!attrs) return 0;
+    frame->cells.attrs = attrs;
+    frame->capacity = count;
+    return 1;
+}
+
+static void frame_free(RenderFrame* frame) {
+    free(frame->cells.chars);
+    free(frame->cells.attrs);
+    memset(frame, 0, sizeof(*frame));
+}
+
+/**
+ * Write one frame to the terminal, sending only what differs from the last one
+ */
+static void render_draw(const RenderFrame* frame) {
+    if (!grid_resize(screen_grid, frame->rows, frame->cols)) return;
+    screen_buffer_reserve(screen_out, ui_frame_capacity(frame->rows, frame->cols));
+
+    if (frame->repaint) grid_invalidate(screen_grid);
+    if (frame->scroll != 0) {
+        grid_scroll(screen_grid, screen_out, frame->scroll_top, frame->scroll_bottom, frame->scroll);
+    }
+    grid_load(screen_grid, &frame->cells);
+    grid_set_cursor(screen_grid, frame->cursor_row, frame->cursor_col);
+
+    grid_diff(screen_grid, screen_out);
+    screen_buffer_flush(screen_out);
+    latency_frame_written(&frame->trace);
+}
+
+/**
+ * Render thread: draw the latest frame whenever one is waiting
+ */
+static void* render_thread_main(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&render_lock);
+    while (1) {
+        while (!frame_waiting && !render_stop) {
+            pthread_cond_wait(&render_wakeup, &render_lock);
+        }
+        if (render_stop) break;
+
+        // Take the frame; the editor can fill the other slot meanwhile
+        RenderFrame* frame = pending;
+        pending = drawing;
+        drawing = frame;
+        frame_waiting = 0;
+
+        pthread_mutex_unlock(&render_lock);
+        render_draw(frame);
+        pthread_mutex_lock(&render_lock);
+    }
+    pthread_mutex_unlock(&render_lock);
+    return NULL;
+}
+
+int render_start_thread(void) {
+    if (render_threaded) return 1;
+
+    // Sized by the first frame
+    screen_grid = grid_create(0, 0);
+    screen_out = screen_buffer_create(ui_frame_capacity(0, 0));
+    if (!screen_grid || !screen_out) {
+        grid_free(screen_grid);
+        screen_buffer_free(screen_out);
+        screen_grid = NULL;
+        screen_out = NULL;
+        return 0;
+    }
+    frame_waiting = 0;
+    render_stop = 0;
+
+    // Signals such as SIGWINCH stay with the threads that handle them
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    int started = pthread_create(&render_thread, NULL, render_thread_main, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (!started) {
+        grid_free(screen_grid);
+        screen_buffer_free(screen_out);
+        screen_grid = NULL;
+        screen_out = NULL;
+        return 0;
+    }
+    render_threaded = 1;
+    return 1;
+}
+
+void render_stop_thread(void) {
+    if (!render_threaded) return;
+
+    pthread_mutex_lock(&render_lock);
+    render_stop = 1;
+    pthread_cond_signal(&render_wakeup);
+    pthread_mutex_unlock(&render_lock);
+    pthread_join(render_thread, NULL);
+
+    frame_free(&frames[0]);
+    frame_free(&frames[1]);
+    frame_waiting = 0;
+    grid_free(screen_grid);
+    screen_buffer_free(screen_out);
+    screen_grid = NULL;
+    screen_out = NULL;
+    render_threaded = 0;
+}
+
+int render_thread_running(void) {
+    return render_threaded;
+}
+
+int render_submit_frame(Grid* grid, size_t top, size_t bottom, long scroll, const LatencyFrame* trace) {
+    if (!grid || !render_threaded) return 0;
+
+    size_t count = grid->rows * grid->cols;
+    pthread_mutex_lock(&render_lock);
+    RenderFrame* frame = pending;
+    if (!frame_reserve(frame, count)) {
+        pthread_mutex_unlock(&render_lock);
+        return 0;
+    }
+
+    // A frame nobody took yet is replaced; its scroll and repaint still
+    // have to happen, since the terminal never saw them
+    if (frame_waiting && frame->rows == grid->rows && frame->cols == grid->cols &&
+        frame->scroll_top == top && frame->scroll_bottom == bottom) {
+        frame->scroll += scroll;
+    } else {
+        frame->scroll = scroll;
+    }
+    frame->repaint = (frame_waiting && frame->repaint) || grid->invalid;
+    grid->invalid = 0;
+
+    // The input a replaced frame showed first appears in this one
+    LatencyFrame replaced = frame->trace;
+    if (trace) {
+        frame->trace = *trace;
+    } else {
+        memset(&frame->trace, 0, sizeof(frame->trace));
+    }
+    if (frame_waiting) latency_frame_merge(&frame->trace, &replaced);
+
+    frame->rows = grid->rows;
+    frame->cols = grid->cols;
+    frame->scroll_top = top;
+    frame->scroll_bottom = bottom;
+    frame->cursor_row = grid->target_row;
+    frame->cursor_col = grid->target_col;
+    memcpy(frame->cells.chars, grid->back.chars, count);
+    memcpy(frame->cells.attrs, grid->back.attrs, sizeof(GridAttr) * count);
+
+    frame_waiting = 1;
+    pthread_cond_signal(&render_wakeup);
+    pthread_mutex_unlock(&render_lock);
+    return 1;
+}
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rowcache.h"
+
+static int key_equal(const RowKey* a, const RowKey* b) {
+    return a->line == b->line &&
+           a->scroll_x == b->scroll_x &&
+           a->width == b->width &&
+           a->flags == b->flags &&
+           a->syntax == b->syntax;
+}
+
+RowCache* row_cache_create(size_t rows) {
+    RowCache* cache = malloc(sizeof(RowCache));
+    if (!cache) return NULL;
+
+    cache->keys = NULL;
+    cache->next = NULL;
+    cache->rows = 0;
+    if (!row_cache_resize(cache, rows)) {
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void row_cache_free(RowCache* cache) {
+    if (!cache) return;
+    free(cache->keys);
+    free(cache->next);
+    free(cache);
+}
+
+int row_cache_resize(RowCache* cache, size_t rows) {
+    if (!cache) return 0;
+    if (cache->keys && rows == cache->rows) return 1;
+
+    RowKey* keys = malloc(sizeof(RowKey) * (rows ? rows : 1));
+    RowKey* next = malloc(sizeof(RowKey) * (rows ? rows : 1));
+    if (!keys || !next) {
+        free(keys);
+        free(next);
+        return 0;
+    }
+
+    free(cache->keys);
+    free(cache->next);
+    cache->keys = keys;
+    cache->next = next;
+    cache->rows = rows;
+    row_cache_invalidate(cache);
+    return 1;
+}
+
+void row_cache_invalidate(RowCache* cache) {
+    if (!cache) return;
+    for (size_t i = 0; i < cache->rows; i++) {
+        cache->keys[i].valid = 0;
+    }
+}
+
+void row_cache_invalidate_lines(RowCache* cache, size_t from, size_t to) {
+    if (!cache) return;
+    for (size_t i = 0; i < cache->rows; i++) {
+        size_t line = cache->keys[i].line;
+        if (line != ROW_EMPTY && line >= from && line <= to) {
+            cache->keys[i].valid = 0;
+        }
+    }
+}
+
+int row_cache_check(RowCache* cache, size_t row, const RowKey* key) {
+    if (!cache || row >= cache->rows) return 0;
+
+    RowKey* cached = &cache->keys[row];
+    if (cached->valid && key_equal(cached, key)) return 1;
+
+    *cached = *key;
+    cached->valid = 1;
+    return 0;
+}
+
+void row_cache_scroll(RowCache* cache, long delta) {
+    if (!cache || delta == 0) return;
+
+    size_t shift = delta > 0 ? (size_t)delta : (size_t)-delta;
+    if (shift >= cache->rows) {
+        row_cache_invalidate(cache);
+        return;
+    }
+
+    size_t kept = cache->rows - shift;
+    if (delta > 0) {
+        memmove(cache->keys, cache->keys + shift, sizeof(RowKey) * kept);
+        for (size_t i = kept; i < cache->rows; i++) cache->keys[i].valid = 0;
+    } else {
+        memmove(cache->keys + shift, cache->keys, sizeof(RowKey) * kept);
+        for (size_t i = 0; i < shift; i++) cache->keys[i].valid = 0;
+    }
+}
+
+// Rows of next that match the cached row delta rows further down
+static size_t count_matches(const RowCache* cache, long delta) {
+    size_t matches = 0;
+    for (size_t i = 0; i < cache->rows; i++) {
+        long old = (long)i + delta;
+        if (old < 0 || old >= (long)cache->rows) continue;
+
+        const RowKey* cached = &cache->keys[old];
+        if (cached->valid && cached->line != ROW_EMPTY && key_equal(cached, &cache->next[i])) {
+            matches++;
+        }
+    }
+    return matches;
+}
+
+long row_cache_find_shift(const RowCache* cache) {
+    if (!cache || cache->rows < 2) return 0;
+
+    // Line now on top was lower down, or the old top line is now lower down
+    long delta = 0;
+    for (size_t i = 1; i < cache->rows && delta == 0; i++) {
+        if (cache->keys[i].valid && cache->keys[i].line == cache->next[0].line &&
+            cache->next[0].line != ROW_EMPTY) {
+            delta = (long)i;
+        } else if (cache->keys[0].valid && cache->next[i].line == cache->keys[0].line &&
+                   cache->keys[0].line != ROW_EMPTY) {
+            delta = -(long)i;
+        }
+    }
+    if (delta == 0) return 0;
+
+    // Scrolling only pays off if most rows can be kept
+    if (count_matches(cache, delta) * 2 < cache->rows) return 0;
+    return delta;
+}
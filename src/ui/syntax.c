@@ -0,0 +1,815 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "syntax.h"
+
+// Lexer states carried across lines
+enum {
+    STATE_NORMAL = SYNTAX_STATE_NORMAL,
+    STATE_BLOCK_COMMENT,   // Inside /* ... */
+    STATE_DOUBLE_QUOTE,    // Inside "..." continued from the previous line
+    STATE_SINGLE_QUOTE,    // Inside '...' continued from the previous line
+    STATE_TRIPLE_DOUBLE,   // Inside """..."""
+    STATE_TRIPLE_SINGLE    // Inside '''...'''
+};
+
+// Language tables; keyword lists must stay sorted for the binary search
+
+static const char* const c_extensions[] = { ".c", ".h", NULL };
+static const char* const c_interpreters[] = { NULL };
+static const char* const c_keywords[] = {
+    "NULL", "_Alignas", "_Alignof", "_Atomic", "_Generic", "_Noreturn",
+    "_Static_assert", "_Thread_local", "auto", "break", "case", "const",
+    "continue", "default", "do", "else", "enum", "extern", "false", "for",
+    "goto", "if", "inline", "register", "restrict", "return", "sizeof",
+    "static", "struct", "switch", "true", "typedef", "union", "volatile",
+    "while", NULL
+};
+static const char* const c_types[] = {
+    "FILE", "_Bool", "_Complex", "bool", "char", "double", "float", "int",
+    "int16_t", "int32_t", "int64_t", "int8_t", "intptr_t", "long", "off_t",
+    "pid_t", "ptrdiff_t", "short", "signed", "size_t", "ssize_t", "uint16_t",
+    "uint32_t", "uint64_t", "uint8_t", "uintptr_t", "unsigned", "void", NULL
+};
+
+static const char* const python_extensions[] = { ".py", ".pyw", NULL };
+static const char* const python_interpreters[] = { "python", NULL };
+static const char* const python_keywords[] = {
+    "False", "None", "True", "and", "as", "assert", "async", "await", "break",
+    "class", "continue", "def", "del", "elif", "else", "except", "finally",
+    "for", "from", "global", "if", "import", "in", "is", "lambda", "nonlocal",
+    "not", "or", "pass", "raise", "return", "try", "while", "with", "yield",
+    NULL
+};
+static const char* const python_types[] = {
+    "bool", "bytearray", "bytes", "complex", "dict", "float", "frozenset",
+    "int", "list", "object", "set", "str", "tuple", "type", NULL
+};
+
+static const char* const shell_extensions[] = { ".sh", ".bash", ".bashrc", ".profile", NULL };
+static const char* const shell_interpreters[] = { "sh", "bash", "dash", "ksh", "zsh", NULL };
+static const char* const shell_keywords[] = {
+    "case", "do", "done", "elif", "else", "esac", "fi", "for", "function",
+    "if", "in", "select", "then", "time", "until", "while", NULL
+};
+static const char* const shell_types[] = {
+    "alias", "break", "cd", "continue", "declare", "echo", "eval", "exec",
+    "exit", "export", "local", "printf", "read", "readonly", "return", "set",
+    "shift", "source", "test", "trap", "unset", NULL
+};
+
+static const SyntaxLanguage languages[] = {
+    {
+        "C", c_extensions, c_interpreters,
+        "//", "/*", "*/", "",
+        c_keywords, c_types,
+        SYNTAX_PREPROCESSOR | SYNTAX_ESCAPED_NEWLINE
+    },
+    {
+        "Python", python_extensions, python_interpreters,
+        "#", NULL, NULL, "",
+        python_keywords, python_types,
+        SYNTAX_TRIPLE_QUOTES | SYNTAX_ESCAPED_NEWLINE
+    },
+    {
+        "Shell", shell_extensions, shell_interpreters,
+        "#", NULL, NULL, "-./",
+        shell_keywords, shell_types,
+        SYNTAX_MULTILINE_STRINGS | SYNTAX_RAW_SINGLE_QUOTES |
+        SYNTAX_VARIABLES | SYNTAX_WORD_COMMENTS
+    }
+};
+
+#define LANGUAGE_COUNT (sizeof(languages) / sizeof(languages[0]))
+
+// Initial sizes of the per-line arrays and the class scratch
+#define SYNTAX_MIN_CAPACITY 64
+
+// Where lexed classes go: only bytes from..from+count are kept
+typedef struct {
+    unsigned char* classes;
+    size_t from;
+    size_t count;
+} Marks;
+
+static void mark(Marks* marks, size_t start, size_t end, SyntaxClass cls) {
+    if (!marks || !marks->classes) return;
+
+    size_t lo = start > marks->from ? start : marks->from;
+    size_t hi = end < marks->from + marks->count ? end : marks->from + marks->count;
+    if (lo < hi) memset(marks->classes + (lo - marks->from), cls, hi - lo);
+}
+
+static int is_word_start(const SyntaxLanguage* language, unsigned char ch) {
+    (void)language;
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || ch >= 0x80;
+}
+
+static int is_word_char(const SyntaxLanguage* language, unsigned char ch) {
+    return is_word_start(language, ch) || (ch >= '0' && ch <= '9') ||
+           (ch != '\0' && strchr(language->word_chars, ch) != NULL);
+}
+
+static int is_space(unsigned char ch) {
+    return ch == ' ' || ch == '\t';
+}
+
+static int starts_with(const char* text, size_t len, size_t pos, const char* prefix) {
+    size_t n = strlen(prefix);
+    return n <= len - pos && memcmp(text + pos, prefix, n) == 0;
+}
+
+// Binary search a sorted, NULL-terminated word list
+static int find_word(const char* const* words, const char* word, size_t len) {
+    size_t lo = 0, hi = 0;
+    while (words[hi]) hi++;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strncmp(word, words[mid], len);
+        if (cmp == 0) cmp = words[mid][len] == '\0' ? 0 : -1;
+        if (cmp == 0) return 1;
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return 0;
+}
+
+// Scan the body of a string opened in string_state, starting at pos
+// Returns the offset after the closing quote (or len) and sets *state to
+// string_state if the string is still open at the end of the line
+static size_t scan_string(const SyntaxLanguage* language, const char* text, size_t len,
+                          size_t pos, SyntaxState string_state, SyntaxState* state) {
+    int triple = string_state == STATE_TRIPLE_DOUBLE || string_state == STATE_TRIPLE_SINGLE;
+    char quote = (string_state == STATE_DOUBLE_QUOTE || string_state == STATE_TRIPLE_DOUBLE) ? '"' : '\'';
+    int escapes = !(quote == '\'' && (language->flags & SYNTAX_RAW_SINGLE_QUOTES));
+    int multiline = triple || (language->flags & SYNTAX_MULTILINE_STRINGS);
+
+    *state = STATE_NORMAL;
+    while (pos < len) {
+        char ch = text[pos];
+        if (ch == '\\' && escapes) {
+            if (pos + 1 == len) {
+                // Escaped newline
+                if (multiline || (language->flags & SYNTAX_ESCAPED_NEWLINE)) *state = string_state;
+                return len;
+            }
+            pos += 2;
+            continue;
+        }
+        if (ch == quote) {
+            if (!triple) return pos + 1;
+            if (pos + 2 < len && text[pos + 1] == quote && text[pos + 2] == quote) return pos + 3;
+        }
+        pos++;
+    }
+
+    if (multiline) *state = string_state;
+    return len;
+}
+
+// Scan the body of a block comment starting at pos
+// Returns the offset after the closing delimiter (or len) and sets *open
+static size_t scan_block_comment(const SyntaxLanguage* language, const char* text, size_t len,
+                                 size_t pos, int* open) {
+    for (; pos < len; pos++) {
+        if (starts_with(text, len, pos, language->block_comment_end)) {
+            *open = 0;
+            return pos + strlen(language->block_comment_end);
+        }
+    }
+    *open = 1;
+    return len;
+}
+
+// Shell variable at pos ('$' already checked); returns its end
+static size_t scan_variable(const SyntaxLanguage* language, const char* text, size_t len, size_t pos) {
+    pos++;
+    if (pos == len) return pos;
+
+    unsigned char ch = (unsigned char)text[pos];
+    if (ch == '{') {
+        const char* close = memchr(text + pos, '}', len - pos);
+        return close ? (size_t)(close - text) + 1 : len;
+    }
+    if (is_word_start(language, ch)) {
+        while (pos < len && (is_word_start(language, (unsigned char)text[pos]) ||
+                             (text[pos] >= '0' && text[pos] <= '9'))) {
+            pos++;
+        }
+        return pos;
+    }
+    if (strchr("0123456789@*#?$!-", ch) != NULL) return pos + 1;
+    return pos;
+}
+
+// C preprocessor directive at pos ('#' already checked); returns where lexing resumes
+static size_t scan_directive(const SyntaxLanguage* language, const char* text, size_t len,
+                             size_t pos, Marks* marks) {
+    size_t start = pos++;
+    while (pos < len && is_space((unsigned char)text[pos])) pos++;
+    size_t name = pos;
+    while (pos < len && is_word_char(language, (unsigned char)text[pos])) pos++;
+    mark(marks, start, pos, SYNTAX_PREPROC);
+
+    // #include <header> reads as a string
+    if (pos - name == 7 && memcmp(text + name, "include", 7) == 0) {
+        size_t open = pos;
+        while (open < len && is_space((unsigned char)text[open])) open++;
+        if (open < len && text[open] == '<') {
+            const char* close = memchr(text + open, '>', len - open);
+            size_t end = close ? (size_t)(close - text) + 1 : len;
+            mark(marks, open, end, SYNTAX_STRING);
+            return end;
+        }
+    }
+    return pos;
+}
+
+// Lex one line from state, reporting classes into marks; returns the end state
+static SyntaxState lex_line(const SyntaxLanguage* language, SyntaxState state,
+                            const char* text, size_t len, Marks* marks) {
+    size_t pos = 0;
+
+    // Finish whatever the previous line left open
+    if (state == STATE_BLOCK_COMMENT) {
+        int open;
+        pos = scan_block_comment(language, text, len, 0, &open);
+        mark(marks, 0, pos, SYNTAX_COMMENT);
+        if (open) return STATE_BLOCK_COMMENT;
+    } else if (state != STATE_NORMAL) {
+        pos = scan_string(language, text, len, 0, state, &state);
+        mark(marks, 0, pos, SYNTAX_STRING);
+        if (state != STATE_NORMAL) return state;
+    }
+
+    int line_start = 1; // Only whitespace so far
+    while (pos < len) {
+        size_t start = pos;
+        unsigned char ch = (unsigned char)text[pos];
+
+        if (language->block_comment_start &&
+            starts_with(text, len, pos, language->block_comment_start)) {
+            int open;
+            pos = scan_block_comment(language, text, len,
+                                     pos + strlen(language->block_comment_start), &open);
+            mark(marks, start, pos, SYNTAX_COMMENT);
+            if (open) return STATE_BLOCK_COMMENT;
+        } else if (language->line_comment &&
+                   starts_with(text, len, pos, language->line_comment) &&
+                   (!(language->flags & SYNTAX_WORD_COMMENTS) || pos == 0 ||
+                    is_space((unsigned char)text[pos - 1]) || text[pos - 1] == ';')) {
+            mark(marks, start, len, SYNTAX_COMMENT);
+            return STATE_NORMAL;
+        } else if (ch == '"' || ch == '\'') {
+            SyntaxState string_state = ch == '"' ? STATE_DOUBLE_QUOTE : STATE_SINGLE_QUOTE;
+            pos++;
+            if ((language->flags & SYNTAX_TRIPLE_QUOTES) && pos + 1 < len &&
+                text[pos] == (char)ch && text[pos + 1] == (char)ch) {
+                string_state = ch == '"' ? STATE_TRIPLE_DOUBLE : STATE_TRIPLE_SINGLE;
+                pos += 2;
+            }
+            pos = scan_string(language, text, len, pos, string_state, &state);
+            mark(marks, start, pos, SYNTAX_STRING);
+            if (state != STATE_NORMAL) return state;
+        } else if (ch == '#' && line_start && (language->flags & SYNTAX_PREPROCESSOR)) {
+            pos = scan_directive(language, text, len, pos, marks);
+        } else if (ch == '$' && (language->flags & SYNTAX_VARIABLES)) {
+            pos = scan_variable(language, text, len, pos);
+            mark(marks, start, pos, SYNTAX_VARIABLE);
+        } else if (ch >= '0' && ch <= '9') {
+            while (pos < len && (is_word_char(language, (unsigned char)text[pos]) || text[pos] == '.')) {
+                pos++;
+            }
+            mark(marks, start, pos, SYNTAX_NUMBER);
+        } else if (is_word_start(language, ch)) {
+            while (pos < len && is_word_char(language, (unsigned char)text[pos])) pos++;
+            if (find_word(language->keywords, text + start, pos - start)) {
+                mark(marks, start, pos, SYNTAX_KEYWORD);
+            } else if (find_word(language->types, text + start, pos - start)) {
+                mark(marks, start, pos, SYNTAX_TYPE);
+            }
+        } else {
+            pos++;
+        }
+
+        if (!is_space(ch)) line_start = 0;
+    }
+
+    return STATE_NORMAL;
+}
+
+// Line text without a trailing carriage return (CRLF files)
+static size_t line_text(const char* content, const LineIndex* index, size_t line, const char** text) {
+    size_t start = line_index_start(index, line);
+    size_t len = line_index_end(index, line) - start;
+    *text = content + start;
+    if (len > 0 && (*text)[len - 1] == '\r') len--;
+    return len;
+}
+
+// Does the name end with suffix?
+static int ends_with(const char* name, const char* suffix) {
+    size_t name_len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return name_len >= suffix_len && strcmp(name + name_len - suffix_len, suffix) == 0;
+}
+
+// Name of the program on a #! line, skipping /usr/bin/env
+static size_t shebang_program(const char* content, const char** program) {
+    const char* line_end = strchr(content, '\n');
+    size_t len = line_end ? (size_t)(line_end - content) : strlen(content);
+    size_t pos = 2;
+
+    while (pos < len) {
+        while (pos < len && is_space((unsigned char)content[pos])) pos++;
+        size_t word = pos;
+        while (pos < len && !is_space((unsigned char)content[pos]) && content[pos] != '\r') pos++;
+
+        const char* slash = word < pos ? memchr(content + word, '/', pos - word) : NULL;
+        while (slash) {
+            word = (size_t)(slash - content) + 1;
+            slash = memchr(content + word, '/', pos - word);
+        }
+        if (pos - word == 3 && memcmp(content + word, "env", 3) == 0) continue;
+
+        *program = content + word;
+        return pos - word;
+    }
+    return 0;
+}
+
+const SyntaxLanguage* syntax_detect(const char* filename, const char* content) {
+    if (filename) {
+        for (size_t i = 0; i < LANGUAGE_COUNT; i++) {
+            for (const char* const* ext = languages[i].extensions; *ext; ext++) {
+                if (ends_with(filename, *ext)) return &languages[i];
+            }
+        }
+    }
+
+    if (content && content[0] == '#' && content[1] == '!') {
+        const char* program;
+        size_t len = shebang_program(content, &program);
+        for (size_t i = 0; i < LANGUAGE_COUNT && len > 0; i++) {
+            for (const char* const* name = languages[i].interpreters; *name; name++) {
+                // Version suffixes such as python3 still match
+                size_t name_len = strlen(*name);
+                if (name_len <= len && memcmp(program, *name, name_len) == 0 &&
+                    strspn(program + name_len, "0123456789.") >= len - name_len) {
+                    return &languages[i];
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Grow a byte array to hold at least count entries
+static int grow(unsigned char** array, size_t* capacity, size_t count) {
+    if (count <= *capacity) return 1;
+
+    size_t size = *capacity ? *capacity : SYNTAX_MIN_CAPACITY;
+    while (size < count) size *= 2;
+
+    unsigned char* grown = realloc(*array, size);
+    if (!grown) return 0;
+    *array = grown;
+    *capacity = size;
+    return 1;
+}
+
+// Make room for lines entries in the per-line arrays
+static int ensure_capacity(Syntax* syntax, size_t lines) {
+    if (lines <= syntax->capacity) return 1;
+
+    size_t capacity = syntax->capacity;
+    if (!grow(&syntax->states, &capacity, lines)) return 0;
+    capacity = syntax->capacity;
+    if (!grow(&syntax->dirty, &capacity, lines)) return 0;
+
+    syntax->capacity = capacity;
+    return 1;
+}
+
+// A run of lines with cached end states and flags
+typedef struct {
+    const SyntaxLanguage* language;
+    const char* content;
+    const LineIndex* index;
+    SyntaxState* states;     // End state per line, from first on
+    unsigned char* dirty;    // Flags per line, from first on
+    size_t first;            // Line the arrays start at
+    size_t lines;            // Lines in the buffer
+    SyntaxState start;       // State carried into first
+} LexRange;
+
+// Re-lex flagged lines from line through last; returns the line it stopped at
+static size_t relex(LexRange* range, size_t line, size_t last, size_t* lexed) {
+    while (line <= last) {
+        size_t i = line - range->first;
+        SyntaxState before = i == 0 ? range->start : range->states[i - 1];
+        const char* text;
+        size_t len = line_text(range->content, range->index, line, &text);
+        SyntaxState end = lex_line(range->language, before, text, len, NULL);
+        (*lexed)++;
+
+        // The next line was lexed from the old state; flag it if that changed
+        if (end != range->states[i] && line + 1 < range->lines) {
+            range->dirty[i + 1] = 1;
+        }
+        range->states[i] = end;
+        range->dirty[i] = 0;
+
+        // Lines that are not flagged were lexed from the state their
+        // predecessor still ends in, so skip straight to the next flagged one
+        const unsigned char* next = line < last ? memchr(range->dirty + i + 1, 1, last - line) : NULL;
+        line = next ? range->first + (size_t)(next - range->dirty) : last + 1;
+    }
+    return line;
+}
+
+static void* worker_main(void* arg) {
+    SyntaxWorker* worker = arg;
+
+    pthread_mutex_lock(&worker->lock);
+    while (!worker->shutdown) {
+        if (!worker->pending) {
+            pthread_cond_wait(&worker->wake, &worker->lock);
+            continue;
+        }
+
+        LexRange range = {
+            worker->language, worker->content, worker->index, worker->states,
+            worker->dirty, worker->first, worker->lines, worker->start
+        };
+        size_t line = worker->first;
+
+        // Lex a chunk at a time, publishing after each one
+        while (!worker->cancel && line < range.lines) {
+            pthread_mutex_unlock(&worker->lock);
+            size_t last = range.lines - line > SYNTAX_CHUNK_LINES ? line + SYNTAX_CHUNK_LINES - 1
+                                                                  : range.lines - 1;
+            size_t lexed = 0;
+            line = relex(&range, line, last, &lexed);
+            pthread_mutex_lock(&worker->lock);
+
+            worker->published = line - range.first;
+            worker->lexed += lexed;
+
+            // Tell the owner as soon as its guessed lines can be drawn for real
+            if (!worker->cancel && line >= worker->notify_line) {
+                worker->notify_line = SIZE_MAX;
+                if (worker->notify) worker->notify();
+            }
+        }
+
+        worker->pending = 0;
+        pthread_cond_broadcast(&worker->idle);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+static SyntaxWorker* worker_create(void) {
+    SyntaxWorker* worker = malloc(sizeof(SyntaxWorker));
+    if (!worker) return NULL;
+
+    worker->shutdown = 0;
+    worker->pending = 0;
+    worker->cancel = 0;
+    worker->states = NULL;
+    worker->dirty = NULL;
+    worker->capacity = 0;
+    worker->published = 0;
+    worker->lexed = 0;
+    worker->notify = NULL;
+    worker->notify_line = SIZE_MAX;
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+    pthread_cond_init(&worker->idle, NULL);
+
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+        pthread_mutex_destroy(&worker->lock);
+        pthread_cond_destroy(&worker->wake);
+        pthread_cond_destroy(&worker->idle);
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+static void worker_free(SyntaxWorker* worker) {
+    if (!worker) return;
+
+    pthread_mutex_lock(&worker->lock);
+    worker->shutdown = 1;
+    worker->cancel = 1;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->thread, NULL);
+
+    pthread_mutex_destroy(&worker->lock);
+    pthread_cond_destroy(&worker->wake);
+    pthread_cond_destroy(&worker->idle);
+    free(worker->states);
+    free(worker->dirty);
+    free(worker);
+}
+
+// Copy the states the worker has published into the cache
+static void collect(Syntax* syntax) {
+    SyntaxWorker* worker = syntax->worker;
+    if (!worker || !syntax->job_active) return;
+
+    pthread_mutex_lock(&worker->lock);
+    size_t published = worker->published;
+    int pending = worker->pending;
+    syntax->lexed += worker->lexed;
+    worker->lexed = 0;
+    pthread_mutex_unlock(&worker->lock);
+
+    if (published > syntax->collected) {
+        size_t from = worker->first + syntax->collected;
+        size_t count = published - syntax->collected;
+        memcpy(syntax->states + from, worker->states + syntax->collected, count);
+        memset(syntax->dirty + from, 0, count);
+        syntax->collected = published;
+
+        // The worker may have changed the state the next line starts from
+        size_t reached = worker->first + published;
+        if (reached > syntax->stale_from) {
+            syntax->stale_from = reached;
+            if (reached < syntax->lines) syntax->dirty[reached] = 1;
+        }
+    }
+
+    if (!pending) syntax->job_active = 0;
+}
+
+// Hand the lines from stale_from on to the worker
+static void post_job(Syntax* syntax, const char* content, const LineIndex* index) {
+    SyntaxWorker* worker = syntax->worker;
+    size_t first = syntax->stale_from;
+    size_t count = syntax->lines - first;
+
+    // The worker is idle here, so its arrays can be refilled without locking
+    size_t capacity = worker->capacity;
+    if (!grow(&worker->states, &capacity, count)) return;
+    capacity = worker->capacity;
+    if (!grow(&worker->dirty, &capacity, count)) return;
+    worker->capacity = capacity;
+    memcpy(worker->states, syntax->states + first, count);
+    memcpy(worker->dirty, syntax->dirty + first, count);
+
+    pthread_mutex_lock(&worker->lock);
+    worker->language = syntax->language;
+    worker->content = content;
+    worker->index = index;
+    worker->first = first;
+    worker->lines = syntax->lines;
+    worker->start = syntax_state_before(syntax, first);
+    worker->published = 0;
+    worker->notify_line = SIZE_MAX;
+    worker->cancel = 0;
+    worker->pending = 1;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+
+    syntax->job_active = 1;
+    syntax->collected = 0;
+}
+
+// Lex the lines on screen from a guessed state; nothing is cached
+static void guess_window(Syntax* syntax, const char* content, const LineIndex* index,
+                         size_t first, size_t last) {
+    size_t count = last - first + 1;
+    if (!grow(&syntax->provisional, &syntax->provisional_capacity, count)) return;
+
+    // Most lines start outside comments and strings
+    SyntaxState state = SYNTAX_STATE_NORMAL;
+    for (size_t line = first; line <= last; line++) {
+        const char* text;
+        size_t len = line_text(content, index, line, &text);
+        state = lex_line(syntax->language, state, text, len, NULL);
+        syntax->provisional[line - first] = state;
+    }
+    syntax->provisional_first = first;
+    syntax->provisional_count = count;
+}
+
+// Ask the worker to call notify once the guessed lines can be lexed for real
+static void watch_window(Syntax* syntax) {
+    SyntaxWorker* worker = syntax->worker;
+    if (!worker || !syntax->job_active || !syntax->provisional_count) return;
+
+    // Matches syntax_poll: within SYNTAX_SYNC_LINES of the last guessed line
+    size_t last = syntax->provisional_first + syntax->provisional_count - 1;
+    size_t target = last + 1 > SYNTAX_SYNC_LINES ? last + 1 - SYNTAX_SYNC_LINES : 0;
+
+    pthread_mutex_lock(&worker->lock);
+    int ready = !worker->pending || worker->first + worker->published >= target;
+    worker->notify_line = ready ? SIZE_MAX : target;
+    SyntaxNotify notify = worker->notify;
+    pthread_mutex_unlock(&worker->lock);
+
+    // Already there: the worker won't call, so call now
+    if (ready && notify) notify();
+}
+
+Syntax* syntax_create(const SyntaxLanguage* language, size_t lines) {
+    if (!language) return NULL;
+
+    Syntax* syntax = malloc(sizeof(Syntax));
+    if (!syntax) return NULL;
+
+    syntax->language = language;
+    syntax->states = NULL;
+    syntax->dirty = NULL;
+    syntax->lines = 0;
+    syntax->capacity = 0;
+    syntax->stale_from = 0;
+    syntax->lexed = 0;
+    syntax->classes = NULL;
+    syntax->classes_capacity = 0;
+    syntax->job_active = 0;
+    syntax->collected = 0;
+    syntax->provisional = NULL;
+    syntax->provisional_first = 0;
+    syntax->provisional_count = 0;
+    syntax->provisional_capacity = 0;
+
+    // Without a worker every line is lexed on demand
+    syntax->worker = worker_create();
+    if (!syntax_reset(syntax, lines)) {
+        syntax_free(syntax);
+        return NULL;
+    }
+    return syntax;
+}
+
+void syntax_free(Syntax* syntax) {
+    if (!syntax) return;
+    worker_free(syntax->worker);
+    free(syntax->states);
+    free(syntax->dirty);
+    free(syntax->classes);
+    free(syntax->provisional);
+    free(syntax);
+}
+
+int syntax_reset(Syntax* syntax, size_t lines) {
+    if (!syntax) return 0;
+    syntax_cancel(syntax);
+    syntax->provisional_count = 0;
+    if (!ensure_capacity(syntax, lines)) {
+        syntax->lines = 0;
+        return 0;
+    }
+
+    memset(syntax->states, STATE_NORMAL, lines);
+    memset(syntax->dirty, 1, lines);
+    syntax->lines = lines;
+    syntax->stale_from = 0;
+    return 1;
+}
+
+void syntax_cancel(Syntax* syntax) {
+    if (!syntax || !syntax->worker || !syntax->job_active) return;
+
+    SyntaxWorker* worker = syntax->worker;
+    pthread_mutex_lock(&worker->lock);
+    worker->cancel = 1;
+    while (worker->pending) {
+        pthread_cond_wait(&worker->idle, &worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    // Whatever the worker finished still matches the text
+    collect(syntax);
+}
+
+void syntax_lines_changed(Syntax* syntax, size_t line, long delta) {
+    if (!syntax) return;
+    syntax_cancel(syntax);
+    syntax->provisional_count = 0;
+    if (syntax->lines == 0) return;
+    if (line >= syntax->lines) line = syntax->lines - 1;
+    if (delta > 0) {
+        size_t added = (size_t)delta;
+        if (!ensure_capacity(syntax, syntax->lines + added)) {
+            syntax->lines = 0;
+            return;
+        }
+
+        // New lines hand on the state the edited line used to end in, which
+        // is what the line after them was lexed from
+        size_t tail = syntax->lines - line - 1;
+        memmove(syntax->states + line + 1 + added, syntax->states + line + 1, tail);
+        memmove(syntax->dirty + line + 1 + added, syntax->dirty + line + 1, tail);
+        memset(syntax->states + line + 1, syntax->states[line], added);
+        memset(syntax->dirty + line + 1, 1, added);
+        syntax->lines += added;
+    } else if (delta < 0) {
+        size_t removed = (size_t)(-delta);
+        if (removed > syntax->lines - line - 1) removed = syntax->lines - line - 1;
+
+        // The edited line now ends where the last removed line did
+        syntax->states[line] = syntax->states[line + removed];
+        size_t tail = syntax->lines - line - 1 - removed;
+        memmove(syntax->states + line + 1, syntax->states + line + 1 + removed, tail);
+        memmove(syntax->dirty + line + 1, syntax->dirty + line + 1 + removed, tail);
+        syntax->lines -= removed;
+    }
+
+    syntax->dirty[line] = 1;
+    if (line < syntax->stale_from) syntax->stale_from = line;
+}
+
+void syntax_update(Syntax* syntax, const char* content, const LineIndex* index,
+                   size_t first, size_t last) {
+    if (!syntax || !content || !index || syntax->lines == 0) return;
+    if (last >= syntax->lines) last = syntax->lines - 1;
+    if (first > last) first = last;
+
+    collect(syntax);
+    syntax->provisional_count = 0;
+
+    // Nothing flagged past the known lines means the whole file is up to date
+    if (syntax->stale_from < syntax->lines &&
+        !memchr(syntax->dirty + syntax->stale_from, 1, syntax->lines - syntax->stale_from)) {
+        syntax->stale_from = syntax->lines;
+    }
+
+    if (last >= syntax->stale_from) {
+        if (syntax->worker && last - syntax->stale_from >= SYNTAX_SYNC_LINES) {
+            // Too far to lex now; guess until the worker gets there
+            guess_window(syntax, content, index, first, last);
+        } else {
+            LexRange range = {
+                syntax->language, content, index, syntax->states, syntax->dirty,
+                0, syntax->lines, SYNTAX_STATE_NORMAL
+            };
+            syntax->stale_from = relex(&range, syntax->stale_from, last, &syntax->lexed);
+        }
+    }
+
+    // Lex the rest of the file in the background
+    if (syntax->worker && !syntax->job_active && syntax->stale_from < syntax->lines) {
+        post_job(syntax, content, index);
+    }
+    watch_window(syntax);
+}
+
+void syntax_set_notify(Syntax* syntax, SyntaxNotify notify) {
+    if (!syntax || !syntax->worker) return;
+
+    SyntaxWorker* worker = syntax->worker;
+    pthread_mutex_lock(&worker->lock);
+    worker->notify = notify;
+    pthread_mutex_unlock(&worker->lock);
+}
+
+int syntax_poll(Syntax* syntax) {
+    if (!syntax || !syntax->provisional_count || !syntax->job_active) return 0;
+
+    SyntaxWorker* worker = syntax->worker;
+    pthread_mutex_lock(&worker->lock);
+    size_t reached = worker->first + worker->published;
+    int pending = worker->pending;
+    pthread_mutex_unlock(&worker->lock);
+
+    // Real states are within reach once a render would lex the rest itself
+    size_t last = syntax->provisional_first + syntax->provisional_count - 1;
+    return !pending || reached + SYNTAX_SYNC_LINES > last;
+}
+
+SyntaxState syntax_state_before(const Syntax* syntax, size_t line) {
+    if (!syntax || line == 0 || line > syntax->lines) return STATE_NORMAL;
+    if (line <= syntax->stale_from) return syntax->states[line - 1];
+
+    // Lines on screen past the known states start from the guessed states
+    if (line > syntax->provisional_first &&
+        line - syntax->provisional_first <= syntax->provisional_count) {
+        return syntax->provisional[line - 1 - syntax->provisional_first];
+    }
+    return STATE_NORMAL;
+}
+
+const unsigned char* syntax_line_classes(Syntax* syntax, SyntaxState state, const char* text,
+                                         size_t len, size_t from, size_t count) {
+    if (!syntax) return NULL;
+
+    if (!grow(&syntax->classes, &syntax->classes_capacity, count)) return NULL;
+
+    if (len > 0 && text[len - 1] == '\r') len--;
+    memset(syntax->classes, SYNTAX_NORMAL, count);
+    Marks marks = { syntax->classes, from, count };
+    lex_line(syntax->language, state, text, len, &marks);
+    return syntax->classes;
+}
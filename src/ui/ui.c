@@ -6,8 +6,10 @@
 #include "editor.h"
 #include "viewport.h"
 #include "terminal.h"
-
-#define INITIAL_BUFFER_SIZE 16384  // 16KB initial buffer size
+#include "rowcache.h"
+#include "syntax.h"
+#include "render.h"
+#include "latency.h"
 
 // Defines the MAX macro which returns the larger of two values
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -26,6 +28,8 @@ ScreenBuffer* screen_buffer_create(size_t capacity) {
     buffer->capacity = capacity;
     buffer->size = 0;
     buffer->content[0] = '\0';
+    buffer->sink = NULL;
+    buffer->sink_context = NULL;
     
     return buffer;
 }
@@ -37,6 +41,19 @@ void screen_buffer_free(ScreenBuffer* buffer) {
     free(buffer);
 }
 
+// Grow buffer to hold at least capacity bytes (never shrinks)
+int screen_buffer_reserve(ScreenBuffer* buffer, size_t capacity) {
+    if (!buffer) return 0;
+    if (capacity <= buffer->capacity) return 1;
+    
+    char* new_content = realloc(buffer->content, capacity);
+    if (!new_content) return 0;
+    
+    buffer->content = new_content;
+    buffer->capacity = capacity;
+    return 1;
+}
+
 // Ensure buffer has enough capacity
 static void screen_buffer_ensure_capacity(ScreenBuffer* buffer, size_t additional) {
     if (buffer->size + additional >= buffer->capacity) {
@@ -55,11 +72,31 @@ static void screen_buffer_ensure_capacity(ScreenBuffer* buffer, size_t additiona
 
 // Append string to buffer
 void screen_buffer_append(ScreenBuffer* buffer, const char* str) {
-    size_t len = strlen(str);
+    screen_buffer_append_n(buffer, str, strlen(str));
+}
+
+// Append len bytes to buffer
+void screen_buffer_append_n(ScreenBuffer* buffer, const char* data, size_t len) {
     screen_buffer_ensure_capacity(buffer, len + 1);
     
-    strcpy(buffer->content + buffer->size, str);
+    memcpy(buffer->content + buffer->size, data, len);
     buffer->size += len;
+    buffer->content[buffer->size] = '\0';
+}
+
+// Append count copies of a character to buffer
+void screen_buffer_append_repeat(ScreenBuffer* buffer, char ch, size_t count) {
+    screen_buffer_ensure_capacity(buffer, count + 1);
+    
+    memset(buffer->content + buffer->size, ch, count);
+    buffer->size += count;
+    buffer->content[buffer->size] = '\0';
+}
+
+// Append an unsigned integer in decimal to buffer
+void screen_buffer_append_uint(ScreenBuffer* buffer, size_t value) {
+    char digits[UI_UINT_DIGITS];
+    screen_buffer_append_n(buffer, digits, ui_format_uint(digits, value));
 }
 
 // Append formatted string to buffer
@@ -92,12 +129,23 @@ void screen_buffer_appendf(ScreenBuffer* buffer, const char* format, ...) {
 void screen_buffer_flush(ScreenBuffer* buffer) {
     if (!buffer || buffer->size == 0) return;
     
-    fwrite(buffer->content, 1, buffer->size, stdout);
-    fflush(stdout);
+    // Whole frame in one write, bypassing stdio buffering
+    if (buffer->sink) {
+        buffer->sink(buffer->sink_context, buffer->content, buffer->size);
+    } else {
+        terminal_write_frame(buffer->content, buffer->size);
+    }
     buffer->size = 0;
     buffer->content[0] = '\0';
 }
 
+// Redirect flushed frames
+void screen_buffer_set_sink(ScreenBuffer* buffer, ScreenSinkWrite sink, void* context) {
+    if (!buffer) return;
+    buffer->sink = sink;
+    buffer->sink_context = context;
+}
+
 // Clear buffer
 void screen_buffer_clear(ScreenBuffer* buffer) {
     if (!buffer) return;
@@ -105,11 +153,44 @@ void screen_buffer_clear(ScreenBuffer* buffer) {
     buffer->content[0] = '\0';
 }
 
+// Two-digit pairs "00".."99" so the formatter divides once per two digits
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+size_t ui_format_uint(char* out, size_t value) {
+    char digits[UI_UINT_DIGITS];
+    size_t pos = sizeof(digits);
+    
+    // Fill from the right, two digits at a time
+    while (value >= 100) {
+        size_t pair = (value % 100) * 2;
+        value /= 100;
+        digits[--pos] = digit_pairs[pair + 1];
+        digits[--pos] = digit_pairs[pair];
+    }
+    if (value >= 10) {
+        digits[--pos] = digit_pairs[value * 2 + 1];
+        digits[--pos] = digit_pairs[value * 2];
+    } else {
+        digits[--pos] = (char)('0' + value);
+    }
+    
+    size_t len = sizeof(digits) - pos;
+    memcpy(out, digits + pos, len);
+    return len;
+}
+
+size_t ui_frame_capacity(size_t rows, size_t cols) {
+    return rows * (cols + FRAME_ROW_OVERHEAD) + FRAME_FIXED_OVERHEAD;
+}
+
 // Draw a welcome message when no file is loaded
-void ui_welcome_screen(size_t rows, size_t cols) {
-    ScreenBuffer* buffer = screen_buffer_create(INITIAL_BUFFER_SIZE);
+void ui_welcome_screen(ScreenBuffer* buffer, size_t rows, size_t cols) {
     if (!buffer) return;
     
+    screen_buffer_clear(buffer);
     screen_buffer_append(buffer, TERM_CLEAR_SCREEN);
     screen_buffer_append(buffer, TERM_CURSOR_HOME);
 
@@ -125,19 +206,14 @@ void ui_welcome_screen(size_t rows, size_t cols) {
     screen_buffer_append(buffer, TERM_CURSOR_HOME);
     
     screen_buffer_flush(buffer);
-    screen_buffer_free(buffer);
 }
 
 // Draw status bar at the bottom of the screen
-void ui_status_bar(EditorState* state, ScreenBuffer* buffer) {
+void ui_status_bar(EditorState* state, Grid* grid) {
     if (!state || !state->viewport) return;
     
     Viewport* viewport = state->viewport;
-    
-    screen_buffer_append(buffer, COLOR_STATUS_BAR);
-    
-    // Move cursor to status bar position
-    screen_buffer_appendf(buffer, CSI "%zu;1H", viewport->screen_rows);
+    size_t row = viewport->screen_rows - 1;
     
     // Left side: filename and status
     char status[255];
@@ -149,42 +225,52 @@ void ui_status_bar(EditorState* state, ScreenBuffer* buffer) {
     size_t cursor_x, cursor_y;
     editor_get_cursor_position(state, &cursor_x, &cursor_y);
     
-    // Right side: cursor position
+    // Right side: keypress-to-screen latency when measured, cursor position
+    char latency[64] = "";
+    if (latency_enabled()) {
+        char p50[16], p99[16];
+        latency_format(p50, sizeof(p50), latency_percentile(LATENCY_TOTAL, 50.0));
+        latency_format(p99, sizeof(p99), latency_percentile(LATENCY_TOTAL, 99.0));
+        snprintf(latency, sizeof(latency), "p50 %s p99 %s | ", p50, p99);
+    }
+    
     char position[255];
-    snprintf(position, sizeof(position), "Ln %zu, Col %zu ", 
+    snprintf(position, sizeof(position), "%sLn %zu, Col %zu ", 
+             latency,
              cursor_y + 1,  // 1-indexed for user display
              cursor_x + 1); // 1-indexed for user display
     
-    // Print status bar with proper padding
-    size_t status_len = strlen(status);
     size_t pos_len = strlen(position);
     
-    screen_buffer_append(buffer, status);
-    
-    // Fill middle with spaces
-    for (size_t i = status_len; i < viewport->screen_cols - pos_len; i++) {
-        screen_buffer_append(buffer, " ");
+    // Fill the bar, then place both sides; the grid clips narrow terminals
+    grid_fill(grid, row, 0, viewport->screen_cols, ' ', COLOR_STATUS_BAR);
+    grid_write(grid, row, 0, status, strlen(status), COLOR_STATUS_BAR);
+    if (pos_len <= viewport->screen_cols) {
+        grid_write(grid, row, viewport->screen_cols - pos_len, position, pos_len, COLOR_STATUS_BAR);
     }
-    
-    screen_buffer_append(buffer, position);
-    screen_buffer_append(buffer, COLOR_RESET);
 }
 
 // Draw a vertical scrollbar
-void ui_scrollbar(EditorState* state, ScreenBuffer* buffer) {
+void ui_scrollbar(EditorState* state, Grid* grid) {
     if (!state || !state->viewport) return;
     
     Viewport* viewport = state->viewport;
     size_t visible_rows = viewport->screen_rows - 1; // Account for status bar
     
-    // Only draw scrollbar if content exceeds viewport height
-    if (viewport->total_lines <= visible_rows) {
+    // Folded lines don't take up space, so measure content in visible rows
+    size_t content_height = viewport_visible_lines(viewport);
+    
+    // Only draw scrollbar if content exceeds viewport height; otherwise keep
+    // the column blank (the grid remembers the previous frame)
+    if (content_height <= visible_rows) {
+        for (size_t i = 0; i < visible_rows; i++) {
+            grid_fill(grid, i, viewport->screen_cols - SCROLLBAR_WIDTH, SCROLLBAR_WIDTH, ' ', GRID_ATTR_DEFAULT);
+        }
         return;
     }
     
     // Calculate scrollbar properties
     size_t scrollbar_height = visible_rows;
-    size_t content_height = viewport->total_lines;
     
     // Calculate thumb size (proportional to visible/total ratio)
     // Ensure thumb is at least 1 character tall
@@ -192,24 +278,95 @@ void ui_scrollbar(EditorState* state, ScreenBuffer* buffer) {
     if (thumb_size < 1) thumb_size = 1;
     
     // Calculate thumb position
-    float scroll_ratio = (float)viewport->scroll_y / MAX(1, content_height - 1);
+    float scroll_ratio = (float)viewport_line_to_row(viewport, viewport->scroll_y) / MAX(1, content_height - 1);
     if (scroll_ratio > 1.0f) scroll_ratio = 1.0f;  // Safety check
     size_t thumb_position = (scrollbar_height - thumb_size) * scroll_ratio;
     
-    // Draw the scrollbar track and thumb
+    // Draw the scrollbar track and thumb in the rightmost column
     for (size_t i = 0; i < scrollbar_height; i++) {
-        // Position at right edge of screen
-        screen_buffer_appendf(buffer, CSI "%zu;%zuH", i + 1, viewport->screen_cols);
+        int thumb = i >= thumb_position && i < thumb_position + thumb_size;
+        grid_fill(grid, i, viewport->screen_cols - SCROLLBAR_WIDTH, SCROLLBAR_WIDTH, ' ',
+                  thumb ? COLOR_SCROLLBAR_THUMB : COLOR_SCROLLBAR_TRACK);
+    }
+}
+
+// Foreground per SyntaxClass
+static const GridAttr syntax_colors[SYNTAX_CLASS_COUNT] = {
+    [SYNTAX_NORMAL]   = GRID_ATTR_DEFAULT,
+    [SYNTAX_COMMENT]  = COLOR_SYNTAX_COMMENT,
+    [SYNTAX_KEYWORD]  = COLOR_SYNTAX_KEYWORD,
+    [SYNTAX_TYPE]     = COLOR_SYNTAX_TYPE,
+    [SYNTAX_STRING]   = COLOR_SYNTAX_STRING,
+    [SYNTAX_NUMBER]   = COLOR_SYNTAX_NUMBER,
+    [SYNTAX_PREPROC]  = COLOR_SYNTAX_PREPROC,
+    [SYNTAX_VARIABLE] = COLOR_SYNTAX_VARIABLE
+};
+
+// Write visible text one run of equally highlighted bytes at a time
+static void ui_render_text(Viewport* viewport, Grid* grid, size_t row, size_t col,
+                           const RowKey* key, const char* text, size_t len, GridAttr base) {
+    const unsigned char* classes = NULL;
+    if (viewport->syntax) {
+        size_t line_len = viewport_line_length(viewport, key->line);
+        classes = syntax_line_classes(viewport->syntax, (SyntaxState)key->syntax,
+                                      text - key->scroll_x, line_len, key->scroll_x, len);
+    }
+    if (!classes) {
+        grid_write(grid, row, col, text, len, base);
+        return;
+    }
+    
+    size_t start = 0;
+    while (start < len) {
+        size_t end = start + 1;
+        while (end < len && classes[end] == classes[start]) end++;
         
-        // Draw thumb or track
-        if (i >= thumb_position && i < thumb_position + thumb_size) {
-            screen_buffer_append(buffer, COLOR_SCROLLBAR_THUMB);
-        } else {
-            screen_buffer_append(buffer, COLOR_SCROLLBAR_TRACK);
-        }
+        GridAttr attr = classes[start] == SYNTAX_NORMAL ? base :
+                        (base & ~GRID_COLOR_MASK) | syntax_colors[classes[start]];
+        grid_write(grid, row, col + start, text + start, end - start, attr);
+        start = end;
+    }
+}
+
+// Draw one text row: line number, fold marker and the visible part of the line
+static void ui_render_row(Viewport* viewport, Grid* grid, size_t row, const RowKey* key) {
+    size_t gutter = LINE_NUMBER_WIDTH + LINE_NUMBER_PADDING;
+    size_t text_cols = viewport->screen_cols > SCROLLBAR_WIDTH ? viewport->screen_cols - SCROLLBAR_WIDTH : 0;
+    size_t text_width = text_cols > gutter ? text_cols - gutter : 0;
+    
+    // Start from a blank row, leaving the scrollbar column alone
+    grid_fill(grid, row, 0, text_cols, ' ', GRID_ATTR_DEFAULT);
+    if (key->line == ROW_EMPTY) return;
+    
+    int current = (key->flags & ROW_CURRENT) != 0;
+    
+    // Print line number, highlighted on the current line
+    GridAttr num_attr = current ? COLOR_CURRENT_LINE_NUM : COLOR_LINE_NUM;
+    size_t col = grid_write_uint(grid, row, 0, LINE_NUMBER_WIDTH, key->line + 1, num_attr);
+    
+    // Add configurable padding spaces, marking collapsed folds
+    grid_fill(grid, row, col, LINE_NUMBER_PADDING, ' ', num_attr);
+    if (key->flags & ROW_FOLDED) {
+        grid_fill(grid, row, col + FOLD_MARKER_COLUMN, 1, FOLD_MARKER, num_attr);
+    }
+    
+    // Get line through viewport, which accesses buffer via editor
+    char* line = viewport_get_line(viewport, key->line);
+    size_t line_len = viewport_line_length(viewport, key->line);
+    
+    // Print the part of the line between scroll_x and the scrollbar
+    if (line && key->scroll_x < line_len) {
+        size_t visible_len = line_len - key->scroll_x;
+        if (visible_len > text_width) visible_len = text_width;
         
-        screen_buffer_append(buffer, " ");
-        screen_buffer_append(buffer, COLOR_RESET);
+        line += key->scroll_x;
+        
+        // A carriage return ends the visible text (CRLF files)
+        const char* cr = memchr(line, '\r', visible_len);
+        if (cr) visible_len = cr - line;
+        
+        ui_render_text(viewport, grid, row, gutter, key, line, visible_len,
+                       current ? COLOR_CURRENT_LINE : GRID_ATTR_DEFAULT);
     }
 }
 
@@ -218,103 +375,100 @@ void ui_render(EditorState* state) {
     if (!state || !state->viewport) return;
     
     Viewport* viewport = state->viewport;
+    LatencyFrame trace;
+    latency_frame_begin(&trace);
+    
+    // Reuse the editor's frame buffer; it is sized for the terminal on resize
+    ScreenBuffer* buffer = state->screen;
+    Grid* grid = state->grid;
+    RowCache* rows = state->row_cache;
+    if (!buffer || !grid || !rows) return;
+    screen_buffer_clear(buffer);
+    
+    // Draw the frame into the back grid; only the cells that differ from
+    // what the terminal already shows are written out
+    size_t text_rows = viewport->screen_rows - 1; // Reserve one line for status bar
+    if (!grid_resize(grid, viewport->screen_rows, viewport->screen_cols) ||
+        !row_cache_resize(rows, text_rows)) {
+        return;
+    }
     
-    ScreenBuffer* buffer = screen_buffer_create(INITIAL_BUFFER_SIZE);
-    if (!buffer) return;
+    // Rows showing edited lines must be re-formatted even if their keys match
+    size_t dirty_from, dirty_to;
+    if (viewport_take_dirty(viewport, &dirty_from, &dirty_to)) {
+        row_cache_invalidate_lines(rows, dirty_from, dirty_to);
+    }
     
-    // Use TERM_CURSOR_HOME instead of clearing the screen
-    // This reduces flicker by not clearing the entire screen
-    screen_buffer_append(buffer, TERM_CURSOR_HOME);
+    // Calculate visible region in rows, skipping folded lines
+    size_t scroll_row = viewport_line_to_row(viewport, viewport->scroll_y);
+    size_t visible_rows = text_rows;
+    if (visible_rows > viewport_visible_lines(viewport) - scroll_row) {
+        visible_rows = viewport_visible_lines(viewport) - scroll_row;
+    }
     
-    // Calculate visible region
-    size_t visible_rows = viewport->screen_rows - 1; // Reserve one line for status bar
-    if (visible_rows > viewport->total_lines - viewport->scroll_y) {
-        visible_rows = viewport->total_lines - viewport->scroll_y;
+    // Highlighting needs the lexer state at the start of every visible line
+    if (visible_rows > 0) {
+        syntax_update(viewport->syntax, viewport->content, viewport->lines, viewport->scroll_y,
+                      viewport_row_to_line(viewport, scroll_row + visible_rows - 1));
     }
     
-    // Render each visible line
-    for (size_t i = 0; i < visible_rows; i++) {
-        size_t line_num = viewport->scroll_y + i;
-        
-        // Highlight current line
-        if (line_num == viewport->cursor_y) {
-            screen_buffer_append(buffer, COLOR_CURRENT_LINE);
-        }
-        
-        // Print line number
-        screen_buffer_append(buffer, COLOR_LINE_NUM);
-        screen_buffer_appendf(buffer, "%*zu", LINE_NUMBER_WIDTH, line_num + 1);
-
-        // Add configurable padding spaces
-        for (size_t p = 0; p < LINE_NUMBER_PADDING; p++) {
-            screen_buffer_append(buffer, " ");
-        }
-        
-        screen_buffer_append(buffer, COLOR_RESET);
-        
-        if (line_num == viewport->cursor_y) {
-            screen_buffer_append(buffer, COLOR_CURRENT_LINE);
-        }
-        
-        // Get line through viewport, which accesses buffer via editor
-        char* line = viewport_get_line(viewport, line_num);
-        
-        if (line) {
-            // Calculate visible segment of the line
-            size_t line_len = viewport_line_length(viewport, line_num);
-            size_t visible_len = line_len;
-
-            // Account for both line number width AND padding when calculating visible area
-            if (visible_len > viewport->screen_cols - (LINE_NUMBER_WIDTH + LINE_NUMBER_PADDING) - SCROLLBAR_WIDTH - viewport->scroll_x) {
-                visible_len = viewport->screen_cols - (LINE_NUMBER_WIDTH + LINE_NUMBER_PADDING) - SCROLLBAR_WIDTH - viewport->scroll_x;
-            }
-            
-            // Skip part of line before scroll_x
-            if (viewport->scroll_x < line_len) {
-                line += viewport->scroll_x;
-                
-                // Print visible part of the line
-                for (size_t j = 0; j < visible_len; j++) {
-                    if (line[j] == '\n' || line[j] == '\r') break;
-                    screen_buffer_appendf(buffer, "%c", line[j]);
-                }
-            }
-        }
-        
-        screen_buffer_append(buffer, COLOR_RESET);
-        
-        // Clear to end of line and move to next line
-        screen_buffer_append(buffer, TERM_CLEAR_LINE);
-        if (i < visible_rows - 1) {
-            screen_buffer_append(buffer, "\r\n");
+    // Work out what every text row shows in this frame
+    for (size_t i = 0; i < text_rows; i++) {
+        RowKey* key = &rows->next[i];
+        key->line = ROW_EMPTY;
+        key->scroll_x = viewport->scroll_x;
+        key->width = viewport->screen_cols;
+        key->flags = 0;
+        key->syntax = SYNTAX_STATE_NORMAL;
+        key->valid = 1;
+        if (i < visible_rows) {
+            key->line = viewport_row_to_line(viewport, scroll_row + i);
+            if (key->line == viewport->cursor_y) key->flags |= ROW_CURRENT;
+            if (viewport_is_folded(viewport, key->line)) key->flags |= ROW_FOLDED;
+            key->syntax = syntax_state_before(viewport->syntax, key->line);
         }
     }
     
-    // Fill any remaining rows with blank lines
-    for (size_t i = visible_rows; i < viewport->screen_rows - 1; i++) {
-        // Just use blank lines for all rows beyond the content
-        screen_buffer_append(buffer, TERM_CLEAR_LINE);
-        
-        if (i < viewport->screen_rows - 2) {
-            screen_buffer_append(buffer, "\r\n");
+    // If the text moved vertically, let the terminal scroll the rows it
+    // already shows so only the newly exposed ones are sent; with a render
+    // thread the grid just moves and the thread scrolls the terminal
+    int threaded = render_thread_running();
+    long shift = row_cache_find_shift(rows);
+    if (shift != 0 && grid_scroll(grid, threaded ? NULL : buffer, 0, text_rows - 1, shift)) {
+        row_cache_scroll(rows, shift);
+    } else {
+        shift = 0;
+    }
+    
+    // Re-format only the rows whose inputs changed since the last frame
+    for (size_t i = 0; i < text_rows; i++) {
+        if (!row_cache_check(rows, i, &rows->next[i])) {
+            ui_render_row(viewport, grid, i, &rows->next[i]);
         }
     }
     
     // Draw status bar
-    ui_status_bar(state, buffer);
+    ui_status_bar(state, grid);
     
     // Draw scrollbar
-    ui_scrollbar(state, buffer);
+    ui_scrollbar(state, grid);
     
     // Position cursor 
     size_t cursor_x, cursor_y;
     editor_get_cursor_position(state, &cursor_x, &cursor_y);
     
-    screen_buffer_appendf(buffer, CSI "%zu;%zuH", 
-                         cursor_y - viewport->scroll_y + 1, 
-                         cursor_x - viewport->scroll_x + LINE_NUMBER_WIDTH + LINE_NUMBER_PADDING + 1);
+    grid_set_cursor(grid, viewport_line_to_row(viewport, cursor_y) - scroll_row,
+                    cursor_x - viewport->scroll_x + LINE_NUMBER_WIDTH + LINE_NUMBER_PADDING);
+    
+    // The render thread writes the frame when the terminal can take it
+    latency_frame_built(&trace);
+    if (threaded) {
+        render_submit_frame(grid, 0, text_rows - 1, shift, &trace);
+        return;
+    }
     
-    // Flush the buffer to the screen
+    // Emit the changed cells and flush them to the screen
+    grid_diff(grid, buffer);
     screen_buffer_flush(buffer);
-    screen_buffer_free(buffer);
+    latency_frame_written(&trace);
 }
\ No newline at end of file
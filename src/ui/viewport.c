@@ -1,49 +1,47 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include "viewport.h"
 #include "editor.h"
 
 static void update_line_cache(Viewport* viewport) {
-    // Free previous content and cache if they exist
+    // The highlighter may still be reading the old text in the background
+    syntax_cancel(viewport->syntax);
+
+    // Free previous content and index if they exist
     if (viewport->content) {
         free(viewport->content);
     }
-    if (viewport->line_cache) {
-        free(viewport->line_cache);
+    if (viewport->lines) {
+        line_index_free(viewport->lines);
+        viewport->lines = NULL;
     }
+    viewport->content_size = 0;
     
     // Get fresh content from editor (instead of directly from buffer)
     viewport->content = editor_get_content(viewport->editor);
     if (!viewport->content) return;
+    viewport->content_size = strlen(viewport->content);
+    viewport->content_generation = editor_get_generation(viewport->editor);
 
-    // Count lines and allocate cache
-    size_t capacity = 1024;
-    viewport->line_cache = malloc(sizeof(char*) * capacity);
-    if (!viewport->line_cache) {
+    // Index line starts with the vectorized, multi-threaded scanner
+    viewport->lines = line_index_create(viewport->content,
+                                        viewport->content_size,
+                                        VIEWPORT_LINE_STRIDE);
+    if (!viewport->lines) {
         free(viewport->content);
         viewport->content = NULL;
+        viewport->content_size = 0;
         return;
     }
-    
-    viewport->line_count = 0;
-    
-    // First line always starts at the beginning
-    viewport->line_cache[viewport->line_count++] = viewport->content;
-
-    // Find start of each line
-    for (char* p = viewport->content; *p; p++) {
-        if (*p == '\n') {
-            if (viewport->line_count >= capacity) {
-                capacity *= 2;
-                char** new_cache = realloc(viewport->line_cache, sizeof(char*) * capacity);
-                if (!new_cache) break;
-                viewport->line_cache = new_cache;
-            }
-            viewport->line_cache[viewport->line_count++] = p + 1;
-        }
-    }
 
-    viewport->total_lines = viewport->line_count;
+    viewport->total_lines = line_index_count(viewport->lines);
+
+    // Edits keep the lexer states in step with the lines; anything else
+    // (a reload) starts highlighting over
+    if (viewport->syntax && viewport->syntax->lines != viewport->total_lines) {
+        syntax_reset(viewport->syntax, viewport->total_lines);
+    }
     // Do NOT free content here - we keep it for the lifetime of the viewport
 }
 
@@ -60,21 +58,38 @@ Viewport* viewport_create(struct EditorState* editor_state, size_t rows, size_t
     viewport->screen_rows = rows;
     viewport->screen_cols = cols;
     viewport->content = NULL;    // Initialize to NULL
-    viewport->line_cache = NULL;
-    viewport->line_count = 0;
+    viewport->content_size = 0;
+    viewport->content_generation = 0;
+    viewport->lines = NULL;
+    viewport->syntax = NULL;
+    viewport->fold_mark = NULL;
+    viewport->dirty_from = 0;         // Nothing has been rendered yet
+    viewport->dirty_to = SIZE_MAX;
+    viewport->folds = fold_set_create();
+    if (!viewport->folds) {
+        free(viewport);
+        return NULL;
+    }
 
     update_line_cache(viewport);
+
+    // Highlight if the file name or a #! line names a known language
+    const SyntaxLanguage* language = syntax_detect(editor_get_filename(editor_state), viewport->content);
+    if (language && viewport->lines) {
+        viewport->syntax = syntax_create(language, viewport->total_lines);
+    }
     return viewport;
 }
 
 void viewport_free(Viewport* viewport) {
     if (!viewport) return;
+    // Stop the highlighter before the text it reads goes away
+    syntax_free(viewport->syntax);
     if (viewport->content) {
         free(viewport->content);
     }
-    if (viewport->line_cache) {
-        free(viewport->line_cache);
-    }
+    line_index_free(viewport->lines);
+    fold_set_free(viewport->folds);
     free(viewport);
 }
 
@@ -85,46 +100,52 @@ void viewport_resize(Viewport* viewport, size_t rows, size_t cols) {
 }
 
 void viewport_move_cursor(Viewport* viewport, int dx, int dy) {
-    // Calculate new position
-    int new_x = (int)viewport->cursor_x + dx;
-    int new_y = (int)viewport->cursor_y + dy;
-
-    // Handle moving right at end of line
-    if (dx > 0 && new_y < (int)viewport->total_lines - 1) {
-        size_t current_line_len = viewport_line_length(viewport, viewport->cursor_y);
-        if (viewport->cursor_x >= current_line_len) {
-            new_x = 0;
-            new_y++;
-        }
-    }
+    // Work in visible rows so folded lines are skipped without visiting them
+    long visible = (long)viewport_visible_lines(viewport);
+    long new_x = (long)viewport->cursor_x;
+    long new_row = (long)viewport_line_to_row(viewport, viewport->cursor_y);
 
-    // Handle moving left at beginning of line
-    if (dx < 0 && new_x < 0 && new_y > 0) {
-        new_y--; // Move to previous line
-        size_t prev_line_len = viewport_line_length(viewport, new_y);
-        new_x = prev_line_len; // Position cursor at the end of the previous line
+    // Walk horizontally, wrapping past line ends onto the next or previous
+    // line; each wrap costs one step, and only lines crossed are visited
+    long steps = dx < 0 ? -(long)dx : dx;
+    long line_len = (long)viewport_line_length(viewport, viewport->cursor_y);
+    if (new_x > line_len) new_x = line_len;
+    while (dx > 0 && steps > line_len - new_x && new_row < visible - 1) {
+        steps -= line_len - new_x + 1;
+        new_row++;
+        new_x = 0;
+        line_len = (long)viewport_line_length(viewport, viewport_row_to_line(viewport, new_row));
     }
+    while (dx < 0 && steps > new_x && new_row > 0) {
+        steps -= new_x + 1;
+        new_row--;
+        line_len = (long)viewport_line_length(viewport, viewport_row_to_line(viewport, new_row));
+        new_x = line_len;
+    }
+    new_x += dx > 0 ? steps : -steps;
+    new_row += dy;
 
-    // Clamp Y position
-    if (new_y < 0) new_y = 0;
-    if (new_y >= (int)viewport->total_lines) {
-        new_y = viewport->total_lines - 1;
+    // Clamp row
+    if (new_row < 0) new_row = 0;
+    if (new_row >= visible) {
+        new_row = visible - 1;
     }
+    size_t new_y = viewport_row_to_line(viewport, new_row);
 
     // If moving horizontally, update the desired x position
     if (dx != 0) {
         // Clamp X position based on line length
-        size_t line_len = viewport_line_length(viewport, new_y);
+        line_len = (long)viewport_line_length(viewport, new_y);
         if (new_x < 0) new_x = 0;
-        if (new_x > (int)line_len) new_x = line_len;
+        if (new_x > line_len) new_x = line_len;
         
         viewport->desired_x = new_x;
     }
     // If moving vertically, use the desired x position
     else if (dy != 0) {
-        size_t line_len = viewport_line_length(viewport, new_y);
+        size_t len = viewport_line_length(viewport, new_y);
         // Set actual x position to the minimum of desired_x and the current line length
-        new_x = (int)(viewport->desired_x < line_len ? viewport->desired_x : line_len);
+        new_x = (long)(viewport->desired_x < len ? viewport->desired_x : len);
     }
 
     viewport->cursor_x = new_x;
@@ -140,45 +161,48 @@ void viewport_set_cursor(Viewport* viewport, size_t x, size_t y) {
 }
 
 void viewport_scroll(Viewport* viewport, int dx, int dy) {
-    // Calculate new scroll position
+    // Calculate new scroll position (vertical scrolling counts visible rows)
     int new_scroll_x = (int)viewport->scroll_x + dx;
-    int new_scroll_y = (int)viewport->scroll_y + dy;
+    long new_scroll_row = (long)viewport_line_to_row(viewport, viewport->scroll_y) + dy;
+    size_t visible = viewport_visible_lines(viewport);
 
     // Clamp horizontal scroll (prevent negative scrolling)
     if (new_scroll_x < 0) new_scroll_x = 0;
     
     // Clamp vertical scroll (prevent negative scrolling)
-    if (new_scroll_y < 0) new_scroll_y = 0;
+    if (new_scroll_row < 0) new_scroll_row = 0;
     
     // Handle vertical scrolling limits
-    if (viewport->total_lines <= viewport->screen_rows - 1) {
+    if (visible <= viewport->screen_rows - 1) {
         // If content fits entirely in the viewport (accounting for status bar),
         // don't allow any scrolling
-        new_scroll_y = 0;
+        new_scroll_row = 0;
     } else {
         // Allow scrolling until the last line appears at the top of the viewport
         // (subtract 1 to convert from count to index)
-        size_t max_scroll_y = viewport->total_lines - 1;
-        if (new_scroll_y > (int)max_scroll_y) {
-            new_scroll_y = (int)max_scroll_y;
+        size_t max_scroll_row = visible - 1;
+        if (new_scroll_row > (long)max_scroll_row) {
+            new_scroll_row = (long)max_scroll_row;
         }
     }
 
     viewport->scroll_x = new_scroll_x;
-    viewport->scroll_y = new_scroll_y;
+    viewport->scroll_y = viewport_row_to_line(viewport, new_scroll_row);
 }
 
 void viewport_ensure_cursor_visible(Viewport* viewport) {
     // Account for status bar in available rows
     size_t visible_rows = viewport->screen_rows - 1;
+    size_t cursor_row = viewport_line_to_row(viewport, viewport->cursor_y);
+    size_t scroll_row = viewport_line_to_row(viewport, viewport->scroll_y);
     
     // Vertical scrolling - ensure cursor is visible
-    if (viewport->cursor_y < viewport->scroll_y) {
+    if (cursor_row < scroll_row) {
         // Cursor is above viewport, scroll up
-        viewport->scroll_y = viewport->cursor_y;
-    } else if (viewport->cursor_y >= viewport->scroll_y + visible_rows) {
+        scroll_row = cursor_row;
+    } else if (cursor_row >= scroll_row + visible_rows) {
         // Cursor is below viewport, scroll down
-        viewport->scroll_y = viewport->cursor_y - visible_rows + 1;
+        scroll_row = cursor_row - visible_rows + 1;
     }
 
     // Horizontal scrolling
@@ -189,59 +213,127 @@ void viewport_ensure_cursor_visible(Viewport* viewport) {
     }
     
     // Make sure we don't scroll past the last possible position
-    if (viewport->total_lines > 0) {
+    size_t visible = viewport_visible_lines(viewport);
+    if (visible > 0) {
         // Allow scrolling until the last line is the first visible line
-        size_t max_scroll_y = viewport->total_lines - 1;
-        if (viewport->scroll_y > max_scroll_y) {
-            viewport->scroll_y = max_scroll_y;
+        size_t max_scroll_row = visible - 1;
+        if (scroll_row > max_scroll_row) {
+            scroll_row = max_scroll_row;
         }
     } else {
-        viewport->scroll_y = 0;
+        scroll_row = 0;
     }
+
+    viewport->scroll_y = viewport_row_to_line(viewport, scroll_row);
 }
 
 char* viewport_get_line(Viewport* viewport, size_t line_number) {
-    if (line_number >= viewport->line_count) return NULL;
-    return viewport->line_cache[line_number];
+    if (line_number >= line_index_count(viewport->lines)) return NULL;
+    return viewport->content + line_index_start(viewport->lines, line_number);
 }
 
 size_t viewport_line_length(Viewport* viewport, size_t line_number) {
-    if (line_number >= viewport->line_count) return 0;
-    
-    char* line_start = viewport->line_cache[line_number];
-    char* line_end;
+    if (line_number >= line_index_count(viewport->lines)) return 0;
     
-    if (line_number + 1 < viewport->line_count) {
-        line_end = viewport->line_cache[line_number + 1] - 1; // Before the newline
-    } else {
-        line_end = line_start + strlen(line_start);
-    }
+    size_t line_start = line_index_start(viewport->lines, line_number);
+    size_t line_end = line_index_end(viewport->lines, line_number); // Before the newline
     
     return line_end - line_start;
 }
 
 void viewport_refresh_cache(Viewport* viewport) {
+    // Navigation refreshes the view too; only re-index when the text changed
+    if (viewport->lines &&
+        viewport->content_generation == editor_get_generation(viewport->editor)) {
+        return;
+    }
     update_line_cache(viewport);
 }
 
+size_t viewport_visible_lines(Viewport* viewport) {
+    return viewport->total_lines - fold_set_hidden(viewport->folds);
+}
+
+size_t viewport_line_to_row(Viewport* viewport, size_t line) {
+    return fold_set_to_visible(viewport->folds, line);
+}
+
+size_t viewport_row_to_line(Viewport* viewport, size_t row) {
+    return fold_set_from_visible(viewport->folds, row);
+}
+
+int viewport_fold(Viewport* viewport, size_t start, size_t end) {
+    if (end >= viewport->total_lines) end = viewport->total_lines - 1;
+    if (!fold_set_add(viewport->folds, start, end)) return 0;
+
+    // A hidden cursor moves up to the fold's first line
+    if (viewport->cursor_y > start && viewport->cursor_y <= end) {
+        viewport_set_cursor(viewport, 0, start);
+    } else {
+        viewport_ensure_cursor_visible(viewport);
+    }
+    return 1;
+}
+
+int viewport_unfold(Viewport* viewport, size_t line) {
+    if (!fold_set_remove(viewport->folds, line)) return 0;
+    viewport_ensure_cursor_visible(viewport);
+    return 1;
+}
+
+void viewport_unfold_all(Viewport* viewport) {
+    fold_set_clear(viewport->folds);
+    viewport_ensure_cursor_visible(viewport);
+}
+
+int viewport_is_folded(Viewport* viewport, size_t line) {
+    size_t start;
+    return fold_set_find(viewport->folds, line, &start, NULL) && start == line;
+}
+
+size_t viewport_line_at(Viewport* viewport, size_t pos) {
+    return line_index_line_at(viewport->lines, pos);
+}
+
+void viewport_lines_changed(Viewport* viewport, size_t line, long delta) {
+    fold_set_shift(viewport->folds, line, delta);
+    syntax_lines_changed(viewport->syntax, line, delta);
+
+    // Once lines move, everything below the edit shows different text
+    size_t last = delta != 0 ? SIZE_MAX : line;
+    if (viewport->dirty_from > viewport->dirty_to) {
+        viewport->dirty_from = line;
+        viewport->dirty_to = last;
+    } else {
+        if (line < viewport->dirty_from) viewport->dirty_from = line;
+        if (last > viewport->dirty_to) viewport->dirty_to = last;
+    }
+}
+
+int viewport_take_dirty(Viewport* viewport, size_t* from, size_t* to) {
+    if (viewport->dirty_from > viewport->dirty_to) return 0;
+
+    *from = viewport->dirty_from;
+    *to = viewport->dirty_to;
+    viewport->dirty_from = 1;
+    viewport->dirty_to = 0;
+    return 1;
+}
+
 size_t viewport_screen_to_buffer_pos(Viewport* viewport, size_t screen_x, size_t screen_y) {
-    size_t file_y = screen_y + viewport->scroll_y;
-    if (file_y >= viewport->line_count) return 0;
+    size_t file_y = viewport_row_to_line(viewport,
+                                         viewport_line_to_row(viewport, viewport->scroll_y) + screen_y);
+    if (file_y >= line_index_count(viewport->lines)) return 0;
 
-    char* line = viewport_get_line(viewport, file_y);
-    size_t pos = line - viewport->line_cache[0]; // Offset from start of buffer
+    size_t pos = line_index_start(viewport->lines, file_y); // Offset from start of buffer
     return pos + screen_x + viewport->scroll_x;
 }
 
 void viewport_buffer_to_screen_pos(Viewport* viewport, size_t buffer_pos, size_t* screen_x, size_t* screen_y) {
     // Find the line containing the buffer position
-    size_t line = 0;
-    while (line + 1 < viewport->line_count && 
-           buffer_pos >= (size_t)(viewport->line_cache[line + 1] - viewport->line_cache[0])) {
-        line++;
-    }
+    size_t line = line_index_line_at(viewport->lines, buffer_pos);
 
     // Calculate screen coordinates
-    *screen_y = line - viewport->scroll_y;
-    *screen_x = buffer_pos - (viewport->line_cache[line] - viewport->line_cache[0]) - viewport->scroll_x;
+    *screen_y = viewport_line_to_row(viewport, line) - viewport_line_to_row(viewport, viewport->scroll_y);
+    *screen_x = buffer_pos - line_index_start(viewport->lines, line) - viewport->scroll_x;
 }
\ No newline at end of file
@@ -0,0 +1,603 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+#include "editor.h"
+#include "viewport.h"
+#include "ui.h"
+#include "grid.h"
+#include "rowcache.h"
+#include "vterm.h"
+#include "input.h"
+
+// What each scenario does between frames
+typedef enum {
+    SCENARIO_FULL,         // Forget the screen and repaint everything
+    SCENARIO_IDLE,         // Nothing changed
+    SCENARIO_CURSOR,       // Cursor down a line, then back up
+    SCENARIO_PAGE,         // Page down, then back up
+    SCENARIO_WHEEL,        // Wheel scroll down, then back up
+    SCENARIO_COUNT
+} Scenario;
+
+static const char* scenario_names[SCENARIO_COUNT] = {
+    "full", "idle", "cursor", "page", "wheel"
+};
+
+// Input typical of a session: typing, cursor keys with and without modifiers,
+// editing keys, a mouse drag, wheel scrolls, focus changes, Alt and a paste
+static const char input_corpus[] =
+    "int main(void) {\r"
+    "\x1b[A\x1b[B\x1b[C\x1b[D\x1bOH\x1bOF"
+    "\x1b[1;5C\x1b[1;5D\x1b[1;2A\x1b[3~\x1b[5~\x1b[6;5~"
+    "\x1b[<0;12;4M\x1b[<32;13;4M\x1b[<32;14;5M\x1b[<0;14;5m"
+    "\x1b[<65;40;20M\x1b[<65;40;20M\x1b[<64;40;20M"
+    "\x1b[O\x1b[I\x1bx\x7f"
+    "\x1b[200~pasted\rlines \x1b[A with\ttabs\r\x1b[201~";
+
+// Bytes random input streams are drawn from, weighted toward sequence syntax
+static const char fuzz_alphabet[] =
+    "\x1b\x1b\x1b\x1b[[[[OO0123456789;;;<<?MmABCDHFIO~~ a\r\x7f:$";
+
+// Sequences spliced whole into random streams, which random bytes rarely form
+static const char* fuzz_tokens[] = {
+    TERM_PASTE_BEGIN, TERM_PASTE_END, CSI "<32;10;5M", CSI "1;5A"
+};
+#define FUZZ_TOKEN_COUNT (sizeof(fuzz_tokens) / sizeof(fuzz_tokens[0]))
+
+// Longest random stream
+#define FUZZ_MAX_STREAM 4096
+
+// Longest piece a random stream is split into
+#define FUZZ_MAX_PIECE 16
+
+// Size of the chunks the timed stream is fed in
+#define INPUT_CHUNK 4096
+
+// Frames flowing from the renderer into the virtual terminal
+typedef struct {
+    VTerm* vterm;          // Screen the frames are applied to
+    size_t frame_bytes;    // Bytes in the current frame
+    long long sink_ns;     // Time spent parsing the current frame
+} BenchSink;
+
+// Measurements of one scenario
+typedef struct {
+    size_t frames;         // Frames rendered
+    double avg_us;         // Mean frame time
+    double p99_us;         // 99th percentile frame time
+    double max_us;         // Slowest frame
+    size_t avg_bytes;      // Mean bytes per frame
+    size_t max_bytes;      // Largest frame
+    size_t mismatches;     // Frames whose screen differs from the grid
+} BenchResult;
+
+/**
+ * Get monotonic time in nanoseconds
+ */
+static long long bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Output sink: apply the frame to the virtual terminal, keeping the parsing
+ * time out of the frame time
+ */
+static int bench_sink_write(void* context, const char* data, size_t len) {
+    BenchSink* sink = (BenchSink*)context;
+    long long start = bench_now_ns();
+    int result = vterm_sink_write(sink->vterm, data, len);
+    sink->sink_ns += bench_now_ns() - start;
+    sink->frame_bytes += len;
+    return result;
+}
+
+/**
+ * Convert a grid color field to a virtual terminal color
+ */
+static short bench_color(GridAttr field) {
+    return field ? (short)(field - 1) : VTERM_DEFAULT_COLOR;
+}
+
+/**
+ * Compare the virtual terminal with the frame the renderer drew
+ * Reports the first differing cell on stderr.
+ * @return 1 if the screens match, 0 otherwise
+ */
+static int bench_check_screen(const Grid* grid, const VTerm* vterm, const char* scenario,
+                              size_t frame) {
+    for (size_t row = 0; row < grid->rows; row++) {
+        for (size_t col = 0; col < grid->cols; col++) {
+            size_t i = row * grid->cols + col;
+            char ch = grid->back.chars[i];
+            short fg = bench_color(grid->back.attrs[i] & GRID_COLOR_MASK);
+            short bg = bench_color((grid->back.attrs[i] >> GRID_COLOR_BITS) & GRID_COLOR_MASK);
+            const VTermCell* cell = vterm_cell(vterm, row, col);
+
+            if (cell->ch != ch || cell->fg != fg || cell->bg != bg) {
+                fprintf(stderr, "%s frame %zu: cell %zu,%zu is '%c' %d/%d, expected '%c' %d/%d\n",
+                        scenario, frame, row, col, cell->ch, cell->fg, cell->bg, ch, fg, bg);
+                return 0;
+            }
+        }
+    }
+
+    size_t row = grid->target_row < grid->rows ? grid->target_row : grid->rows - 1;
+    size_t col = grid->target_col < grid->cols ? grid->target_col : grid->cols - 1;
+    if (vterm->cursor_row != row || vterm->cursor_col != col) {
+        fprintf(stderr, "%s frame %zu: cursor at %zu,%zu, expected %zu,%zu\n",
+                scenario, frame, vterm->cursor_row, vterm->cursor_col, row, col);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Change the editor state the way a scenario does before a frame
+ */
+static void bench_step(EditorState* state, Scenario scenario, int forward) {
+    Viewport* viewport = state->viewport;
+
+    switch (scenario) {
+        case SCENARIO_FULL:
+            grid_invalidate(state->grid);
+            row_cache_invalidate(state->row_cache);
+            break;
+        case SCENARIO_IDLE:
+            break;
+        case SCENARIO_CURSOR:
+            editor_process_key(state, forward ? KEY_ARROW_DOWN : KEY_ARROW_UP);
+            break;
+        case SCENARIO_PAGE:
+            editor_process_key(state, forward ? KEY_PAGE_DOWN : KEY_PAGE_UP);
+            break;
+        case SCENARIO_WHEEL: {
+            MouseEvent event;
+            event.type = forward ? MOUSE_WHEEL_DOWN : MOUSE_WHEEL_UP;
+            event.x = viewport->screen_cols / 2;
+            event.y = viewport->screen_rows / 2;
+            event.button = 0;
+            editor_process_mouse(state, event);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * Sort comparison for frame times
+ */
+static int bench_compare_times(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Render the frames of one scenario, starting from the top of the file
+ */
+static void bench_scenario(EditorState* state, BenchSink* sink, Scenario scenario,
+                          size_t frames, long long* times, BenchResult* result) {
+    memset(result, 0, sizeof(*result));
+
+    // Start each scenario from the same screen; this frame isn't measured
+    editor_process_key(state, KEY_CTRL_HOME);
+    ui_render(state);
+    if (!bench_check_screen(state->grid, sink->vterm, scenario_names[scenario], 0)) {
+        result->mismatches++;
+    }
+
+    size_t total_bytes = 0;
+    long long total_ns = 0;
+    for (size_t frame = 0; frame < frames; frame++) {
+        bench_step(state, scenario, frame < frames / 2);
+
+        sink->frame_bytes = 0;
+        sink->sink_ns = 0;
+        long long start = bench_now_ns();
+        ui_render(state);
+        long long elapsed = bench_now_ns() - start - sink->sink_ns;
+
+        times[frame] = elapsed;
+        total_ns += elapsed;
+        total_bytes += sink->frame_bytes;
+        if (sink->frame_bytes > result->max_bytes) result->max_bytes = sink->frame_bytes;
+
+        if (!bench_check_screen(state->grid, sink->vterm, scenario_names[scenario], frame + 1)) {
+            result->mismatches++;
+        }
+    }
+
+    qsort(times, frames, sizeof(long long), bench_compare_times);
+    size_t p99 = (frames * 99 + 99) / 100;
+    result->frames = frames;
+    result->avg_us = (double)total_ns / frames / 1000.0;
+    result->p99_us = times[p99 > 0 ? p99 - 1 : 0] / 1000.0;
+    result->max_us = times[frames - 1] / 1000.0;
+    result->avg_bytes = total_bytes / frames;
+}
+
+/**
+ * Print usage for the render benchmark
+ */
+static void bench_usage(void) {
+    fprintf(stderr,
+            "usage: ncode --bench-render FILE [--frames N] [--size ROWSxCOLS]\n"
+            "                                 [--max-frame-us US] [--max-frame-bytes BYTES]\n");
+}
+
+/**
+ * Parse a positive integer option value
+ * @return 1 on success, 0 if value isn't a positive integer
+ */
+static int bench_parse_size(const char* value, size_t* out) {
+    if (!value) return 0;
+    char* end;
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (end == value || *end != '\0' || parsed == 0) return 0;
+    *out = (size_t)parsed;
+    return 1;
+}
+
+int bench_render(int argc, char** argv) {
+    const char* filename = NULL;
+    size_t frames = BENCH_DEFAULT_FRAMES;
+    size_t rows = BENCH_DEFAULT_ROWS;
+    size_t cols = BENCH_DEFAULT_COLS;
+    size_t max_frame_us = 0;     // 0 = no budget
+    size_t max_frame_bytes = 0;  // 0 = no budget
+
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = 1;
+
+        if (strcmp(arg, "--frames") == 0) {
+            ok = bench_parse_size(value, &frames);
+            i++;
+        } else if (strcmp(arg, "--size") == 0) {
+            unsigned long r, c;
+            char extra;
+            ok = value && sscanf(value, "%lux%lu%c", &r, &c, &extra) == 2 && r > 1 && c > 0;
+            if (ok) {
+                rows = r;
+                cols = c;
+            }
+            i++;
+        } else if (strcmp(arg, "--max-frame-us") == 0) {
+            ok = bench_parse_size(value, &max_frame_us);
+            i++;
+        } else if (strcmp(arg, "--max-frame-bytes") == 0) {
+            ok = bench_parse_size(value, &max_frame_bytes);
+            i++;
+        } else if (arg[0] != '-' && !filename) {
+            filename = arg;
+        } else {
+            ok = 0;
+        }
+
+        if (!ok) {
+            bench_usage();
+            return 2;
+        }
+    }
+
+    if (!filename) {
+        bench_usage();
+        return 2;
+    }
+    if (!editor_validate_file(filename)) {
+        fprintf(stderr, "'%s' is not a regular file\n", filename);
+        return 2;
+    }
+
+    EditorState* state = editor_init(filename, rows, cols);
+    VTerm* vterm = vterm_create(rows, cols);
+    long long* times = malloc(sizeof(long long) * frames);
+    if (!state || !vterm || !times) {
+        fprintf(stderr, "Failed to set up the render benchmark\n");
+        editor_free(state);
+        vterm_free(vterm);
+        free(times);
+        return 1;
+    }
+
+    BenchSink sink = { vterm, 0, 0 };
+    screen_buffer_set_sink(state->screen, bench_sink_write, &sink);
+
+    printf("%s: %zux%zu, %zu frames per scenario\n", filename, rows, cols, frames);
+    printf("%-8s %10s %10s %10s %11s %11s\n",
+           "scenario", "avg us", "p99 us", "max us", "avg bytes", "max bytes");
+
+    int failed = 0;
+    for (int scenario = 0; scenario < SCENARIO_COUNT; scenario++) {
+        BenchResult result;
+        bench_scenario(state, &sink, (Scenario)scenario, frames, times, &result);
+
+        printf("%-8s %10.1f %10.1f %10.1f %11zu %11zu\n", scenario_names[scenario],
+               result.avg_us, result.p99_us, result.max_us, result.avg_bytes, result.max_bytes);
+
+        if (result.mismatches) {
+            printf("  %zu frames left the screen different from the grid\n", result.mismatches);
+            failed = 1;
+        }
+
+        // The full repaint is the reference point, not a budgeted interaction
+        if (scenario == SCENARIO_FULL) continue;
+        if (max_frame_us && result.p99_us > (double)max_frame_us) {
+            printf("  p99 frame time over budget (%zu us)\n", max_frame_us);
+            failed = 1;
+        }
+        if (max_frame_bytes && result.max_bytes > max_frame_bytes) {
+            printf("  largest frame over budget (%zu bytes)\n", max_frame_bytes);
+            failed = 1;
+        }
+    }
+
+    if (vterm->unknown) {
+        printf("%zu escape sequences not understood by the virtual terminal\n", vterm->unknown);
+        failed = 1;
+    }
+    printf("%s\n", failed ? "FAIL" : "PASS");
+
+    free(times);
+    vterm_free(vterm);
+    editor_free(state);
+    return failed;
+}
+
+/**
+ * Next pseudo-random number (xorshift64*), the same on every platform
+ */
+static unsigned long long bench_random(unsigned long long* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+/**
+ * Compare two decoded events
+ * @return 1 if they are the same event, 0 otherwise
+ */
+static int bench_same_event(const InputEvent* a, const InputEvent* b) {
+    if (a->type != b->type) return 0;
+    switch (a->type) {
+        case EVENT_KEY:
+            return a->key == b->key;
+        case EVENT_MOUSE:
+            return a->mouse.type == b->mouse.type && a->mouse.x == b->mouse.x &&
+                   a->mouse.y == b->mouse.y && a->mouse.button == b->mouse.button;
+        case EVENT_FOCUS:
+            return a->focused == b->focused;
+        case EVENT_PASTE:
+            return a->paste.length == b->paste.length &&
+                   memcmp(a->paste.text, b->paste.text, a->paste.length) == 0;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Release what decoded events own
+ */
+static void bench_free_events(InputEvent* events, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (events[i].type == EVENT_PASTE) free(events[i].paste.text);
+    }
+}
+
+/**
+ * Decode everything buffered, checking the decoder leaves nothing behind
+ * @return Number of events stored (up to max), or (size_t)-1 if bytes were left in the ring
+ */
+static size_t bench_drain(InputDecoder* decoder, InputEvent* events, size_t count, size_t max) {
+    InputEvent event;
+    while (input_decoder_next(decoder, &event)) {
+        if (count < max) {
+            events[count] = event;
+        } else {
+            bench_free_events(&event, 1);
+        }
+        count++;
+    }
+    return decoder->head == decoder->tail ? count : (size_t)-1;
+}
+
+/**
+ * Decode a stream fed in pieces of random length, flushing a trailing ESC
+ * @param max_piece Longest piece, or 0 to feed the stream whole
+ * @return Number of events, or (size_t)-1 if the decoder left bytes undecoded
+ */
+static size_t bench_decode_stream(InputDecoder* decoder, const char* stream, size_t len,
+                                  size_t max_piece, unsigned long long* random,
+                                  InputEvent* events, size_t max) {
+    input_decoder_cleanup(decoder);
+    input_decoder_init(decoder);
+
+    size_t count = 0;
+    size_t offset = 0;
+    while (offset < len) {
+        size_t piece = max_piece ? 1 + bench_random(random) % max_piece : len;
+        if (piece > len - offset) piece = len - offset;
+        input_decoder_feed(decoder, stream + offset, piece);
+        offset += piece;
+
+        size_t drained = bench_drain(decoder, events, count, max);
+        if (drained == (size_t)-1) {
+            bench_free_events(events, count < max ? count : max);
+            return drained;
+        }
+        count = drained;
+    }
+
+    InputEvent event;
+    if (input_decoder_flush(decoder, &event)) {
+        if (count < max) events[count] = event;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Time the decoder on the corpus repeated to the given size
+ * @return 1 if every copy decoded to the same events, 0 otherwise
+ */
+static int bench_input_speed(InputDecoder* decoder, size_t bytes) {
+    size_t corpus_len = sizeof(input_corpus) - 1;
+    size_t copies = bytes / corpus_len > 0 ? bytes / corpus_len : 1;
+    size_t len = copies * corpus_len;
+    char* stream = malloc(len);
+    if (!stream) {
+        fprintf(stderr, "Failed to set up the input benchmark\n");
+        return 0;
+    }
+    for (size_t i = 0; i < copies; i++) {
+        memcpy(stream + i * corpus_len, input_corpus, corpus_len);
+    }
+
+    // Events one copy of the corpus decodes to
+    InputEvent sample;
+    size_t per_copy = 0;
+    input_decoder_feed(decoder, input_corpus, corpus_len);
+    while (input_decoder_next(decoder, &sample)) {
+        bench_free_events(&sample, 1);
+        per_copy++;
+    }
+
+    input_decoder_cleanup(decoder);
+    input_decoder_init(decoder);
+    size_t events = 0;
+    long long start = bench_now_ns();
+    for (size_t offset = 0; offset < len; offset += INPUT_CHUNK) {
+        size_t chunk = len - offset < INPUT_CHUNK ? len - offset : INPUT_CHUNK;
+        input_decoder_feed(decoder, stream + offset, chunk);
+        InputEvent event;
+        while (input_decoder_next(decoder, &event)) {
+            bench_free_events(&event, 1);
+            events++;
+        }
+    }
+    long long elapsed = bench_now_ns() - start;
+    free(stream);
+
+    double seconds = elapsed / 1e9;
+    printf("decode   %zu bytes, %zu events: %.1f MB/s, %.1f ns per event\n",
+           len, events, len / seconds / (1024.0 * 1024.0),
+           events ? (double)elapsed / events : 0.0);
+
+    if (events != per_copy * copies) {
+        printf("  expected %zu events\n", per_copy * copies);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Decode random streams whole and split at random points
+ * @return Number of streams that decoded differently
+ */
+static size_t bench_input_fuzz(InputDecoder* decoder, size_t iterations, unsigned long long seed) {
+    static char stream[FUZZ_MAX_STREAM];
+    static InputEvent whole[FUZZ_MAX_STREAM + 1];
+    static InputEvent split[FUZZ_MAX_STREAM + 1];
+    size_t max = FUZZ_MAX_STREAM + 1;  // Every byte yields at most one event, plus a flush
+    size_t alphabet = sizeof(fuzz_alphabet) - 1;
+    size_t failures = 0;
+
+    for (size_t iteration = 0; iteration < iterations; iteration++) {
+        // Each stream has its own seed, so a failure can be replayed with --seed
+        unsigned long long random = (seed + iteration) * 0x9e3779b97f4a7c15ULL | 1;
+        size_t len = 1 + bench_random(&random) % FUZZ_MAX_STREAM;
+        for (size_t i = 0; i < len; i++) {
+            unsigned long long r = bench_random(&random);
+            const char* token = fuzz_tokens[(r >> 8) % FUZZ_TOKEN_COUNT];
+            size_t token_len = strlen(token);
+
+            if ((r & 63) == 0 && token_len <= len - i) {
+                memcpy(stream + i, token, token_len);
+                i += token_len - 1;
+            } else if (r & 7) {
+                // Mostly sequence syntax, sometimes any byte at all
+                stream[i] = fuzz_alphabet[(r >> 3) % alphabet];
+            } else {
+                stream[i] = (char)(r >> 3);
+            }
+        }
+
+        size_t a = bench_decode_stream(decoder, stream, len, 0, &random, whole, max);
+        size_t b = bench_decode_stream(decoder, stream, len, FUZZ_MAX_PIECE, &random, split, max);
+
+        int consistent = a != (size_t)-1 && a == b;
+        for (size_t i = 0; consistent && i < a; i++) {
+            consistent = bench_same_event(&whole[i], &split[i]);
+        }
+        if (a != (size_t)-1) bench_free_events(whole, a);
+        if (b != (size_t)-1) bench_free_events(split, b);
+        if (!consistent) {
+            if (failures == 0) {
+                fprintf(stderr, "seed %llu: %zu bytes decoded to %zu events whole, %zu split\n",
+                        seed + iteration, len, a, b);
+            }
+            failures++;
+        }
+    }
+
+    printf("fuzz     %zu random streams from seed %llu: %zu inconsistent\n",
+           iterations, seed, failures);
+    return failures;
+}
+
+/**
+ * Print usage for the input benchmark
+ */
+static void bench_input_usage(void) {
+    fprintf(stderr, "usage: ncode --bench-input [--bytes N] [--iterations N] [--seed S]\n");
+}
+
+int bench_input(int argc, char** argv) {
+    size_t bytes = BENCH_DEFAULT_INPUT_BYTES;
+    size_t iterations = BENCH_DEFAULT_ITERATIONS;
+    size_t seed = BENCH_DEFAULT_SEED;
+
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok;
+
+        if (strcmp(arg, "--bytes") == 0) {
+            ok = bench_parse_size(value, &bytes);
+        } else if (strcmp(arg, "--iterations") == 0) {
+            ok = bench_parse_size(value, &iterations);
+        } else if (strcmp(arg, "--seed") == 0) {
+            ok = bench_parse_size(value, &seed);
+        } else {
+            ok = 0;
+        }
+        i++;
+
+        if (!ok) {
+            bench_input_usage();
+            return 2;
+        }
+    }
+
+    InputDecoder* decoder = malloc(sizeof(InputDecoder));
+    if (!decoder) {
+        fprintf(stderr, "Failed to set up the input benchmark\n");
+        return 1;
+    }
+    input_decoder_init(decoder);
+
+    int failed = !bench_input_speed(decoder, bytes);
+    if (bench_input_fuzz(decoder, iterations, seed)) failed = 1;
+    printf("%s\n", failed ? "FAIL" : "PASS");
+
+    input_decoder_cleanup(decoder);
+    free(decoder);
+    return failed;
+}
@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stddef.h>
 #include "commands.h"
 #include "editor.h"
@@ -33,7 +34,9 @@ void cmd_move_to_start_of_document(EditorState* state) {
 void cmd_move_to_end_of_document(EditorState* state) {
     if (!state || !state->viewport) return;
     
-    size_t last_line = state->viewport->total_lines > 0 ? state->viewport->total_lines - 1 : 0;
+    // The last visible line, which is a fold header if the end is collapsed
+    size_t visible = viewport_visible_lines(state->viewport);
+    size_t last_line = viewport_row_to_line(state->viewport, visible > 0 ? visible - 1 : 0);
     size_t last_line_len = viewport_line_length(state->viewport, last_line);
     viewport_set_cursor(state->viewport, last_line_len, last_line);
     editor_refresh_view(state);
@@ -64,9 +67,10 @@ void cmd_move_word(EditorState* state, int direction) {
             cursor_x++;
         }
         
-        // If we're at the end of line and not last
-        if (cursor_x >= line_len && cursor_y < viewport->total_lines - 1) {
-            cursor_y++;
+        // If we're at the end of line and not last, continue on the next visible line
+        size_t row = viewport_line_to_row(viewport, cursor_y);
+        if (cursor_x >= line_len && row + 1 < viewport_visible_lines(viewport)) {
+            cursor_y = viewport_row_to_line(viewport, row + 1);
             cursor_x = 0;
         }
     } else {  // Move backward one word
@@ -82,7 +86,7 @@ void cmd_move_word(EditorState* state, int direction) {
         
         // If we're at the start of line and not first
         if (cursor_x == 0 && cursor_y > 0) {
-            cursor_y--;
+            cursor_y = viewport_row_to_line(viewport, viewport_line_to_row(viewport, cursor_y) - 1);
             line = viewport_get_line(viewport, cursor_y);
             line_len = viewport_line_length(viewport, cursor_y);
             cursor_x = line_len;
@@ -94,39 +98,47 @@ void cmd_move_word(EditorState* state, int direction) {
 }
 
 // Handle page up/down movement
-void cmd_page_move(EditorState* state, int direction) {
+void cmd_page_move(EditorState* state, int pages) {
     if (!state || !state->viewport) return;
     
     Viewport* viewport = state->viewport;
-    size_t screen_rows = viewport->screen_rows - 1; // Account for status bar
+    long screen_rows = (long)viewport->screen_rows - 1; // Account for status bar
     
-    // Move cursor by screen height
-    for (size_t i = 0; i < screen_rows; i++) {
-        viewport_move_cursor(viewport, 0, direction);
-    }
+    // Move cursor by screen height in one step (folded lines are skipped)
+    long rows = pages * screen_rows;
+    if (rows > INT_MAX) rows = INT_MAX;
+    if (rows < -INT_MAX) rows = -INT_MAX;
+    viewport_move_cursor(viewport, 0, (int)rows);
     
     editor_refresh_view(state);
 }
 
+// Lines scrolled per wheel notch
+#define WHEEL_SCROLL_LINES 3
+
 // Process a mouse event (clicked position or scrolling)
-void cmd_process_mouse_event(EditorState* state, MouseEvent event) {
+void cmd_process_mouse_event(EditorState* state, MouseEvent event, size_t count) {
     if (!state || !state->viewport) return;
     
     Viewport* viewport = state->viewport;
     
+    // Merged wheel notches scroll in one step
+    int lines = count < INT_MAX / WHEEL_SCROLL_LINES ? (int)count * WHEEL_SCROLL_LINES : INT_MAX;
+    
     switch (event.type) {
         case MOUSE_PRESS:
         case MOUSE_DRAG:
             // Convert screen position to buffer position, accounting for line numbers and padding
             if (event.x >= LINE_NUMBER_WIDTH + LINE_NUMBER_PADDING) {
                 size_t buffer_x = event.x - (LINE_NUMBER_WIDTH + LINE_NUMBER_PADDING) + viewport->scroll_x;
-                size_t buffer_y = event.y + viewport->scroll_y;
+                size_t row = viewport_line_to_row(viewport, viewport->scroll_y) + event.y;
                 
                 // Constraint 1: Ensure the line exists in the buffer
-                if (buffer_y >= viewport->total_lines) {
+                if (row >= viewport_visible_lines(viewport)) {
                     // Click is below the actual content, do nothing
                     return;
                 }
+                size_t buffer_y = viewport_row_to_line(viewport, row);
                 
                 // Get the length of the line at the clicked position
                 size_t line_len = viewport_line_length(viewport, buffer_y);
@@ -143,18 +155,107 @@ void cmd_process_mouse_event(EditorState* state, MouseEvent event) {
             break;
             
         case MOUSE_WHEEL_UP:
-            // Scroll up (3 lines at a time)
-            viewport_scroll(viewport, 0, -3);
+            // Scroll up (3 lines a notch)
+            viewport_scroll(viewport, 0, -lines);
             editor_refresh_view(state);
             break;
             
         case MOUSE_WHEEL_DOWN:
-            // Scroll down (3 lines at a time)
-            viewport_scroll(viewport, 0, 3);
+            // Scroll down (3 lines a notch)
+            viewport_scroll(viewport, 0, lines);
             editor_refresh_view(state);
             break;
             
         default:
             break;
     }
-}
\ No newline at end of file
+}
+
+// Number of columns a tab counts for when measuring indentation
+#define FOLD_TAB_WIDTH 4
+
+// Indentation width of a line, or -1 if the line is blank
+static long line_indent(Viewport* viewport, size_t line_number) {
+    char* line = viewport_get_line(viewport, line_number);
+    size_t line_len = viewport_line_length(viewport, line_number);
+    long indent = 0;
+
+    for (size_t i = 0; i < line_len; i++) {
+        if (line[i] == ' ') {
+            indent++;
+        } else if (line[i] == '\t') {
+            indent += FOLD_TAB_WIDTH - indent % FOLD_TAB_WIDTH;
+        } else if (line[i] != '\r') {
+            return indent;
+        }
+    }
+    return -1;
+}
+
+// Drop the pending manual fold mark
+static void clear_fold_mark(EditorState* state) {
+    editor_anchor_remove(state, state->viewport->fold_mark);
+    state->viewport->fold_mark = NULL;
+}
+
+// Toggle a fold at the cursor line
+void cmd_toggle_fold(EditorState* state) {
+    if (!state || !state->viewport) return;
+    
+    Viewport* viewport = state->viewport;
+    size_t cursor_y = viewport->cursor_y;
+    
+    if (viewport->fold_mark) {
+        // Manual fold between the mark and the cursor; the mark has moved with any edits
+        size_t mark_y = viewport_line_at(viewport, anchor_offset(viewport->fold_mark));
+        size_t start = mark_y < cursor_y ? mark_y : cursor_y;
+        size_t end = mark_y < cursor_y ? cursor_y : mark_y;
+        clear_fold_mark(state);
+        viewport_fold(viewport, start, end);
+    } else if (!viewport_unfold(viewport, cursor_y)) {
+        // Fold the block indented deeper than the cursor line
+        long indent = line_indent(viewport, cursor_y);
+        size_t end = cursor_y;
+        
+        if (indent >= 0) {
+            for (size_t line = cursor_y + 1; line < viewport->total_lines; line++) {
+                long line_ind = line_indent(viewport, line);
+                if (line_ind < 0) continue; // Blank lines belong to the block only if it continues
+                if (line_ind <= indent) break;
+                end = line;
+            }
+        }
+        
+        if (end > cursor_y) {
+            viewport_fold(viewport, cursor_y, end);
+        }
+    }
+    
+    editor_refresh_view(state);
+}
+
+// Mark the cursor line as the start of a manual fold
+void cmd_set_fold_mark(EditorState* state) {
+    if (!state || !state->viewport) return;
+    
+    Viewport* viewport = state->viewport;
+    size_t line_start = viewport_get_line(viewport, viewport->cursor_y) - viewport->content;
+    int same_line = viewport->fold_mark &&
+                    viewport_line_at(viewport, anchor_offset(viewport->fold_mark)) == viewport->cursor_y;
+    
+    // Pressing again on the marked line clears the mark
+    clear_fold_mark(state);
+    if (!same_line) {
+        viewport->fold_mark = editor_anchor_create(state, line_start, ANCHOR_LEFT);
+    }
+    editor_refresh_view(state);
+}
+
+// Expand every fold
+void cmd_unfold_all(EditorState* state) {
+    if (!state || !state->viewport) return;
+    
+    clear_fold_mark(state);
+    viewport_unfold_all(state->viewport);
+    editor_refresh_view(state);
+}
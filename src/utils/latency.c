@@ -0,0 +1,268 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "latency.h"
+
+// Largest value kept
+#define LATENCY_MAX_US ((1LL << LATENCY_RANGE_BITS) - 1)
+
+// Percentiles listed in the summary of a dump
+static const double summary_percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+
+static const char* stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_DECODE]   = "decode",
+    [LATENCY_DISPATCH] = "dispatch",
+    [LATENCY_MUTATE]   = "mutate",
+    [LATENCY_BUILD]    = "build",
+    [LATENCY_FLUSH]    = "flush",
+    [LATENCY_TOTAL]    = "total"
+};
+
+// Histograms per stage; frames may be written from the render thread
+static int enabled = 0;
+static pthread_mutex_t histogram_lock = PTHREAD_MUTEX_INITIALIZER;
+static LatencyHistogram histograms[LATENCY_STAGE_COUNT];
+
+// Editor thread only: when the input being dispatched was dispatched and
+// read, and the oldest input that changed the screen but no frame shows yet
+static long long dispatch_us = 0;
+static long long dispatch_read_us = 0;
+static long long unshown_us = 0;
+
+/**
+ * Current time in microseconds on a clock that never jumps
+ */
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Bucket counting a value: exact below LATENCY_SUB_BUCKETS, then
+ * LATENCY_SUB_BUCKETS buckets per power of two
+ */
+static size_t bucket_index(long long value) {
+    if (value < LATENCY_SUB_BUCKETS) return (size_t)value;
+
+    int top = 63 - __builtin_clzll((unsigned long long)value);
+    int shift = top - LATENCY_SUB_BITS;
+    return (size_t)(shift + 1) * LATENCY_SUB_BUCKETS +
+           (size_t)((value >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+/**
+ * Smallest value counted in a bucket
+ */
+static long long bucket_lowest(size_t index) {
+    if (index < LATENCY_SUB_BUCKETS) return (long long)index;
+
+    int shift = (int)(index / LATENCY_SUB_BUCKETS) - 1;
+    long long sub = (long long)(index % LATENCY_SUB_BUCKETS) + LATENCY_SUB_BUCKETS;
+    return sub << shift;
+}
+
+/**
+ * Largest value counted in a bucket
+ */
+static long long bucket_highest(size_t index) {
+    if (index + 1 >= LATENCY_BUCKETS) return LATENCY_MAX_US;
+    return bucket_lowest(index + 1) - 1;
+}
+
+void latency_histogram_reset(LatencyHistogram* histogram) {
+    if (!histogram) return;
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void latency_histogram_record(LatencyHistogram* histogram, long long us) {
+    if (!histogram) return;
+    if (us < 0) us = 0;
+    if (us > LATENCY_MAX_US) us = LATENCY_MAX_US;
+
+    histogram->counts[bucket_index(us)]++;
+    histogram->total++;
+    histogram->sum += us;
+    if (us > histogram->max) histogram->max = us;
+}
+
+long long latency_histogram_percentile(const LatencyHistogram* histogram, double percentile) {
+    if (!histogram || histogram->total == 0) return -1;
+    if (percentile < 0.0) percentile = 0.0;
+    if (percentile > 100.0) percentile = 100.0;
+
+    // Rank of the value wanted, counting from 1
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > histogram->total) rank = histogram->total;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            long long highest = bucket_highest(i);
+            return highest < histogram->max ? highest : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void latency_enable(void) {
+    pthread_mutex_lock(&histogram_lock);
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        latency_histogram_reset(&histograms[i]);
+    }
+    pthread_mutex_unlock(&histogram_lock);
+    dispatch_us = 0;
+    dispatch_read_us = 0;
+    unshown_us = 0;
+    enabled = 1;
+}
+
+int latency_enabled(void) {
+    return enabled;
+}
+
+void latency_record(LatencyStage stage, long long us) {
+    if (!enabled || stage >= LATENCY_STAGE_COUNT) return;
+    pthread_mutex_lock(&histogram_lock);
+    latency_histogram_record(&histograms[stage], us);
+    pthread_mutex_unlock(&histogram_lock);
+}
+
+long long latency_percentile(LatencyStage stage, double percentile) {
+    if (stage >= LATENCY_STAGE_COUNT) return -1;
+    pthread_mutex_lock(&histogram_lock);
+    long long us = latency_histogram_percentile(&histograms[stage], percentile);
+    pthread_mutex_unlock(&histogram_lock);
+    return us;
+}
+
+void latency_input(const InputEvent* event) {
+    if (!enabled || !event) return;
+
+    dispatch_us = now_us();
+    dispatch_read_us = event->read_us;
+    if (event->read_us > 0) {
+        latency_record(LATENCY_DECODE, event->time_us - event->read_us);
+    }
+    if (event->time_us > 0) {
+        latency_record(LATENCY_DISPATCH, dispatch_us - event->time_us);
+    }
+}
+
+void latency_input_visible(void) {
+    if (!enabled || dispatch_read_us == 0) return;
+    if (unshown_us == 0 || dispatch_read_us < unshown_us) unshown_us = dispatch_read_us;
+}
+
+void latency_mutation(void) {
+    if (!enabled || dispatch_us == 0) return;
+    latency_record(LATENCY_MUTATE, now_us() - dispatch_us);
+    dispatch_us = 0;
+}
+
+void latency_frame_begin(LatencyFrame* frame) {
+    if (!frame) return;
+    memset(frame, 0, sizeof(*frame));
+    if (!enabled) return;
+
+    frame->origin_us = unshown_us;
+    frame->start_us = now_us();
+    unshown_us = 0;
+    dispatch_us = 0;
+    dispatch_read_us = 0;
+}
+
+void latency_frame_built(LatencyFrame* frame) {
+    if (!frame || frame->start_us == 0) return;
+    frame->built_us = now_us();
+    latency_record(LATENCY_BUILD, frame->built_us - frame->start_us);
+}
+
+void latency_frame_written(const LatencyFrame* frame) {
+    if (!frame || frame->built_us == 0) return;
+    long long now = now_us();
+    latency_record(LATENCY_FLUSH, now - frame->built_us);
+    if (frame->origin_us > 0) {
+        latency_record(LATENCY_TOTAL, now - frame->origin_us);
+    }
+}
+
+void latency_frame_merge(LatencyFrame* frame, const LatencyFrame* dropped) {
+    if (!frame || !dropped || dropped->origin_us == 0) return;
+    if (frame->origin_us == 0 || dropped->origin_us < frame->origin_us) {
+        frame->origin_us = dropped->origin_us;
+    }
+}
+
+size_t latency_format(char* out, size_t size, long long us) {
+    int len;
+    if (us < 0) {
+        len = snprintf(out, size, "-");
+    } else if (us < 1000) {
+        len = snprintf(out, size, "%lldus", us);
+    } else if (us < 10000) {
+        len = snprintf(out, size, "%.2fms", us / 1000.0);
+    } else {
+        len = snprintf(out, size, "%.1fms", us / 1000.0);
+    }
+    if (len < 0) return 0;
+    return (size_t)len < size ? (size_t)len : size - 1;
+}
+
+const char* latency_stage_name(LatencyStage stage) {
+    return stage < LATENCY_STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+int latency_dump(const char* path) {
+    if (!path) return 0;
+
+    FILE* file = fopen(path, "w");
+    if (!file) return 0;
+
+    // Copy the histograms so the lock isn't held while writing
+    static LatencyHistogram copy[LATENCY_STAGE_COUNT];
+    pthread_mutex_lock(&histogram_lock);
+    memcpy(copy, histograms, sizeof(copy));
+    pthread_mutex_unlock(&histogram_lock);
+
+    size_t percentile_count = sizeof(summary_percentiles) / sizeof(summary_percentiles[0]);
+
+    // Summary: one line per stage
+    fprintf(file, "# Latency per stage in microseconds\n");
+    fprintf(file, "# %-8s %10s %10s", "stage", "count", "mean");
+    for (size_t p = 0; p < percentile_count; p++) {
+        char label[16];
+        snprintf(label, sizeof(label), "p%g", summary_percentiles[p]);
+        fprintf(file, " %10s", label);
+    }
+    fprintf(file, " %10s\n", "max");
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        const LatencyHistogram* histogram = &copy[i];
+        fprintf(file, "  %-8s %10llu %10lld", stage_names[i], (unsigned long long)histogram->total,
+                histogram->total ? histogram->sum / (long long)histogram->total : 0);
+        for (size_t p = 0; p < percentile_count; p++) {
+            fprintf(file, " %10lld", latency_histogram_percentile(histogram, summary_percentiles[p]));
+        }
+        fprintf(file, " %10lld\n", histogram->max);
+    }
+
+    // Distribution: the non-empty buckets of each stage
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        const LatencyHistogram* histogram = &copy[i];
+        fprintf(file, "\n[%s]\n# %12s %12s %10s %10s\n", stage_names[i],
+                "from_us", "to_us", "count", "percentile");
+
+        uint64_t seen = 0;
+        for (size_t b = 0; b < LATENCY_BUCKETS; b++) {
+            if (histogram->counts[b] == 0) continue;
+            seen += histogram->counts[b];
+            fprintf(file, "  %12lld %12lld %10llu %10.3f\n", bucket_lowest(b), bucket_highest(b),
+                    (unsigned long long)histogram->counts[b], 100.0 * (double)seen / (double)histogram->total);
+        }
+    }
+
+    return fclose(file) == 0;
+}
@@ -0,0 +1,797 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "ptybench.h"
+#include "terminal.h"
+#include "vterm.h"
+#include "latency.h"
+
+// What each workload sends
+typedef enum {
+    WORKLOAD_KEYS,         // Cursor down
+    WORKLOAD_PASTE,        // Bracketed paste of a few lines
+    WORKLOAD_MOUSE,        // Wheel scroll down
+    WORKLOAD_MIXED,        // The three in turn
+    WORKLOAD_COUNT
+} Workload;
+
+static const char* workload_names[WORKLOAD_COUNT] = {
+    "keys", "paste", "mouse", "mixed"
+};
+
+// Replies of a terminal that supports synchronized output (mode reset) and
+// identifies as a VT220
+#define PTY_REPLY_SYNC CSI "?2026;2$y"
+#define PTY_REPLY_DA1  CSI "?62c"
+
+// Quiet time after which the screen counts as settled, longer than a frame
+// held back by the editor's frame cap
+#define PTY_SETTLE_MS 25
+
+// How long the reference run waits for a frame before deciding an input
+// changed nothing
+#define PTY_INVISIBLE_MS 500
+
+// How long the editor gets to exit after Ctrl+Q
+#define PTY_QUIT_MS 2000
+
+// Characters between line breaks in a paste
+#define PTY_PASTE_LINE 48
+
+// Bytes read from the terminal at a time
+#define PTY_READ_CHUNK 65536
+
+// Progress toward a byte sequence in the editor's output
+typedef struct {
+    const char* text;      // Sequence to find
+    size_t len;            // Its length
+    size_t seen;           // Bytes of it matched so far
+} PtyMatcher;
+
+// Forward declaration and typedef for PtySession
+struct PtySession;
+typedef struct PtySession PtySession;
+
+// Called after every frame the editor writes
+typedef void (*PtyFrameHandler)(PtySession* session, void* context);
+
+// An editor running in a pseudo-terminal
+struct PtySession {
+    pid_t pid;                     // Editor process
+    int master;                    // Our end of the pseudo-terminal
+    VTerm* vterm;                  // Screen the editor's output is applied to
+    PtyMatcher frame_begin;        // Start of a synchronized frame
+    PtyMatcher frame_end;          // End of a synchronized frame
+    PtyMatcher query_sync;         // Query for synchronized output
+    PtyMatcher query_da1;          // Query for device attributes
+    int synced;                    // Frames are delimited by the sync markers
+    char* outbox;                  // Input not written yet
+    size_t out_len;
+    size_t out_sent;
+    size_t out_capacity;
+    size_t frames;                 // Frames written by the editor
+    size_t bytes;                  // Bytes written by the editor
+    unsigned long long screen;     // Hash of the screen after the last frame
+    long long output_us;           // When the editor last wrote anything
+    int closed;                    // The editor closed the terminal
+    PtyFrameHandler on_frame;      // Called after every frame, or NULL
+    void* context;                 // Passed to on_frame
+};
+
+// Progress of a measured run
+typedef struct {
+    const unsigned long long* expected; // Screen after each input (from the reference run)
+    const char* visible;           // Whether each input changed the screen
+    size_t count;                  // Inputs in the run
+    long long* sent_us;            // When each input was written
+    size_t sent;                   // Inputs written so far
+    size_t shown;                  // Inputs whose effect has been on screen
+    long long progress_us;         // When the last input was written or shown
+    LatencyHistogram* latency;     // Input written until shown, visible inputs only
+} PtyRun;
+
+// Measurements of one workload
+typedef struct {
+    size_t inputs;         // Inputs sent
+    size_t invisible;      // Inputs that changed nothing on screen
+    size_t missing;        // Inputs that never showed up
+    double rate;           // Inputs per second achieved
+    size_t frames;         // Frames written by the editor
+    size_t bytes;          // Bytes written by the editor
+    double cpu_ms;         // Editor CPU time, user and system
+} PtyResult;
+
+/**
+ * Get monotonic time in microseconds
+ */
+static long long pty_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void pty_matcher_init(PtyMatcher* matcher, const char* text) {
+    matcher->text = text;
+    matcher->len = strlen(text);
+    matcher->seen = 0;
+}
+
+/**
+ * Feed one output byte to a matcher
+ * The sequences matched start with ESC and contain no other, so a mismatch
+ * only has to check whether a new match starts.
+ * @return 1 if the byte completes the sequence, 0 otherwise
+ */
+static int pty_matcher_feed(PtyMatcher* matcher, char c) {
+    if (c == matcher->text[matcher->seen]) {
+        matcher->seen++;
+    } else {
+        matcher->seen = c == matcher->text[0] ? 1 : 0;
+    }
+    if (matcher->seen < matcher->len) return 0;
+    matcher->seen = 0;
+    return 1;
+}
+
+/**
+ * Hash what a screen shows: its characters without the status bar, and the
+ * cursor position (FNV-1a)
+ */
+static unsigned long long pty_screen_hash(const VTerm* vterm) {
+    unsigned long long hash = 14695981039346656037ULL;
+    size_t rows = vterm->rows > 1 ? vterm->rows - 1 : vterm->rows;
+    size_t count = rows * vterm->cols;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ (unsigned char)vterm->cells[i].ch) * 1099511628211ULL;
+    }
+    hash = (hash ^ vterm->cursor_row) * 1099511628211ULL;
+    hash = (hash ^ vterm->cursor_col) * 1099511628211ULL;
+    return hash;
+}
+
+/**
+ * Write as much of the outbox as the terminal takes without blocking
+ */
+static void pty_send(PtySession* session) {
+    while (session->out_sent < session->out_len) {
+        ssize_t written = write(session->master, session->outbox + session->out_sent,
+                                session->out_len - session->out_sent);
+        if (written > 0) {
+            session->out_sent += (size_t)written;
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) session->closed = 1;
+            return;
+        }
+    }
+    session->out_len = 0;
+    session->out_sent = 0;
+}
+
+/**
+ * Check whether everything queued has been written
+ */
+static int pty_idle(const PtySession* session) {
+    return session->out_sent == session->out_len;
+}
+
+/**
+ * Queue bytes for the editor and write what the terminal takes right away
+ * @return 1 on success, 0 on allocation failure
+ */
+static int pty_queue(PtySession* session, const char* data, size_t len) {
+    if (session->out_len + len > session->out_capacity) {
+        size_t capacity = session->out_capacity ? session->out_capacity : 256;
+        while (capacity < session->out_len + len) capacity *= 2;
+        char* outbox = realloc(session->outbox, capacity);
+        if (!outbox) return 0;
+        session->outbox = outbox;
+        session->out_capacity = capacity;
+    }
+    memcpy(session->outbox + session->out_len, data, len);
+    session->out_len += len;
+    pty_send(session);
+    return 1;
+}
+
+/**
+ * Note that the screen holds a complete frame
+ */
+static void pty_frame(PtySession* session) {
+    session->frames++;
+    session->screen = pty_screen_hash(session->vterm);
+    if (session->on_frame) session->on_frame(session, session->context);
+}
+
+/**
+ * Apply output from the editor, answering its queries and splitting it into
+ * frames
+ */
+static void pty_output(PtySession* session, const char* data, size_t len) {
+    session->bytes += len;
+    session->output_us = pty_now_us();
+
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (pty_matcher_feed(&session->frame_begin, c)) {
+            session->synced = 1;
+        }
+        if (pty_matcher_feed(&session->query_sync, c)) {
+            pty_queue(session, PTY_REPLY_SYNC, strlen(PTY_REPLY_SYNC));
+        }
+        if (pty_matcher_feed(&session->query_da1, c)) {
+            pty_queue(session, PTY_REPLY_DA1, strlen(PTY_REPLY_DA1));
+        }
+        if (pty_matcher_feed(&session->frame_end, c)) {
+            vterm_write(session->vterm, data + start, i + 1 - start);
+            start = i + 1;
+            pty_frame(session);
+        }
+    }
+    if (start < len) {
+        vterm_write(session->vterm, data + start, len - start);
+
+        // Without the markers every write is taken as a frame
+        if (!session->synced) pty_frame(session);
+    }
+}
+
+/**
+ * Exchange bytes with the editor until something happens or a deadline passes
+ * @param session Session to serve
+ * @param deadline_us Latest time to return at
+ * @return 1 while the editor is running, 0 once it closed the terminal
+ */
+static int pty_step(PtySession* session, long long deadline_us) {
+    if (session->closed) return 0;
+
+    long long wait_us = deadline_us - pty_now_us();
+    int timeout = wait_us > 0 ? (int)((wait_us + 999) / 1000) : 0;
+    struct pollfd pfd = { session->master, POLLIN, 0 };
+    if (!pty_idle(session)) pfd.events |= POLLOUT;
+
+    if (poll(&pfd, 1, timeout) <= 0) return 1;
+
+    if (pfd.revents & POLLOUT) pty_send(session);
+    if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+        static char chunk[PTY_READ_CHUNK];
+        while (1) {
+            ssize_t nread = read(session->master, chunk, sizeof(chunk));
+            if (nread > 0) {
+                pty_output(session, chunk, (size_t)nread);
+            } else if (nread < 0 && errno == EINTR) {
+                continue;
+            } else {
+                // Once the editor is gone the master reports EIO (or EOF)
+                if (nread == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) session->closed = 1;
+                break;
+            }
+        }
+    }
+    return !session->closed;
+}
+
+/**
+ * Wait for the editor to draw and then stop writing
+ * @param session Session to watch
+ * @param frames Frames counted before the wait; a later one must arrive
+ * @param first_ms How long to wait for that frame
+ * @param timeout_ms How long to wait for the editor to go quiet after it
+ * @return 1 if the editor drew and settled, 0 if no frame came or it never settled
+ */
+static int pty_settle(PtySession* session, size_t frames, int first_ms, int timeout_ms) {
+    long long start = pty_now_us();
+    long long first_deadline = start + (long long)first_ms * 1000;
+    long long deadline = start + (long long)timeout_ms * 1000;
+
+    while (1) {
+        long long now = pty_now_us();
+        if (session->frames > frames) {
+            long long quiet_at = session->output_us + PTY_SETTLE_MS * 1000;
+            if (now >= quiet_at && pty_idle(session)) return 1;
+            if (now >= deadline) return 0;
+            if (!pty_step(session, quiet_at < deadline ? quiet_at : deadline)) return 0;
+        } else {
+            if (now >= first_deadline) return 0;
+            if (!pty_step(session, first_deadline)) return 0;
+        }
+    }
+}
+
+/**
+ * Start the editor in a new pseudo-terminal
+ * @param session Session to set up
+ * @param argv Editor command line
+ * @return 1 on success, 0 on error (the session is cleaned up)
+ */
+static int pty_start(PtySession* session, char** argv, size_t rows, size_t cols) {
+    memset(session, 0, sizeof(*session));
+    session->pid = -1;
+    pty_matcher_init(&session->frame_begin, TERM_SYNC_BEGIN);
+    pty_matcher_init(&session->frame_end, TERM_SYNC_END);
+    pty_matcher_init(&session->query_sync, TERM_QUERY_SYNC);
+    pty_matcher_init(&session->query_da1, TERM_QUERY_DA1);
+
+    session->vterm = vterm_create(rows, cols);
+    session->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (!session->vterm || session->master == -1) {
+        vterm_free(session->vterm);
+        if (session->master != -1) close(session->master);
+        return 0;
+    }
+
+    char* slave_name = NULL;
+    if (grantpt(session->master) == -1 || unlockpt(session->master) == -1 ||
+        !(slave_name = ptsname(session->master)) ||
+        fcntl(session->master, F_SETFD, FD_CLOEXEC) == -1) {
+        vterm_free(session->vterm);
+        close(session->master);
+        return 0;
+    }
+
+    struct winsize size;
+    memset(&size, 0, sizeof(size));
+    size.ws_row = (unsigned short)rows;
+    size.ws_col = (unsigned short)cols;
+
+    fflush(stdout);
+    session->pid = fork();
+    if (session->pid == 0) {
+        // Child: make the pseudo-terminal the controlling terminal and stdio
+        setsid();
+        int slave = open(slave_name, O_RDWR);
+        if (slave == -1) _exit(127);
+#ifdef TIOCSCTTY
+        ioctl(slave, TIOCSCTTY, 0);
+#endif
+        ioctl(slave, TIOCSWINSZ, &size);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        if (slave > STDERR_FILENO) close(slave);
+        setenv("TERM", "xterm-256color", 1);
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    if (session->pid == -1) {
+        vterm_free(session->vterm);
+        close(session->master);
+        return 0;
+    }
+
+    int flags = fcntl(session->master, F_GETFL);
+    if (flags != -1) fcntl(session->master, F_SETFL, flags | O_NONBLOCK);
+    return 1;
+}
+
+/**
+ * Quit the editor and release the session
+ * @return 1 if the editor exited by itself, 0 if it had to be killed
+ */
+static int pty_stop(PtySession* session) {
+    int clean = 1;
+    if (session->pid > 0) {
+        // Ctrl+Q quits without saving
+        char quit = KEY_CTRL_Q;
+        pty_queue(session, &quit, 1);
+        long long deadline = pty_now_us() + (long long)PTY_QUIT_MS * 1000;
+        while (pty_step(session, deadline) && pty_now_us() < deadline) {}
+
+        // The terminal can close just before the exit; give it the rest of the time
+        int status;
+        while (waitpid(session->pid, &status, WNOHANG) == 0) {
+            if (pty_now_us() >= deadline) {
+                kill(session->pid, SIGKILL);
+                waitpid(session->pid, &status, 0);
+                clean = 0;
+                break;
+            }
+            struct timespec pause = { 0, 1000000 };
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    close(session->master);
+    vterm_free(session->vterm);
+    free(session->outbox);
+    memset(session, 0, sizeof(*session));
+    session->master = -1;
+    session->pid = -1;
+    return clean;
+}
+
+/**
+ * Build the bytes of one input
+ * @param out Buffer for the input (at least paste_bytes + 32 bytes)
+ * @return Number of bytes written to out
+ */
+static size_t pty_input(Workload workload, size_t index, size_t rows, size_t cols,
+                        size_t paste_bytes, char* out) {
+    if (workload == WORKLOAD_MIXED) workload = (Workload)(index % WORKLOAD_MIXED);
+
+    if (workload == WORKLOAD_KEYS) {
+        memcpy(out, CSI "B", 3);
+        return 3;
+    }
+    if (workload == WORKLOAD_MOUSE) {
+        // SGR wheel down in the middle of the screen
+        return (size_t)sprintf(out, CSI "<65;%zu;%zuM", cols / 2 + 1, rows / 2 + 1);
+    }
+
+    // Lines of code, each ended by Enter as a terminal sends it
+    static const char code[] = "total = total * 31 + values[i++]; ";
+    size_t len = strlen(TERM_PASTE_BEGIN);
+    memcpy(out, TERM_PASTE_BEGIN, len);
+    for (size_t i = 0; i < paste_bytes; i++) {
+        int line_end = i + 1 == paste_bytes || (i + 1) % PTY_PASTE_LINE == 0;
+        out[len++] = line_end ? '\r' : code[(index + i) % (sizeof(code) - 1)];
+    }
+    memcpy(out + len, TERM_PASTE_END, strlen(TERM_PASTE_END));
+    return len + strlen(TERM_PASTE_END);
+}
+
+/**
+ * Measured run: match each frame against the screens of the reference run
+ * The first frame showing the screen after input j, or one after it, shows
+ * every input up to j.
+ */
+static void pty_run_frame(PtySession* session, void* context) {
+    PtyRun* run = (PtyRun*)context;
+    for (size_t j = run->shown; j < run->sent; j++) {
+        if (run->expected[j] != session->screen) continue;
+
+        long long now = pty_now_us();
+        for (size_t k = run->shown; k <= j; k++) {
+            if (run->visible[k]) latency_histogram_record(run->latency, now - run->sent_us[k]);
+        }
+        run->shown = j + 1;
+        run->progress_us = now;
+        return;
+    }
+}
+
+/**
+ * Get the CPU time of finished child processes in milliseconds
+ */
+static double pty_child_cpu_ms(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_CHILDREN, &usage) == -1) return 0.0;
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+/**
+ * Run one workload: a reference run one input at a time, then a measured run
+ * at the requested rate
+ * @return 1 if every input showed up, 0 otherwise
+ */
+static int pty_workload(char** argv, Workload workload, size_t inputs, size_t rate,
+                        size_t rows, size_t cols, size_t paste_bytes, int timeout_ms,
+                        LatencyHistogram* latency, PtyResult* result) {
+    memset(result, 0, sizeof(*result));
+    latency_histogram_reset(latency);
+    result->inputs = inputs;
+
+    unsigned long long* expected = malloc(sizeof(unsigned long long) * inputs);
+    char* visible = malloc(inputs);
+    long long* sent_us = malloc(sizeof(long long) * inputs);
+    char* input = malloc(paste_bytes + 32);
+    if (!expected || !visible || !sent_us || !input) {
+        fprintf(stderr, "Failed to set up the %s workload\n", workload_names[workload]);
+        free(expected);
+        free(visible);
+        free(sent_us);
+        free(input);
+        return 0;
+    }
+
+    // Reference run: the screen each input leads to
+    PtySession session;
+    int ok = pty_start(&session, argv, rows, cols) &&
+             pty_settle(&session, 0, timeout_ms, timeout_ms);
+    if (!ok) {
+        fprintf(stderr, "%s: the editor didn't start\n", workload_names[workload]);
+    }
+    unsigned long long previous = session.screen;
+    for (size_t i = 0; ok && i < inputs; i++) {
+        size_t len = pty_input(workload, i, rows, cols, paste_bytes, input);
+        size_t frames = session.frames;
+        if (!pty_queue(&session, input, len)) {
+            ok = 0;
+            break;
+        }
+        if (!pty_settle(&session, frames, PTY_INVISIBLE_MS, timeout_ms) && session.closed) {
+            fprintf(stderr, "%s: the editor exited during the reference run\n",
+                    workload_names[workload]);
+            ok = 0;
+            break;
+        }
+        expected[i] = session.screen;
+        visible[i] = session.screen != previous;
+        if (!visible[i]) result->invisible++;
+        previous = session.screen;
+    }
+    if (session.pid > 0) pty_stop(&session);
+
+    // Measured run: the same inputs at the requested rate to a fresh editor
+    PtyRun run = { expected, visible, inputs, sent_us, 0, 0, 0, latency };
+    double cpu_before = pty_child_cpu_ms();
+    if (ok && !(pty_start(&session, argv, rows, cols) &&
+                pty_settle(&session, 0, timeout_ms, timeout_ms))) {
+        fprintf(stderr, "%s: the editor didn't start\n", workload_names[workload]);
+        if (session.pid > 0) pty_stop(&session);
+        ok = 0;
+    }
+    if (ok) {
+        session.frames = 0;
+        session.bytes = 0;
+        session.on_frame = pty_run_frame;
+        session.context = &run;
+
+        long long interval_us = rate ? 1000000 / (long long)rate : 0;
+        long long next_us = pty_now_us();
+        int writing = 0; // An input is queued but not fully written
+        run.progress_us = next_us;
+
+        while (run.shown < inputs) {
+            long long now = pty_now_us();
+
+            if (writing && pty_idle(&session)) {
+                run.sent_us[run.sent++] = now;
+                run.progress_us = now;
+                writing = 0;
+            }
+
+            // Inputs that changed nothing are shown once the screen before them is
+            while (run.shown < run.sent && !visible[run.shown] &&
+                   expected[run.shown] == session.screen) {
+                run.shown++;
+            }
+            if (run.shown >= inputs) break;
+
+            // Open loop: send on schedule; closed loop: once the last one showed
+            if (!writing && run.sent < inputs) {
+                int due = rate ? now >= next_us
+                               : run.shown == run.sent || !visible[run.sent - 1];
+                if (due) {
+                    size_t len = pty_input(workload, run.sent, rows, cols, paste_bytes, input);
+                    if (!pty_queue(&session, input, len)) break;
+                    writing = 1;
+                    next_us += interval_us;
+                    continue;
+                }
+            }
+
+            long long deadline = run.progress_us + (long long)timeout_ms * 1000;
+            if (now >= deadline) break;
+            if (!writing && rate && run.sent < inputs && next_us < deadline) deadline = next_us;
+            if (!pty_step(&session, deadline)) break;
+        }
+
+        result->missing = inputs - run.shown;
+        result->frames = session.frames;
+        result->bytes = session.bytes;
+        if (run.sent > 1 && sent_us[run.sent - 1] > sent_us[0]) {
+            result->rate = (run.sent - 1) * 1000000.0 / (double)(sent_us[run.sent - 1] - sent_us[0]);
+        }
+        if (!pty_stop(&session)) {
+            fprintf(stderr, "%s: the editor didn't quit and was killed\n", workload_names[workload]);
+        }
+        result->cpu_ms = pty_child_cpu_ms() - cpu_before;
+        if (result->missing) ok = 0;
+    }
+
+    free(expected);
+    free(visible);
+    free(sent_us);
+    free(input);
+    return ok;
+}
+
+/**
+ * Write a C source file of a given number of lines
+ * @return 1 on success, 0 on error
+ */
+static int pty_generate_file(const char* path, size_t lines) {
+    FILE* file = fopen(path, "w");
+    if (!file) return 0;
+
+    for (size_t line = 0; line < lines; line++) {
+        size_t n = line / 5;
+        switch (line % 5) {
+            case 0: fprintf(file, "static int value_%zu = %zu; // generated\n", n, n * 7 % 1000); break;
+            case 1: fprintf(file, "int compute_%zu(int x) {\n", n); break;
+            case 2: fprintf(file, "    if (x > %zu) return x - value_%zu;\n", n % 100, n); break;
+            case 3: fprintf(file, "    return x * %zu + value_%zu;\n", n % 13 + 1, n); break;
+            default: fprintf(file, "}\n"); break;
+        }
+    }
+    return fclose(file) == 0;
+}
+
+/**
+ * Print usage for the pty benchmark
+ */
+static void pty_usage(void) {
+    fprintf(stderr,
+            "usage: ncode --bench-pty [FILE] [--inputs N] [--rate N] [--size ROWSxCOLS]\n"
+            "                         [--workload keys|paste|mouse|mixed] [--paste-bytes N]\n"
+            "                         [--timeout-ms MS] [--editor PATH] [-- EDITOR OPTIONS]\n");
+}
+
+/**
+ * Parse a non-negative integer option value
+ * @return 1 on success, 0 if value isn't an integer at least min
+ */
+static int pty_parse_count(const char* value, size_t min, size_t* out) {
+    if (!value || value[0] == '-') return 0;
+    char* end;
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < min) return 0;
+    *out = (size_t)parsed;
+    return 1;
+}
+
+int ptybench_run(const char* program, int argc, char** argv) {
+    const char* filename = NULL;
+    const char* editor = program;
+    size_t inputs = PTYBENCH_DEFAULT_INPUTS;
+    size_t rate = PTYBENCH_DEFAULT_RATE;
+    size_t rows = PTYBENCH_DEFAULT_ROWS;
+    size_t cols = PTYBENCH_DEFAULT_COLS;
+    size_t paste_bytes = PTYBENCH_DEFAULT_PASTE;
+    size_t timeout_ms = PTYBENCH_DEFAULT_TIMEOUT_MS;
+    int only = -1; // Workload to run, or -1 for all
+    int editor_args = argc; // First argument passed to the editor
+
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = 1;
+
+        if (strcmp(arg, "--") == 0) {
+            editor_args = i + 1;
+            break;
+        } else if (strcmp(arg, "--inputs") == 0) {
+            ok = pty_parse_count(value, 1, &inputs);
+            i++;
+        } else if (strcmp(arg, "--rate") == 0) {
+            ok = pty_parse_count(value, 0, &rate) && rate <= 1000000;
+            i++;
+        } else if (strcmp(arg, "--size") == 0) {
+            unsigned long r, c;
+            char extra;
+            ok = value && sscanf(value, "%lux%lu%c", &r, &c, &extra) == 2 &&
+                 r > 2 && c > 1 && r <= 1000 && c <= 1000;
+            if (ok) {
+                rows = r;
+                cols = c;
+            }
+            i++;
+        } else if (strcmp(arg, "--workload") == 0) {
+            ok = 0;
+            for (int w = 0; value && w < WORKLOAD_COUNT; w++) {
+                if (strcmp(value, workload_names[w]) == 0) {
+                    only = w;
+                    ok = 1;
+                }
+            }
+            i++;
+        } else if (strcmp(arg, "--paste-bytes") == 0) {
+            ok = pty_parse_count(value, 1, &paste_bytes);
+            i++;
+        } else if (strcmp(arg, "--timeout-ms") == 0) {
+            ok = pty_parse_count(value, 1, &timeout_ms) && timeout_ms <= 600000;
+            i++;
+        } else if (strcmp(arg, "--editor") == 0) {
+            ok = value != NULL;
+            editor = value;
+            i++;
+        } else if (arg[0] != '-' && !filename) {
+            filename = arg;
+        } else {
+            ok = 0;
+        }
+
+        if (!ok) {
+            pty_usage();
+            return 2;
+        }
+    }
+
+    // Without a file, generate one in a directory of its own
+    char directory[] = "/tmp/ncode-bench-XXXXXX";
+    char generated[sizeof(directory) + 16];
+    generated[0] = '\0';
+    if (!filename) {
+        if (!mkdtemp(directory)) {
+            fprintf(stderr, "Failed to create a directory for the benchmark file\n");
+            return 1;
+        }
+        snprintf(generated, sizeof(generated), "%s/bench.c", directory);
+        if (!pty_generate_file(generated, PTYBENCH_DEFAULT_LINES)) {
+            fprintf(stderr, "Failed to write %s\n", generated);
+            remove(generated);
+            rmdir(directory);
+            return 1;
+        }
+        filename = generated;
+    }
+
+    // Editor command line: the binary, its options, then the file
+    size_t extra = (size_t)(argc - editor_args);
+    char** command = malloc(sizeof(char*) * (extra + 3));
+    LatencyHistogram* latency = malloc(sizeof(LatencyHistogram));
+    if (!command || !latency) {
+        fprintf(stderr, "Failed to set up the pty benchmark\n");
+        free(command);
+        free(latency);
+        if (generated[0]) {
+            remove(generated);
+            rmdir(directory);
+        }
+        return 1;
+    }
+    command[0] = (char*)editor;
+    for (size_t i = 0; i < extra; i++) command[i + 1] = argv[editor_args + (int)i];
+    command[extra + 1] = (char*)filename;
+    command[extra + 2] = NULL;
+
+    if (rate) {
+        printf("%s: %zux%zu, %zu inputs per workload at %zu/s\n", filename, rows, cols, inputs, rate);
+    } else {
+        printf("%s: %zux%zu, %zu inputs per workload, one at a time\n", filename, rows, cols, inputs);
+    }
+    printf("%-8s %8s %8s %8s %8s %8s %8s %8s %10s %10s %9s\n", "workload", "inputs", "rate/s",
+           "p50", "p90", "p99", "max", "frames", "bytes", "bytes/in", "cpu ms");
+
+    int failed = 0;
+    for (int w = 0; w < WORKLOAD_COUNT; w++) {
+        if (only != -1 && w != only) continue;
+
+        PtyResult result;
+        if (!pty_workload(command, (Workload)w, inputs, rate, rows, cols, paste_bytes,
+                          (int)timeout_ms, latency, &result)) {
+            failed = 1;
+        }
+
+        char p50[16], p90[16], p99[16], max[16];
+        latency_format(p50, sizeof(p50), latency_histogram_percentile(latency, 50.0));
+        latency_format(p90, sizeof(p90), latency_histogram_percentile(latency, 90.0));
+        latency_format(p99, sizeof(p99), latency_histogram_percentile(latency, 99.0));
+        latency_format(max, sizeof(max), latency->total ? latency->max : -1);
+        printf("%-8s %8zu %8.0f %8s %8s %8s %8s %8zu %10zu %10zu %9.1f\n", workload_names[w],
+               result.inputs, result.rate, p50, p90, p99, max, result.frames, result.bytes,
+               result.bytes / result.inputs, result.cpu_ms);
+
+        if (result.invisible) {
+            printf("  %zu inputs changed nothing on screen and weren't timed\n", result.invisible);
+        }
+        if (result.missing) {
+            printf("  %zu inputs never showed up\n", result.missing);
+        }
+    }
+    printf("%s\n", failed ? "FAIL" : "PASS");
+
+    if (generated[0]) {
+        remove(generated);
+        rmdir(directory);
+    }
+    free(command);
+    free(latency);
+    return failed;
+}